@@ -0,0 +1,355 @@
+/*
+  ==============================================================================
+
+    DownloadScheduler.h
+    Created: 19 Oct 2026 9:26:14pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "defines_source.h"
+
+
+//==============================================================================
+// Process-wide scheduler for sound downloads (use it through a juce::SharedResourcePointer<DownloadScheduler>).
+// Instead of starting one download task per file, downloads are queued and run by a fixed number of worker threads:
+//  - No more than DOWNLOAD_SCHEDULER_MAX_DOWNLOADS_PER_HOST downloads run at the same time for the same host (and no
+//    more than DOWNLOAD_SCHEDULER_NUM_WORKERS in total).
+//  - Queued downloads with higher priority are started first (e.g. sounds which are mapped to notes), downloads with
+//    the same priority are started in the order they were queued.
+//  - Downloads with prefetchPriority (files downloaded in advance in case they are needed later) never take the last
+//    download slot of a host, so there is always a slot free for other downloads from that host.
+//  - Failed downloads (connection errors, server errors, incomplete files) are retried with exponential backoff up to
+//    DOWNLOAD_SCHEDULER_MAX_ATTEMPTS times. Client errors (e.g. 404) are not retried.
+//  - Cancelled downloads are aborted immediately, also when waiting for the server to connect or send data (the stream of
+//    each active download is kept so it can be cancelled from any thread).
+//  - Files are downloaded to a ".part" file next to the target location which is moved to the target location once
+//    complete. If a ".part" file already exists (e.g. from a download that failed or was cancelled), the download is
+//    resumed from where it stopped using an HTTP Range request (servers that ignore the Range header send the whole file).
+// The scheduler only deals with URLs and files so it can be pointed to any server (e.g. a local HTTP server).
+
+class DownloadScheduler
+{
+public:
+    enum Priority
+    {
+        prefetchPriority = -1,  // For files which might be needed later (see FreesoundCandidatePool)
+        defaultPriority = 0,
+        mappedSoundPriority = 1  // For sounds which are mapped to notes and can be played as soon as they are loaded
+    };
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        // Called from the worker threads
+        virtual void scheduledDownloadProgress (const juce::File& targetFileLocation, juce::int64 bytesDownloaded, juce::int64 totalLength) = 0;
+        virtual void scheduledDownloadFinished (const juce::File& targetFileLocation, bool success) = 0;
+    };
+
+    DownloadScheduler()
+    {
+        for (int i=0; i<DOWNLOAD_SCHEDULER_NUM_WORKERS; i++){
+            workers.add (new Worker (*this));
+        }
+    }
+
+    ~DownloadScheduler()
+    {
+        for (auto* worker: workers){
+            worker->signalThreadShouldExit();
+        }
+        {
+            const juce::ScopedLock sl (lock);
+            for (auto& request: activeRequests){
+                cancelRequest (*request);
+            }
+        }
+        newRequestEvent.signal();
+        for (auto* worker: workers){
+            worker->stopThread (MAX_DOWNLOAD_WAITING_TIME_MS);
+        }
+    }
+
+    // Queue the download of url to targetFileLocation. The listener is notified of progress and of the final result of the
+    // download (after all retries). Listeners must call cancelDownloads before being deleted
+    void addDownload (const juce::URL& url, const juce::File& targetFileLocation, const juce::String& extraHeaders, int priority, Listener* listener)
+    {
+        auto request = std::make_shared<Request>();
+        request->url = url;
+        request->host = url.getDomain();
+        request->targetFileLocation = targetFileLocation;
+        request->extraHeaders = extraHeaders;
+        request->priority = priority;
+        request->listener = listener;
+        {
+            const juce::ScopedLock sl (lock);
+            request->id = nextRequestId++;
+            pendingRequests.push_back (request);
+        }
+        for (auto* worker: workers){
+            if (!worker->isThreadRunning()){
+                worker->startThread (0);  // Lowest thread priority
+            }
+        }
+        newRequestEvent.signal();
+    }
+
+    // Location where the file is written while it downloads. Data received so far can be read from there when listeners
+    // get progress callbacks
+    static juce::File getPartialFileLocation (const juce::File& targetFileLocation)
+    {
+        return juce::File (targetFileLocation.getFullPathName() + ".part");
+    }
+
+    // Remove queued downloads of the listener and stop the ones in progress. When this returns, the listener will not
+    // receive any more callbacks. Downloads in progress are aborted (see cancelRequest) so this does not wait for slow or
+    // stalled connections, only for the workers to notice. Partially downloaded files are kept so downloads can be resumed
+    // later
+    void cancelDownloads (Listener* listener)
+    {
+        {
+            const juce::ScopedLock sl (lock);
+            pendingRequests.erase (std::remove_if (pendingRequests.begin(), pendingRequests.end(), [listener](const std::shared_ptr<Request>& r){ return r->listener == listener; }), pendingRequests.end());
+            for (auto& request: activeRequests){
+                if (request->listener == listener){
+                    cancelRequest (*request);
+                }
+            }
+        }
+        while (hasActiveRequestsForListener (listener)){
+            juce::Thread::sleep (1);
+        }
+    }
+
+private:
+    struct Request
+    {
+        int id = 0;
+        juce::URL url;
+        juce::String host;
+        juce::File targetFileLocation;
+        juce::String extraHeaders;
+        int priority = defaultPriority;
+        Listener* listener = nullptr;
+        int numFailedAttempts = 0;
+        juce::uint32 notBeforeTimeMs = 0;  // Used to delay retries
+        std::atomic<bool> cancelled { false };
+        juce::WebInputStream* stream = nullptr;  // Stream of the download in progress (if any), protected by lock
+    };
+
+    enum class Result
+    {
+        succeeded,
+        failedCanRetry,
+        failed,
+        cancelled
+    };
+
+    class Worker: public juce::Thread
+    {
+    public:
+        Worker (DownloadScheduler& s): juce::Thread ("DownloadSchedulerWorker"), scheduler (s) {}
+
+        void run() override
+        {
+            while (!threadShouldExit()){
+                std::shared_ptr<Request> request = scheduler.takeNextRequest();
+                if (request == nullptr){
+                    scheduler.newRequestEvent.wait (DOWNLOAD_SCHEDULER_IDLE_WAIT_MS);
+                    continue;
+                }
+                Result result = scheduler.download (*request, [this]{ return threadShouldExit(); });
+                scheduler.finishRequest (request, result);
+            }
+        }
+
+        DownloadScheduler& scheduler;
+    };
+
+    std::shared_ptr<Request> takeNextRequest()
+    {
+        // Choose the queued request with highest priority (and lowest id) which is not waiting to be retried and whose
+        // host is not already downloading the maximum number of files (one less for prefetch requests)
+        const juce::ScopedLock sl (lock);
+        juce::uint32 now = juce::Time::getMillisecondCounter();
+        auto best = pendingRequests.end();
+        for (auto it = pendingRequests.begin(); it != pendingRequests.end(); ++it){
+            const auto& request = *it;
+            int maxActiveRequestsForHost = DOWNLOAD_SCHEDULER_MAX_DOWNLOADS_PER_HOST - (request->priority <= prefetchPriority ? 1 : 0);
+            if (request->notBeforeTimeMs > now || getNumActiveRequestsForHost (request->host) >= maxActiveRequestsForHost){
+                continue;
+            }
+            if (best == pendingRequests.end() || request->priority > (*best)->priority || (request->priority == (*best)->priority && request->id < (*best)->id)){
+                best = it;
+            }
+        }
+        if (best == pendingRequests.end()){
+            return nullptr;
+        }
+        std::shared_ptr<Request> request = *best;
+        pendingRequests.erase (best);
+        activeRequests.push_back (request);
+        return request;
+    }
+
+    void finishRequest (std::shared_ptr<Request> request, Result result)
+    {
+        if (result == Result::failedCanRetry && !request->cancelled){
+            request->numFailedAttempts += 1;
+            if (request->numFailedAttempts < DOWNLOAD_SCHEDULER_MAX_ATTEMPTS){
+                juce::uint32 delay = (juce::uint32)DOWNLOAD_SCHEDULER_RETRY_BASE_DELAY_MS << (request->numFailedAttempts - 1);
+                DBG("Download of " << request->targetFileLocation.getFileName() << " failed, retrying in " << (int)delay << " ms");
+                const juce::ScopedLock sl (lock);
+                request->notBeforeTimeMs = juce::Time::getMillisecondCounter() + delay;
+                removeActiveRequest (request);
+                pendingRequests.push_back (request);
+                return;
+            }
+        }
+
+        // Notify the listener while the request is still active so cancelDownloads waits for the callback to finish
+        if (!request->cancelled && request->listener != nullptr){
+            request->listener->scheduledDownloadFinished (request->targetFileLocation, result == Result::succeeded);
+        }
+        const juce::ScopedLock sl (lock);
+        removeActiveRequest (request);
+    }
+
+    Result download (Request& request, std::function<bool()> threadShouldExit)
+    {
+        juce::File partialFile = getPartialFileLocation (request.targetFileLocation);
+        juce::int64 resumeFrom = partialFile.existsAsFile() ? partialFile.getSize() : 0;
+
+        juce::String headers = request.extraHeaders;
+        if (resumeFrom > 0){
+            headers = headers + (headers.isEmpty() ? "" : "\r\n") + "Range: bytes=" + juce::String (resumeFrom) + "-";
+        }
+        juce::WebInputStream stream (request.url, false);
+        stream.withExtraHeaders (headers).withConnectionTimeout (MAX_DOWNLOAD_WAITING_TIME_MS);
+        ScopedActiveStream activeStream (*this, request, stream);
+        if (request.cancelled){
+            return Result::cancelled;  // Cancelled before the stream was registered
+        }
+        bool connected = stream.connect (nullptr);
+        if (request.cancelled || threadShouldExit()){
+            return Result::cancelled;
+        }
+        int statusCode = stream.getStatusCode();
+        if (!connected || statusCode >= 500 || statusCode == 408 || statusCode == 429){
+            return Result::failedCanRetry;
+        }
+        if (statusCode == 416){
+            // Range not satisfiable, the partial file is probably not valid. Start from scratch in the next attempt
+            partialFile.deleteFile();
+            return Result::failedCanRetry;
+        }
+        if (statusCode >= 400){
+            return Result::failed;
+        }
+
+        juce::FileOutputStream output (partialFile);  // Opened at the end of the file
+        if (!output.openedOk()){
+            return Result::failed;
+        }
+        if (statusCode != 206){
+            // Server ignored the Range header (or there was no partial file), write the whole file from the start
+            resumeFrom = 0;
+            output.setPosition (0);
+            output.truncate();
+        }
+
+        juce::int64 remainingLength = stream.getTotalLength();
+        juce::int64 totalLength = remainingLength >= 0 ? resumeFrom + remainingLength : -1;
+        juce::int64 bytesDownloaded = resumeFrom;
+        juce::HeapBlock<char> buffer (DOWNLOAD_SCHEDULER_BUFFER_SIZE);
+        while (!stream.isExhausted()){
+            if (request.cancelled || threadShouldExit()){
+                return Result::cancelled;
+            }
+            int numRead = stream.read (buffer, DOWNLOAD_SCHEDULER_BUFFER_SIZE);
+            if (request.cancelled || threadShouldExit()){
+                return Result::cancelled;  // Read was aborted by cancelRequest
+            }
+            if (numRead < 0){
+                return Result::failedCanRetry;
+            }
+            if (numRead == 0){
+                break;
+            }
+            if (!output.write (buffer, (size_t)numRead)){
+                return Result::failed;
+            }
+            bytesDownloaded += numRead;
+            if (request.listener != nullptr && totalLength > 0){
+                output.flush();  // So listeners can read the partial file
+                request.listener->scheduledDownloadProgress (request.targetFileLocation, bytesDownloaded, totalLength);
+            }
+        }
+        output.flush();
+        if (totalLength >= 0 && bytesDownloaded < totalLength){
+            // Connection dropped before the end of the file, the next attempt will resume from here
+            return Result::failedCanRetry;
+        }
+
+        request.targetFileLocation.deleteFile();
+        return partialFile.moveFileTo (request.targetFileLocation) ? Result::succeeded : Result::failed;
+    }
+
+    // Must be called with lock held. Aborts the connection or read the worker might be blocked in
+    void cancelRequest (Request& request)
+    {
+        request.cancelled = true;
+        if (request.stream != nullptr){
+            request.stream->cancel();
+        }
+    }
+
+    // Makes the stream of a download reachable by cancelRequest while the download runs
+    struct ScopedActiveStream
+    {
+        ScopedActiveStream (DownloadScheduler& s, Request& r, juce::WebInputStream& stream): scheduler (s), request (r)
+        {
+            const juce::ScopedLock sl (scheduler.lock);
+            request.stream = &stream;
+        }
+
+        ~ScopedActiveStream()
+        {
+            const juce::ScopedLock sl (scheduler.lock);
+            request.stream = nullptr;
+        }
+
+        DownloadScheduler& scheduler;
+        Request& request;
+    };
+
+    int getNumActiveRequestsForHost (const juce::String& host)
+    {
+        return (int)std::count_if (activeRequests.begin(), activeRequests.end(), [&host](const std::shared_ptr<Request>& r){ return r->host == host; });
+    }
+
+    bool hasActiveRequestsForListener (Listener* listener)
+    {
+        const juce::ScopedLock sl (lock);
+        return std::any_of (activeRequests.begin(), activeRequests.end(), [listener](const std::shared_ptr<Request>& r){ return r->listener == listener; });
+    }
+
+    void removeActiveRequest (const std::shared_ptr<Request>& request)
+    {
+        activeRequests.erase (std::remove (activeRequests.begin(), activeRequests.end(), request), activeRequests.end());
+    }
+
+    juce::CriticalSection lock;  // Protects pendingRequests, activeRequests, nextRequestId and the streams of active requests
+    std::vector<std::shared_ptr<Request>> pendingRequests;
+    std::vector<std::shared_ptr<Request>> activeRequests;
+    int nextRequestId = 0;
+    juce::WaitableEvent newRequestEvent;
+    juce::OwnedArray<Worker> workers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DownloadScheduler)
+};
@@ -1,5 +1,9 @@
 #include "FreesoundAPI.h"
 
+#if FREESOUND_API_REUSE_CONNECTIONS
+ #include <curl/curl.h>
+#endif
+
 juce::String URIS::HOST = juce::String("freesound.org");
 juce::String URIS::BASE = juce::String("https://" + HOST + "/apiv2");
 juce::String URIS::TEXT_SEARCH = juce::String("/search/text/");
@@ -154,14 +158,7 @@ SoundList FreesoundClient::textSearch(juce::String query, juce::String filter, j
 
     juce::URL url = URIS::uri(URIS::TEXT_SEARCH, juce::StringArray());
 	FSRequest request(url, *this);
-	Response resp = request.request(params,juce::String(),false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(params);
 }
 
 SoundList FreesoundClient::contentSearch(juce::String target, juce::String descriptorsFilter, int page, int pageSize, juce::String fields, juce::String descriptors, int normalized)
@@ -196,14 +193,31 @@ SoundList FreesoundClient::contentSearch(juce::String target, juce::String descr
 
     juce::URL url = URIS::uri(URIS::CONTENT_SEARCH, juce::StringArray());
 	FSRequest request(url, *this);
-	Response resp = request.request(params, juce::String(), false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(params);
+}
+
+std::future<SoundList> FreesoundClient::textSearchAsync(juce::String query, juce::String filter, juce::String sort, int groupByPack, int page, int pageSize, juce::String fields, juce::String descriptors, int normalized)
+{
+	FreesoundClient client = *this;
+	return runAsync<SoundList>([=]() mutable { return client.textSearch(query, filter, sort, groupByPack, page, pageSize, fields, descriptors, normalized); });
+}
+
+std::future<SoundList> FreesoundClient::fetchNextPageAsync(SoundList soundList)
+{
+	FreesoundClient client = *this;
+	return runAsync<SoundList>([=]() mutable { return client.fetchNextPage(soundList); });
+}
+
+std::future<FSSound> FreesoundClient::getSoundAsync(juce::String id, juce::String fields)
+{
+	FreesoundClient client = *this;
+	return runAsync<FSSound>([=]() mutable { return client.getSound(id, fields); });
+}
+
+std::future<juce::var> FreesoundClient::getSoundAnalysisAsync(juce::String id, juce::String descriptors, int normalized)
+{
+	FreesoundClient client = *this;
+	return runAsync<juce::var>([=]() mutable { return client.getSoundAnalysis(id, descriptors, normalized); });
 }
 
 FSList FreesoundClient::fetchNextPage(FSList soundList)
@@ -235,27 +249,13 @@ FSList FreesoundClient::fetchPreviousPage(FSList soundList)
 SoundList FreesoundClient::fetchNextPage(SoundList soundList)
 {
 	FSRequest request(soundList.getNextPage(), *this);
-	Response resp = request.request(juce::StringPairArray(), juce::String(), false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(juce::StringPairArray());
 }
 
 SoundList FreesoundClient::fetchPreviousPage(SoundList soundList)
 {
 	FSRequest request(soundList.getPreviousPage(), *this);
-	Response resp = request.request(juce::StringPairArray(), juce::String(), false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(juce::StringPairArray());
 }
 
 FSSound FreesoundClient::getSound(juce::String id, juce::String fields)
@@ -331,14 +331,7 @@ SoundList FreesoundClient::getSimilarSounds(juce::String id, juce::String descri
 
     juce::URL url = URIS::uri(URIS::SIMILAR_SOUNDS, id);
 	FSRequest request(url, *this);
-	Response resp = request.request(params, juce::String(), false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(params);
 }
 
 std::unique_ptr<juce::URL::DownloadTask> FreesoundClient::downloadSound(FSSound sound, const juce::File & location, juce::URL::DownloadTask::Listener * listener)
@@ -573,14 +566,7 @@ SoundList FreesoundClient::getUserSounds(juce::String username, juce::String des
 
     juce::URL url = URIS::uri(URIS::USER_SOUNDS, username);
 	FSRequest request(url, *this);
-	Response resp = request.request(params, juce::String(), false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(params);
 }
 
 FSList FreesoundClient::getUserBookmarkCategories(juce::String username)
@@ -673,14 +659,7 @@ SoundList FreesoundClient::getPackSounds(juce::String id, juce::String descripto
 
     juce::URL url = URIS::uri(URIS::PACK_SOUNDS, juce::StringArray(id));
 	FSRequest request(url, *this);
-	Response resp = request.request(params, juce::String(), false);
-	int resultCode = resp.first;
-	if (resultCode == 200) {
-        juce::var response = resp.second;
-		SoundList returnedSounds(response);
-		return returnedSounds;
-	}
-	return SoundList();
+	return request.requestSoundList(params);
 }
 
 std::unique_ptr<juce::URL::DownloadTask> FreesoundClient::downloadPack(FSPack pack, const juce::File & location, juce::URL::DownloadTask::Listener * listener)
@@ -728,30 +707,688 @@ juce::String FreesoundClient::getClientID()
 	return clientID;
 }
 
+//Input stream which keeps a copy of the data read from another stream, used to store responses in the cache while these are parsed
+class RecordingInputStream : public juce::InputStream {
+public:
+	RecordingInputStream(juce::InputStream& source) : sourceStream(source) {}
+	juce::int64 getTotalLength() override { return sourceStream.getTotalLength(); }
+	bool isExhausted() override { return sourceStream.isExhausted(); }
+	juce::int64 getPosition() override { return sourceStream.getPosition(); }
+	bool setPosition(juce::int64) override { return false; }
+	int read(void* destBuffer, int maxBytesToRead) override
+	{
+		int numRead = sourceStream.read(destBuffer, maxBytesToRead);
+		if (numRead > 0) { recordedData.write(destBuffer, (size_t)numRead); }
+		return numRead;
+	}
+	juce::MemoryBlock getRecordedData() { return recordedData.getMemoryBlock(); }
+private:
+	juce::InputStream& sourceStream;
+	juce::MemoryOutputStream recordedData;
+};
+
+#if FREESOUND_API_REUSE_CONNECTIONS
+//libcurl share object used by all the requests to share open connections, DNS lookups and TLS sessions. Handles using
+//it put their connections in the shared connection cache when done, so the next request to the same host reuses them
+class FSSharedConnections {
+public:
+	static CURLSH* get()
+	{
+		static FSSharedConnections connections;
+		return connections.share;
+	}
+
+private:
+	FSSharedConnections()
+	{
+		curl_global_init(CURL_GLOBAL_ALL);
+		share = curl_share_init();
+		curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockData);
+		curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockData);
+		curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);  //Connection cache can be shared since libcurl 7.57
+#endif
+	}
+
+	~FSSharedConnections() { curl_share_cleanup(share); }
+
+	static void lockData(CURL*, curl_lock_data data, curl_lock_access, void* userData) { static_cast<FSSharedConnections*>(userData)->locks[(int)data].enter(); }
+	static void unlockData(CURL*, curl_lock_data data, void* userData) { static_cast<FSSharedConnections*>(userData)->locks[(int)data].exit(); }
+
+	CURLSH* share = nullptr;
+	juce::CriticalSection locks[CURL_LOCK_DATA_LAST];
+};
+
+//Input stream for a GET request made with a libcurl handle which uses FSSharedConnections. The transfer is driven from
+//the calling thread with a multi handle, so data is only requested from the server while the stream is being read
+class FSKeepAliveInputStream : public juce::InputStream {
+public:
+	FSKeepAliveInputStream(const juce::URL& url, const juce::String& header, int timeoutMs)
+	{
+		easy = curl_easy_init();
+		multi = curl_multi_init();
+		urlString = url.toString(true);
+		curl_easy_setopt(easy, CURLOPT_URL, urlString.toRawUTF8());
+		curl_easy_setopt(easy, CURLOPT_SHARE, FSSharedConnections::get());
+		curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(easy, CURLOPT_MAXREDIRS, 5L);
+		curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+		curl_easy_setopt(easy, CURLOPT_USERAGENT, "JUCE");
+		curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, (long)timeoutMs);
+		curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, 1L);  //Give up if nothing is received for timeoutMs
+		curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, (long)juce::jmax(1, timeoutMs / 1000));
+		curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, writeCallback);
+		curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+		if (header.isNotEmpty()) {
+			headers = curl_slist_append(headers, header.toRawUTF8());
+			curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers);
+		}
+		curl_multi_add_handle(multi, easy);
+	}
+
+	~FSKeepAliveInputStream() override
+	{
+		curl_multi_remove_handle(multi, easy);
+		curl_easy_cleanup(easy);  //Returns the connection to the shared cache (unless the transfer was not finished)
+		curl_multi_cleanup(multi);
+		curl_slist_free_all(headers);
+	}
+
+	//Waits until the response starts to arrive. Returns false if no response was received (the status code is then -1)
+	bool connect(int& statusCode)
+	{
+		while (!finished && getNumBufferedBytes() == 0) { performStep(); }
+		long responseCode = 0;
+		curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &responseCode);
+		statusCode = responseCode > 0 ? (int)responseCode : -1;
+		return responseCode > 0;
+	}
+
+	juce::int64 getTotalLength() override { return -1; }
+	bool isExhausted() override { return finished && getNumBufferedBytes() == 0; }
+	juce::int64 getPosition() override { return position; }
+	bool setPosition(juce::int64 newPosition) override { return newPosition == position; }
+
+	int read(void* destBuffer, int maxBytesToRead) override
+	{
+		while (!finished && getNumBufferedBytes() < (size_t)maxBytesToRead) { performStep(); }
+		size_t numBytes = juce::jmin(getNumBufferedBytes(), (size_t)juce::jmax(0, maxBytesToRead));
+		if (numBytes > 0) {
+			memcpy(destBuffer, static_cast<const char*>(received.getData()) + readOffset, numBytes);
+			readOffset += numBytes;
+			position += (juce::int64)numBytes;
+		}
+		if (readOffset == received.getSize()) {
+			received.setSize(0);
+			readOffset = 0;
+		}
+		return (int)numBytes;
+	}
+
+private:
+	size_t getNumBufferedBytes() const { return received.getSize() - readOffset; }
+
+	void performStep()
+	{
+		int numRunning = 0;
+		curl_multi_perform(multi, &numRunning);
+		int numMessages = 0;
+		while (CURLMsg* message = curl_multi_info_read(multi, &numMessages)) {
+			if (message->msg == CURLMSG_DONE) { finished = true; }
+		}
+		if (numRunning == 0) { finished = true; }
+		if (!finished) { curl_multi_wait(multi, nullptr, 0, 10, nullptr); }
+	}
+
+	static size_t writeCallback(char* data, size_t size, size_t numItems, void* userData)
+	{
+		auto* stream = static_cast<FSKeepAliveInputStream*>(userData);
+		stream->received.append(data, size * numItems);
+		return size * numItems;
+	}
+
+	CURL* easy = nullptr;
+	CURLM* multi = nullptr;
+	curl_slist* headers = nullptr;
+	juce::String urlString;
+	juce::MemoryBlock received;
+	size_t readOffset = 0;
+	juce::int64 position = 0;
+	bool finished = false;
+};
+#endif
+
+//Opens the stream of a request, with FSKeepAliveInputStream for GET requests when connections are reused. Returns nullptr if no response was received
+static std::unique_ptr<juce::InputStream> openRequestStream(const juce::URL& url, bool usePost, const juce::String& header, int& statusCode)
+{
+#if FREESOUND_API_REUSE_CONNECTIONS
+	if (!usePost) {
+		auto stream = std::make_unique<FSKeepAliveInputStream>(url, header, FREESOUND_API_REQUEST_TIMEOUT);
+		if (!stream->connect(statusCode)) { return nullptr; }
+		return stream;
+	}
+#endif
+	juce::StringPairArray responseHeaders;
+	return std::unique_ptr<juce::InputStream>(url.createInputStream(usePost, nullptr, nullptr, header,
+		FREESOUND_API_REQUEST_TIMEOUT, // timeout in millisecs
+		&responseHeaders, &statusCode));
+}
+
+//Streaming (SAX-like) JSON parser for the responses of requests which return a list of sounds. The response is read
+//character by character from the stream and the fields of the sounds are set as they are found, without building a
+//var tree of the whole response. Fields which are not part of FSSound are skipped, and fields which are stored as var
+//in FSSound (previews, images, analysis and ac_analysis) are the only ones for which var objects are created.
+class SoundListStreamParser {
+public:
+	SoundListStreamParser(juce::InputStream& source) : input(source, FREESOUND_API_STREAM_BUFFER_SIZE) {}
+
+	bool parse(int& count, juce::String& nextPage, juce::String& previousPage, juce::Array<FSSound>& sounds)
+	{
+		if (!consumeIf('{')) { return false; }
+		if (consumeIf('}')) { return true; }
+		do {
+			juce::String key;
+			if (!parseString(key) || !consumeIf(':')) { return false; }
+			bool ok = true;
+			if (key == "results") { ok = parseSounds(sounds); }
+			else if (key == "next") { ok = parseScalar(nextPage); }
+			else if (key == "previous") { ok = parseScalar(previousPage); }
+			else if (key == "count") {
+				juce::String value;
+				ok = parseScalar(value);
+				count = value.getIntValue();
+			}
+			else { ok = skipValue(); }
+			if (!ok) { return false; }
+		} while (consumeIf(','));
+		return consumeIf('}');
+	}
+
+private:
+	bool parseSounds(juce::Array<FSSound>& sounds)
+	{
+		if (peekNonWhitespace() == 'n') { return skipValue(); } //null
+		if (!consumeIf('[')) { return false; }
+		if (consumeIf(']')) { return true; }
+		do {
+			FSSound sound;
+			if (!parseSound(sound)) { return false; }
+			sounds.add(sound);
+		} while (consumeIf(','));
+		return consumeIf(']');
+	}
+
+	bool parseSound(FSSound& sound)
+	{
+		if (!consumeIf('{')) { return false; }
+		if (consumeIf('}')) { return true; }
+		do {
+			juce::String key;
+			if (!parseString(key) || !consumeIf(':')) { return false; }
+			bool ok = true;
+			if (key == "previews") { ok = parseValue(sound.previews); }
+			else if (key == "analysis") { ok = parseValue(sound.analysis); }
+			else if (key == "images") { ok = parseValue(sound.images); }
+			else if (key == "ac_analysis") { ok = parseValue(sound.acAnalysis); }
+			else if (key == "tags") {
+				juce::var tags;
+				ok = parseValue(tags);
+				if (auto* tagsArray = tags.getArray()) {
+					for (const auto& tag : *tagsArray) { sound.tags.add(tag.toString()); }
+				}
+			}
+			else {
+				juce::String value;
+				ok = parseScalar(value);
+				if (key == "id") { sound.id = value; }
+				else if (key == "name") { sound.name = value; }
+				else if (key == "username") { sound.user = value; }
+				else if (key == "license") { sound.license = value; }
+				else if (key == "type") { sound.format = value; }
+				else if (key == "filesize") { sound.filesize = value.getIntValue(); }
+				else if (key == "duration") { sound.duration = value.getIntValue(); }
+				else if (key == "channels") { sound.channels = value.getIntValue(); }
+				else if (key == "samplerate") { sound.samplerate = value.getIntValue(); }
+				else if (key == "bitrate") { sound.bitrate = value.getIntValue(); }
+				else if (key == "bitdepth") { sound.bitdepth = value.getIntValue(); }
+				else if (key == "description") { sound.description = value; }
+				else if (key == "geotag") { sound.geotag = value; }
+				else if (key == "created") { sound.created = value; }
+				else if (key == "num_downloads") { sound.numDownloads = value.getIntValue(); }
+				else if (key == "avg_rating") { sound.avgRating = value.getFloatValue(); }
+				else if (key == "num_ratings") { sound.numRatings = value.getIntValue(); }
+				else if (key == "num_comments") { sound.numComments = value.getIntValue(); }
+				else if (key == "url") { sound.url = juce::URL(value); }
+				else if (key == "pack") { sound.pack = juce::URL(value); }
+				else if (key == "download") { sound.download = juce::URL(value); }
+				else if (key == "bookmark") { sound.bookmark = juce::URL(value); }
+				else if (key == "rate") { sound.rate = juce::URL(value); }
+				else if (key == "comments") { sound.comments = juce::URL(value); }
+				else if (key == "comment") { sound.comment = juce::URL(value); }
+				else if (key == "similar_sounds") { sound.similarSounds = juce::URL(value); }
+				else if (key == "analysis_stats") { sound.analysisStats = juce::URL(value); }
+				else if (key == "analysis_frames") { sound.analysisFrames = juce::URL(value); }
+			}
+			if (!ok) { return false; }
+		} while (consumeIf(','));
+		return consumeIf('}');
+	}
+
+	//Parses a value into a var, only used for the fields of FSSound which are stored as var
+	bool parseValue(juce::var& result)
+	{
+		int c = peekNonWhitespace();
+		if (c == '{') {
+			get();
+			juce::DynamicObject::Ptr object = new juce::DynamicObject();
+			if (!consumeIf('}')) {
+				do {
+					juce::String key;
+					juce::var value;
+					if (!parseString(key) || !consumeIf(':') || !parseValue(value)) { return false; }
+					if (key.isNotEmpty()) { object->setProperty(key, value); }
+				} while (consumeIf(','));
+				if (!consumeIf('}')) { return false; }
+			}
+			result = juce::var(object.get());
+			return true;
+		}
+		if (c == '[') {
+			get();
+			juce::Array<juce::var> array;
+			if (!consumeIf(']')) {
+				do {
+					juce::var value;
+					if (!parseValue(value)) { return false; }
+					array.add(value);
+				} while (consumeIf(','));
+				if (!consumeIf(']')) { return false; }
+			}
+			result = array;
+			return true;
+		}
+		if (c == '"') {
+			juce::String value;
+			if (!parseString(value)) { return false; }
+			result = value;
+			return true;
+		}
+		juce::String token;
+		if (!readToken(token)) { return false; }
+		if (token == "null") { result = juce::var(); }
+		else if (token == "true") { result = true; }
+		else if (token == "false") { result = false; }
+		else if (token.containsAnyOf(".eE")) { result = token.getDoubleValue(); }
+		else {
+			juce::int64 value = token.getLargeIntValue();
+			if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) { result = (int)value; }
+			else { result = value; }
+		}
+		return true;
+	}
+
+	//Parses a string, number or literal as text (null becomes an empty string). Objects and arrays are skipped
+	bool parseScalar(juce::String& result)
+	{
+		int c = peekNonWhitespace();
+		if (c == '"') { return parseString(result); }
+		if (c == '{' || c == '[') {
+			result = juce::String();
+			return skipValue();
+		}
+		juce::String token;
+		if (!readToken(token)) { return false; }
+		if (token == "null") { result = juce::String(); }
+		else if (token == "true") { result = "1"; }
+		else if (token == "false") { result = "0"; }
+		else { result = token; }
+		return true;
+	}
+
+	bool parseString(juce::String& result)
+	{
+		if (!consumeIf('"')) { return false; }
+		juce::MemoryOutputStream utf8;
+		while (true) {
+			int c = get();
+			if (c < 0) { return false; }
+			if (c == '"') { break; }
+			if (c != '\\') {
+				utf8.writeByte((char)c);
+				continue;
+			}
+			int escaped = get();
+			switch (escaped) {
+				case '"': case '\\': case '/': utf8.writeByte((char)escaped); break;
+				case 'b': utf8.writeByte('\b'); break;
+				case 'f': utf8.writeByte('\f'); break;
+				case 'n': utf8.writeByte('\n'); break;
+				case 'r': utf8.writeByte('\r'); break;
+				case 't': utf8.writeByte('\t'); break;
+				case 'u': {
+					juce::juce_wchar character = 0;
+					if (!readHexCodeUnit(character)) { return false; }
+					if (character >= 0xd800 && character <= 0xdbff && peek() == '\\') {
+						//Surrogate pair
+						get();
+						juce::juce_wchar lowSurrogate = 0;
+						if (get() != 'u' || !readHexCodeUnit(lowSurrogate)) { return false; }
+						character = 0x10000 + ((character - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+					}
+					utf8 << juce::String::charToString(character);
+					break;
+				}
+				default: return false;
+			}
+		}
+		result = juce::String::fromUTF8((const char*)utf8.getData(), (int)utf8.getDataSize());
+		return true;
+	}
+
+	bool readHexCodeUnit(juce::juce_wchar& result)
+	{
+		result = 0;
+		for (int i = 0; i < 4; i++) {
+			int digit = juce::CharacterFunctions::getHexDigitValue((juce::juce_wchar)get());
+			if (digit < 0) { return false; }
+			result = (result << 4) + (juce::juce_wchar)digit;
+		}
+		return true;
+	}
+
+	//Reads a number or a literal (true, false, null)
+	bool readToken(juce::String& result)
+	{
+		skipWhitespace();
+		juce::MemoryOutputStream token;
+		while (true) {
+			int c = peek();
+			if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.')) { break; }
+			token.writeByte((char)get());
+		}
+		result = token.toString();
+		return result.isNotEmpty();
+	}
+
+	//Skips a value of any type without storing it
+	bool skipValue()
+	{
+		int c = peekNonWhitespace();
+		if (c == '"') {
+			get();
+			return skipRestOfString();
+		}
+		if (c == '{' || c == '[') {
+			get();
+			int depth = 1;
+			while (depth > 0) {
+				c = get();
+				if (c < 0) { return false; }
+				if (c == '"' && !skipRestOfString()) { return false; }
+				if (c == '{' || c == '[') { depth++; }
+				if (c == '}' || c == ']') { depth--; }
+			}
+			return true;
+		}
+		juce::String token;
+		return readToken(token);
+	}
+
+	bool skipRestOfString()
+	{
+		while (true) {
+			int c = get();
+			if (c < 0) { return false; }
+			if (c == '"') { return true; }
+			if (c == '\\' && get() < 0) { return false; }
+		}
+	}
+
+	int peek()
+	{
+		if (lookahead == noLookahead) { lookahead = input.isExhausted() ? -1 : (int)(unsigned char)input.readByte(); }
+		return lookahead;
+	}
+
+	int get()
+	{
+		int c = peek();
+		lookahead = noLookahead;
+		return c;
+	}
+
+	void skipWhitespace()
+	{
+		int c = peek();
+		while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			get();
+			c = peek();
+		}
+	}
+
+	int peekNonWhitespace()
+	{
+		skipWhitespace();
+		return peek();
+	}
+
+	bool consumeIf(int c)
+	{
+		if (peekNonWhitespace() != c) { return false; }
+		get();
+		return true;
+	}
+
+	static constexpr int noLookahead = -2;
+	juce::BufferedInputStream input;
+	int lookahead = noLookahead;
+};
+
 Response FSRequest::request(juce::StringPairArray params, juce::String data, bool postLikeRequest)
+{
+    juce::var response;
+	int statusCode = requestAndParse(params, data, postLikeRequest, [&response](juce::InputStream& body) {
+		response = juce::JSON::parse(body.readEntireStreamAsString());
+		return !response.isVoid();
+	});
+	return Response(statusCode, response);
+}
+
+SoundList FSRequest::requestSoundList(juce::StringPairArray params)
+{
+	int count = 0;
+    juce::String nextPage;
+    juce::String previousPage;
+    juce::Array<FSSound> sounds;
+	bool parsedOk = false;
+	int statusCode = requestAndParse(params, juce::String(), false, [&](juce::InputStream& body) {
+		count = 0;
+		nextPage = juce::String();
+		previousPage = juce::String();
+		sounds.clear();
+		parsedOk = SoundListStreamParser(body).parse(count, nextPage, previousPage, sounds);
+		return parsedOk;
+	});
+	//A body which could not be parsed (e.g. a truncated response) would give a partial list, return an empty list instead
+	if (statusCode == 200 && parsedOk) {
+		return SoundList(count, nextPage, previousPage, sounds);
+	}
+	return SoundList();
+}
+
+int FSRequest::requestAndParse(juce::StringPairArray params, juce::String data, bool postLikeRequest, std::function<bool(juce::InputStream&)> parseBody)
 {
 
     juce::URL url = uri;
     juce::String header;
 	int statusCode = -1;
-    juce::StringPairArray responseHeaders;
 	if (data.isNotEmpty()) { url = url.withPOSTData(data); }
 	if (params.size() != 0) { url = url.withParameters(params); }
 	if (client.isTokenNotEmpty()) { header = "Authorization: " + client.getHeader(); }
 
+	//Only GET requests to endpoints with a time to live are cached
+	FSResponseCache& cache = FSResponseCache::getSharedInstance();
+	int timeToLive = (data.isEmpty() && !postLikeRequest) ? FSResponseCache::getTimeToLiveSeconds(url) : 0;
+	juce::String cacheKey = url.toString(true);
+	juce::MemoryBlock cachedBody;
+	if (timeToLive > 0 && cache.lookup(cacheKey, timeToLive, cachedBody)) {
+		juce::MemoryInputStream cachedBodyStream(cachedBody, false);
+		if (parseBody(cachedBodyStream)) {
+			return 200;
+		}
+	}
 
 	//Try to open a stream with this information.
-	if (auto stream = std::unique_ptr<juce::InputStream>(url.createInputStream(postLikeRequest, nullptr, nullptr, header,
-		FREESOUND_API_REQUEST_TIMEOUT, // timeout in millisecs
-		&responseHeaders, &statusCode)))
+	if (auto stream = openRequestStream(url, postLikeRequest || data.isNotEmpty(), header, statusCode))
 	{
-		//Stream created successfully, store the response, log it and return the response in a pair containing (statusCode, response)
-        juce::String resp = stream->readEntireStreamAsString();
-        juce::var response = juce::JSON::parse(resp);
-		return Response(statusCode, response);
+		//Stream created successfully, parse the response while it is received (and keep a copy to store it in the cache)
+		if (statusCode < 500 || timeToLive == 0) {
+			RecordingInputStream body(*stream);
+			bool parsedOk = parseBody(body);
+			if (timeToLive > 0 && statusCode == 200 && parsedOk) {
+				cache.store(cacheKey, body.getRecordedData());
+			}
+			return statusCode;
+		}
+	}
+	//Couldnt create stream (or server error), use an expired cached response if there is one
+	if (timeToLive > 0 && cache.lookup(cacheKey, FREESOUND_CACHE_MAX_STALE_SECONDS, cachedBody)) {
+		DBG("Freesound could not be reached, using cached response for " + cacheKey);
+		juce::MemoryInputStream cachedBodyStream(cachedBody, false);
+		if (parseBody(cachedBodyStream)) {
+			return 200;
+		}
+	}
+	//Otherwise return the status code (-1 if no connection) without parsing anything
+	return statusCode;
+}
+
+FSResponseCache& FSResponseCache::getSharedInstance()
+{
+	static FSResponseCache cache;
+	return cache;
+}
+
+void FSResponseCache::setDiskLocation(const juce::File& location)
+{
+	const juce::ScopedLock sl(lock);
+	diskLocation = location;
+	if (!diskLocation.exists()) {
+		diskLocation.createDirectory();
+	}
+	juce::Time oldestAllowed = juce::Time::getCurrentTime() - juce::RelativeTime::seconds(FREESOUND_CACHE_MAX_STALE_SECONDS);
+	for (auto file : diskLocation.findChildFiles(juce::File::findFiles, false, "*.fscache")) {
+		if (file.getLastModificationTime() < oldestAllowed) {
+			file.deleteFile();
+		}
+	}
+}
+
+int FSResponseCache::getTimeToLiveSeconds(const juce::URL& url)
+{
+	juce::String path = url.getSubPath();
+	if (path.contains("/search/") || path.endsWith("/similar/")) {
+		return FREESOUND_CACHE_TTL_SEARCH_SECONDS;
+	}
+	if (path.endsWith("/analysis/")) {
+		return FREESOUND_CACHE_TTL_ANALYSIS_SECONDS;
+	}
+	//Sound instances: ".../sounds/<sound_id>/"
+	juce::StringArray pathParts = juce::StringArray::fromTokens(path, "/", "");
+	pathParts.removeEmptyStrings();
+	if (pathParts.size() >= 2 && pathParts[pathParts.size() - 2] == "sounds" && pathParts[pathParts.size() - 1].containsOnly("0123456789")) {
+		return FREESOUND_CACHE_TTL_SOUND_SECONDS;
+	}
+	return 0;
+}
+
+bool FSResponseCache::lookup(const juce::String& key, int maxAgeSeconds, juce::MemoryBlock& body)
+{
+	const juce::ScopedLock sl(lock);
+	juce::int64 now = timeSource != nullptr ? timeSource() : juce::Time::currentTimeMillis();
+	auto it = entriesByKey.find(key);
+	if (it == entriesByKey.end()) {
+		Entry entry;
+		if (!lookupOnDisk(key, entry)) {
+			return false;
+		}
+		addToMemory(entry);
+		it = entriesByKey.find(key);
+	}
+	else {
+		//Move to the front of the LRU list
+		entries.splice(entries.begin(), entries, it->second);
+	}
+	const Entry& entry = *it->second;
+	if (now - entry.storedAtMs > (juce::int64)maxAgeSeconds * 1000) {
+		return false;
+	}
+	body = entry.body;
+	return true;
+}
+
+void FSResponseCache::store(const juce::String& key, const juce::MemoryBlock& body)
+{
+	const juce::ScopedLock sl(lock);
+	Entry entry;
+	entry.key = key;
+	entry.body = body;
+	entry.storedAtMs = timeSource != nullptr ? timeSource() : juce::Time::currentTimeMillis();
+	addToMemory(entry);
+
+	if (diskLocation.isDirectory()) {
+		juce::MemoryOutputStream data;
+		data.writeString(key);
+		data.writeInt64(entry.storedAtMs);
+		data << body;
+		getDiskFile(key).replaceWithData(data.getData(), data.getDataSize());
+	}
+}
+
+void FSResponseCache::setTimeSource(std::function<juce::int64()> currentTimeMs)
+{
+	const juce::ScopedLock sl(lock);
+	timeSource = currentTimeMs;
+}
+
+juce::File FSResponseCache::getDiskFile(const juce::String& key)
+{
+	return diskLocation.getChildFile(juce::String::toHexString(key.hashCode64()) + ".fscache");
+}
+
+bool FSResponseCache::lookupOnDisk(const juce::String& key, Entry& entry)
+{
+	if (!diskLocation.isDirectory()) {
+		return false;
+	}
+	juce::FileInputStream input(getDiskFile(key));
+	if (!input.openedOk() || input.readString() != key) {
+		//No file or file for another key with the same hash
+		return false;
+	}
+	entry.key = key;
+	entry.storedAtMs = input.readInt64();
+	input.readIntoMemoryBlock(entry.body);
+	return entry.body.getSize() > 0;
+}
+
+void FSResponseCache::addToMemory(const Entry& entry)
+{
+	auto it = entriesByKey.find(entry.key);
+	if (it != entriesByKey.end()) {
+		entries.erase(it->second);
+		entriesByKey.erase(it);
+	}
+	entries.push_front(entry);
+	entriesByKey[entry.key] = entries.begin();
+	while ((int)entries.size() > FREESOUND_CACHE_MAX_MEMORY_ENTRIES) {
+		entriesByKey.erase(entries.back().key);
+		entries.pop_back();
 	}
-	//Couldnt create stream, return (-1, emptyVar)
-	return Response(statusCode, juce::var());
 }
 
 FSList::FSList()
@@ -789,6 +1426,16 @@ int FSList::getCount()
 
 FSSound::FSSound()
 {
+	channels = 0;
+	filesize = 0;
+	bitrate = 0;
+	bitdepth = 0;
+	duration = 0;
+	samplerate = 0;
+	numDownloads = 0;
+	avgRating = 0.0f;
+	numRatings = 0;
+	numComments = 0;
 }
 
 FSSound::FSSound(juce::var sound)
@@ -818,9 +1465,9 @@ FSSound::FSSound(juce::var sound)
 	bookmark = juce::URL(sound["bookmark"]);
 	previews = sound["previews"];
     images = sound["images"];
-	numDownloads = sound["images"];
-	avgRating = sound["num_downloads"];
-	numRatings = sound["avg_rating"];
+	numDownloads = sound["num_downloads"];
+	avgRating = sound["avg_rating"];
+	numRatings = sound["num_ratings"];
 	rate = juce::URL(sound["rate"]);
 	comments = juce::URL(sound["comments"]);
 	numComments = sound["num_comments"];
@@ -918,9 +1565,20 @@ juce::String FSPack::getID()
 	return id;
 }
 
-juce::Array<FSSound> SoundList::toArrayOfSounds()
+SoundList::SoundList(int count, juce::String nextPage, juce::String previousPage, juce::Array<FSSound> sounds)
 {
+	this->count = count;
+	this->nextPage = nextPage;
+	this->previousPage = previousPage;
+	parsedSounds = sounds;
+	hasParsedSounds = true;
+}
 
+juce::Array<FSSound> SoundList::toArrayOfSounds()
+{
+	if (hasParsedSounds) {
+		return parsedSounds;
+	}
 
 	juce::Array<FSSound> arrayOfSounds;
 
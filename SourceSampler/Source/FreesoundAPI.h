@@ -22,8 +22,19 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <future>
 
 #define FREESOUND_API_REQUEST_TIMEOUT 20000
+#define FREESOUND_API_STREAM_BUFFER_SIZE 16384  // Size of the buffer used when parsing responses while these are received
+#define FREESOUND_API_MAX_CONCURRENT_REQUESTS 4  // Number of asynchronous requests (see FreesoundClient::textSearchAsync and others) which can be in flight at the same time
+#ifndef FREESOUND_API_REUSE_CONNECTIONS
+#define FREESOUND_API_REUSE_CONNECTIONS (JUCE_LINUX && JUCE_USE_CURL)  // Make GET requests with libcurl handles sharing connections, DNS and TLS sessions, so consecutive requests to Freesound don't open a new connection each (JUCE's curl streams use a new handle per request; the system HTTP stacks JUCE uses on other platforms already reuse connections)
+#endif
+#define FREESOUND_CACHE_MAX_MEMORY_ENTRIES 256  // Number of responses kept in memory by FSResponseCache
+#define FREESOUND_CACHE_TTL_SEARCH_SECONDS 600  // Search results (text, content, combined and similarity)
+#define FREESOUND_CACHE_TTL_SOUND_SECONDS 86400  // Sound instances
+#define FREESOUND_CACHE_TTL_ANALYSIS_SECONDS 604800  // Sound analysis (does not change once computed)
+#define FREESOUND_CACHE_MAX_STALE_SECONDS 2592000  // Expired responses are still used if Freesound can't be reached, until they are this old
 
 /**
  * \typedef	std::pair<int, var> Response
@@ -547,6 +558,29 @@ class SoundList : public FSList {
 	using FSList::FSList;
 public:
 
+	/**
+	 * \fn	SoundList::SoundList();
+	 *
+	 * \brief	Default constructor, creates an empty list
+	 */
+
+	SoundList() = default;
+
+	/**
+	 * \fn	SoundList::SoundList(int count, String nextPage, String previousPage, Array<FSSound> sounds);
+	 *
+	 * \brief	Constructor from the sounds of a page which have already been parsed (see
+	 *			FSRequest::requestSoundList). Lists created this way have no "results" var
+	 *			(getResults returns an empty var), use toArrayOfSounds to get the sounds.
+	 *
+	 * \param	count			Total number of results.
+	 * \param	nextPage		URL for accessing the next page of results.
+	 * \param	previousPage	URL for accessing the previous page of results.
+	 * \param	sounds			The sounds of the page.
+	 */
+
+	SoundList(int count, juce::String nextPage, juce::String previousPage, juce::Array<FSSound> sounds);
+
 	/**
 	 * \fn	Array<FSSound> SoundList::toArrayOfSounds();
 	 *
@@ -559,6 +593,34 @@ public:
 	 */
 
     juce::Array<FSSound> toArrayOfSounds();
+
+private:
+	/** \brief	Sounds of the page if these were parsed directly from the response */
+    juce::Array<FSSound> parsedSounds;
+	/** \brief	True if the list was created from already parsed sounds */
+	bool hasParsedSounds = false;
+};
+
+/**
+ * \class	FreesoundAsyncRequestsPool
+ *
+ * \brief	Pool of threads which runs the asynchronous requests of FreesoundClient (up to
+ *			FREESOUND_API_MAX_CONCURRENT_REQUESTS at the same time). The pool is shared with a
+ *			juce::SharedResourcePointer and only exists while some object holds a pointer to it, so
+ *			applications using the asynchronous requests must hold a
+ *			juce::SharedResourcePointer<FreesoundAsyncRequestsPool> while they make requests. This way the
+ *			pool (and requests which are still running) is destroyed when the application releases it,
+ *			before JUCE shuts down.
+ */
+
+class FreesoundAsyncRequestsPool {
+public:
+	FreesoundAsyncRequestsPool() : pool(FREESOUND_API_MAX_CONCURRENT_REQUESTS) {}
+
+	void addJob(std::function<void()> job) { pool.addJob(job); }
+
+private:
+	juce::ThreadPool pool;
 };
 
 /**
@@ -603,6 +665,28 @@ private:
 	/** \brief	The authentication type*/
 	Authorization auth;
 
+	/**
+	 * \fn	template <typename ResultType> std::future<ResultType> FreesoundClient::runAsync(std::function<ResultType()> requestFunction);
+	 *
+	 * \brief	Runs a (blocking) request function in the asynchronous requests pool (see FreesoundAsyncRequestsPool)
+	 *
+	 * \param	requestFunction	The function which makes the request and returns its result.
+	 *
+	 * \returns	A future which will hold the result of the request.
+	 */
+
+	template <typename ResultType>
+	static std::future<ResultType> runAsync(std::function<ResultType()> requestFunction)
+	{
+		// std::function needs copyable jobs so the task is shared with the job
+		auto task = std::make_shared<std::packaged_task<ResultType()>>(requestFunction);
+		std::future<ResultType> result = task->get_future();
+		juce::SharedResourcePointer<FreesoundAsyncRequestsPool> requestsPool;
+		jassert(requestsPool.getReferenceCount() > 1);  // Nobody else holds the pool, it would be destroyed (waiting for the request) right away
+		requestsPool->addJob([task] { (*task)(); });
+		return result;
+	}
+
 
 public:
 
@@ -824,6 +908,50 @@ public:
 
     juce::var getSoundAnalysis(juce::String id, juce::String descriptors = juce::String(), int normalized = 0);
 
+	/**
+	 * \fn	std::future<SoundList> FreesoundClient::textSearchAsync(String query, String filter=String(), String sort="score", int groupByPack=0, int page=-1, int pageSize=-1, String fields = String(), String descriptors = String(), int normalized=0);
+	 *
+	 * \brief	Asynchronous version of textSearch. The request runs in a shared pool of threads
+	 *			(up to FREESOUND_API_MAX_CONCURRENT_REQUESTS requests in flight at the same time), 
+	 *			so the calling thread can start other requests or do other work while it completes.
+	 *			The request uses a copy of the client so the client can be deleted before the
+	 *			request finishes. This is also the case for the other asynchronous methods below.
+	 *
+	 * \returns	A future which will hold the SoundList with the text search results.
+	 */
+
+	std::future<SoundList> textSearchAsync(juce::String query, juce::String filter=juce::String(), juce::String sort="score", int groupByPack=0, int page=-1, int pageSize=-1, juce::String fields = juce::String(), juce::String descriptors = juce::String(), int normalized=0);
+
+	/**
+	 * \fn	std::future<SoundList> FreesoundClient::fetchNextPageAsync(SoundList fslist);
+	 *
+	 * \brief	Asynchronous version of fetchNextPage for SoundList
+	 *
+	 * \returns	A future which will hold the next page of results.
+	 */
+
+	std::future<SoundList> fetchNextPageAsync(SoundList fslist);
+
+	/**
+	 * \fn	std::future<FSSound> FreesoundClient::getSoundAsync(String id, String fields = String());
+	 *
+	 * \brief	Asynchronous version of getSound
+	 *
+	 * \returns	A future which will hold the FSSound instance.
+	 */
+
+	std::future<FSSound> getSoundAsync(juce::String id, juce::String fields = juce::String());
+
+	/**
+	 * \fn	std::future<var> FreesoundClient::getSoundAnalysisAsync(String id, String descriptors = String(), int normalized = 0);
+	 *
+	 * \brief	Asynchronous version of getSoundAnalysis
+	 *
+	 * \returns	A future which will hold the var dictionary containing the results of the analysis.
+	 */
+
+	std::future<juce::var> getSoundAnalysisAsync(juce::String id, juce::String descriptors = juce::String(), int normalized = 0);
+
 	/**
 	 * \fn	SoundList FreesoundClient::getSimilarSounds(String id, String descriptorsFilter = String(), int page = -1, int pageSize = -1, String fields = String(), String descriptors = String(), int normalized = 0);
 	 *
@@ -1212,7 +1340,7 @@ class FSRequest {
 public:
 
 	/**
-	 * \fn	FSRequest::FSRequest(URL uriToRequest, FreesoundClient clientToUse)
+	 * \fn	FSRequest::FSRequest(URL uriToRequest, FreesoundClient& clientToUse)
 	 *
 	 * \brief	The constructor for a request
 	 *
@@ -1223,7 +1351,7 @@ public:
 	 * \param	clientToUse 	The FSClient to use.
 	 */
 
-	FSRequest(juce::URL uriToRequest, FreesoundClient clientToUse)
+	FSRequest(juce::URL uriToRequest, FreesoundClient& clientToUse)
 		:client(clientToUse),
 		uri(uriToRequest)
 	{}
@@ -1245,10 +1373,145 @@ public:
 
 	Response request(juce::StringPairArray params = juce::StringPairArray(), juce::String data = juce::String(), bool postLikeRequest = true);
 
+	/**
+	 * \fn	SoundList FSRequest::requestSoundList(StringPairArray params = StringPairArray());
+	 *
+	 * \brief	Make a GET request to a FreesoundAPI endpoint which returns a list of sounds. Unlike
+	 *			request, the response is parsed while it is received and the sounds are filled in
+	 *			directly without building a var tree of the whole response (only the fields which
+	 *			are themselves dictionaries, such as previews or analysis, are stored as var).
+	 *			This is much faster for big pages of results, especially when analysis is included.
+	 *
+	 * \param	params	(Optional) The parameters for the request.
+	 *
+	 * \returns The list of sounds, or an empty list if the request failed or its body could not be parsed.
+	 */
+
+	SoundList requestSoundList(juce::StringPairArray params = juce::StringPairArray());
+
 private:
+
+	/**
+	 * \fn	int FSRequest::requestAndParse(StringPairArray params, String data, bool postLikeRequest, std::function<bool(InputStream&)> parseBody);
+	 *
+	 * \brief	Makes the request (or gets it from FSResponseCache) and passes the body of the response
+	 *			to parseBody, which returns false if the body could not be parsed
+	 *
+	 * \returns The status code of the response.
+	 */
+
+	int requestAndParse(juce::StringPairArray params, juce::String data, bool postLikeRequest, std::function<bool(juce::InputStream&)> parseBody);
+
 	/** \brief	The URI of the rrequest */
     juce::URL uri;
 	/** \brief	The client used*/
 	FreesoundClient& client;
 };
 
+
+/**
+ * \class	FSResponseCache
+ *
+ * \brief	Cache for the responses of Freesound API GET requests, used by FSRequest::request.
+ *			Responses are keyed by the request URL (including its parameters) and are kept
+ *			in an in-memory LRU list and, optionally, in files in a disk location so these
+ *			persist between sessions. Each endpoint has its own time to live (see
+ *			getTimeToLiveSeconds), endpoints with no time to live are never cached. If a
+ *			request fails because Freesound can't be reached, expired responses are used
+ *			as a fallback. A single instance is shared by all clients (see getSharedInstance).
+ *			As the cache is keyed by URL, it works the same when URIS::BASE points to a
+ *			local mock server.
+ */
+
+class FSResponseCache {
+public:
+
+	/**
+	 * \fn	static FSResponseCache& FSResponseCache::getSharedInstance();
+	 *
+	 * \brief	Gets the cache shared by all Freesound requests
+	 */
+
+	static FSResponseCache& getSharedInstance();
+
+	/**
+	 * \fn	void FSResponseCache::setDiskLocation(const juce::File& location);
+	 *
+	 * \brief	Enables storing responses on disk in the given directory (created if needed).
+	 *			Files older than FREESOUND_CACHE_MAX_STALE_SECONDS are deleted.
+	 *
+	 * \param	location	The directory where to store the responses.
+	 */
+
+	void setDiskLocation(const juce::File& location);
+
+	/**
+	 * \fn	static int FSResponseCache::getTimeToLiveSeconds(const juce::URL& url);
+	 *
+	 * \brief	Gets the time to live of the responses of an endpoint
+	 *
+	 * \param	url	The URL of the request.
+	 *
+	 * \returns	The time to live in seconds, 0 if responses of that endpoint should not be cached.
+	 */
+
+	static int getTimeToLiveSeconds(const juce::URL& url);
+
+	/**
+	 * \fn	bool FSResponseCache::lookup(const juce::String& key, int maxAgeSeconds, juce::MemoryBlock& body);
+	 *
+	 * \brief	Looks for a cached response, first in memory and then on disk. Responses are stored
+	 *			as returned by the server (and not parsed) so these can be parsed in the same way
+	 *			as responses coming from the network (see FSRequest::requestAndParse).
+	 *
+	 * \param	key				The key of the request (see FSRequest::requestAndParse).
+	 * \param	maxAgeSeconds	Responses older than this are ignored.
+	 * \param	body			Set to the body of the cached response if found.
+	 *
+	 * \returns	True if a response was found.
+	 */
+
+	bool lookup(const juce::String& key, int maxAgeSeconds, juce::MemoryBlock& body);
+
+	/**
+	 * \fn	void FSResponseCache::store(const juce::String& key, const juce::MemoryBlock& body);
+	 *
+	 * \brief	Stores a successful response in memory (and on disk if enabled)
+	 *
+	 * \param	key			The key of the request.
+	 * \param	body		The response as returned by the server.
+	 */
+
+	void store(const juce::String& key, const juce::MemoryBlock& body);
+
+	/**
+	 * \fn	void FSResponseCache::setTimeSource(std::function<juce::int64()> currentTimeMs);
+	 *
+	 * \brief	Sets the function used to get the current time when storing and looking up
+	 *			responses. Used by the tests to simulate the passing of time.
+	 *
+	 * \param	currentTimeMs	Returns the current time in milliseconds, nullptr to use
+	 *							juce::Time::currentTimeMillis (the default).
+	 */
+
+	void setTimeSource(std::function<juce::int64()> currentTimeMs);
+
+private:
+	struct Entry {
+		juce::String key;
+		juce::MemoryBlock body;
+		juce::int64 storedAtMs = 0;
+	};
+
+	juce::File getDiskFile(const juce::String& key);
+	bool lookupOnDisk(const juce::String& key, Entry& entry);
+	void addToMemory(const Entry& entry);
+
+	/** \brief	Most recently used entries first*/
+	std::list<Entry> entries;
+	std::map<juce::String, std::list<Entry>::iterator> entriesByKey;
+	juce::File diskLocation;
+	std::function<juce::int64()> timeSource;
+	juce::CriticalSection lock;
+};
+
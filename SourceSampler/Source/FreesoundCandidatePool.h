@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    FreesoundCandidatePool.h
+    Created: 19 Oct 2026 11:48:37pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "defines_source.h"
+#include "FreesoundAPI.h"
+#include "DownloadScheduler.h"
+#include <random>
+
+
+//==============================================================================
+// Results of the last Freesound query which were not loaded in the sampler. makeQueryAndLoadSounds only loads a few of
+// the (up to 100) results of a query, the rest are kept here so that later actions with the same query (e.g. replacing
+// a sound) can take them without querying Freesound again.
+// The previews of the first candidates are downloaded in the background to the same location where SourceSound expects
+// them, so when a candidate is taken, the sound is already in disk and it can be loaded right away. Prefetching only
+// starts when startPrefetching is called (once the sounds loaded from the query have queued their downloads), and uses
+// DownloadScheduler::prefetchPriority so prefetches never take the last download slot of the host. No more than
+// FREESOUND_CANDIDATE_POOL_NUM_PREFETCH previews are downloaded per query.
+// Prefetched previews (and partial downloads of them) stay in disk after the query changes, as later queries can return
+// the same sounds. These are tracked from oldest to newest until a sound takes them, and together are kept within
+// FREESOUND_CANDIDATE_POOL_MAX_PREFETCH_MB (plus the downloads in progress when it is reached): prefetching stops when
+// the budget is reached, and evictPrefetchedPreviews deletes the oldest previews which are not candidates of the current
+// query to make room for the new ones.
+// The next page of results of the query can be requested in the background while the candidates are used. Its results
+// are only added to the candidates when these run out.
+
+class FreesoundCandidatePool: public DownloadScheduler::Listener
+{
+public:
+    FreesoundCandidatePool() {}
+
+    ~FreesoundCandidatePool()
+    {
+        downloadScheduler->cancelDownloads (this);
+    }
+
+    // Replaces the candidates with the remaining results of a new query. queryKey identifies the query (text and filters),
+    // numResults is the total number of results reported by Freesound. If prefetchLocation is a directory, the previews of
+    // the first candidates will be downloaded there (see startPrefetching). If nextPageOfResults is valid, it will hold the
+    // following page of results
+    void setCandidates (const juce::String& queryKey, int numResults, const juce::Array<FSSound>& remainingResults, const juce::File& prefetchLocation,
+                        std::future<SoundList> nextPageOfResults = {})
+    {
+        // Cancel prefetching of the previous candidates before changing them (partial files are kept and will be resumed
+        // if these sounds are needed later)
+        downloadScheduler->cancelDownloads (this);
+
+        const juce::ScopedLock sl (lock);
+        candidatesQueryKey = queryKey;
+        candidatesNumResults = numResults;
+        candidatesTimeMs = juce::Time::getMillisecondCounterHiRes();
+        candidates = remainingResults;
+        nextPage = std::move (nextPageOfResults);
+        location = prefetchLocation;
+        prefetchQueue.clear();
+        prefetchesInProgress.clear();
+        prefetchingStarted = false;
+        evictionMayBeNeeded = true;
+        if (location.isDirectory()){
+            for (int i=0; i<juce::jmin(FREESOUND_CANDIDATE_POOL_NUM_PREFETCH, candidates.size()); i++){
+                prefetchQueue.add (candidates.getReference(i).id);
+            }
+        }
+    }
+
+    bool isWaitingToStartPrefetching()
+    {
+        const juce::ScopedLock sl (lock);
+        return !prefetchingStarted && prefetchQueue.size() > 0;
+    }
+
+    bool isPrefetching()
+    {
+        const juce::ScopedLock sl (lock);
+        return prefetchesInProgress.size() > 0;
+    }
+
+    // Starts downloading the previews of the first candidates. Should be called once the downloads of the sounds being
+    // loaded have been queued (or have finished) so prefetches don't start before these
+    void startPrefetching()
+    {
+        const juce::ScopedLock sl (lock);
+        prefetchingStarted = true;
+        scheduleNextPrefetches();
+    }
+
+    // Takes numSounds candidates for the given query, preferring those whose preview is already downloaded. Returns false
+    // (and takes nothing) if the candidates are from another query, have expired or there are not enough of them
+    bool takeCandidates (const juce::String& queryKey, int numSounds, juce::Array<FSSound>& result, int& numResults)
+    {
+        addNextPageToCandidatesIfNeeded (queryKey, numSounds);
+
+        bool takenCandidateIsBeingPrefetched = false;
+        {
+            const juce::ScopedLock sl (lock);
+            if (queryKey != candidatesQueryKey || candidates.size() < numSounds || juce::Time::getMillisecondCounterHiRes() - candidatesTimeMs > FREESOUND_CACHE_TTL_SEARCH_SECONDS * 1000.0){
+                return false;
+            }
+            // Stable partition keeps the (random) order of the candidates within each group
+            std::stable_partition (candidates.begin(), candidates.end(), [this](const FSSound& sound){ return isPreviewInDisk (sound.id); });
+            for (int i=0; i<numSounds; i++){
+                const juce::String& soundId = candidates.getReference(i).id;
+                result.add (candidates.getReference(i));
+                prefetchQueue.removeString (soundId);
+                prefetchedPreviews.removeFirstMatchingValue (getPreviewLocation (soundId));  // Owned by the sound that takes it from now on
+                takenCandidateIsBeingPrefetched = takenCandidateIsBeingPrefetched || prefetchesInProgress.contains (soundId);
+            }
+            candidates.removeRange (0, numSounds);
+            numResults = candidatesNumResults;
+        }
+
+        if (takenCandidateIsBeingPrefetched){
+            // The sound that takes the candidate will download the preview to the same location, so prefetching must be
+            // stopped (it will resume the partially downloaded file). Prefetches of the other candidates are queued again
+            downloadScheduler->cancelDownloads (this);
+            const juce::ScopedLock sl (lock);
+            for (int i=prefetchesInProgress.size() - 1; i>=0; i--){
+                if (getCandidateIndex (prefetchesInProgress[i]) >= 0){
+                    prefetchQueue.insert (0, prefetchesInProgress[i]);
+                }
+            }
+            prefetchesInProgress.clear();
+            scheduleNextPrefetches();
+        }
+        return true;
+    }
+
+    // Deletes the oldest prefetched previews (and partial downloads) which are not candidates of the current query until
+    // the prefetched previews use less than FREESOUND_CANDIDATE_POOL_MAX_PREFETCH_MB, then resumes prefetching if it was
+    // stopped by the budget. Called periodically, so previews of previous queries are evicted one by one while the ones of
+    // the current query are downloaded. isSoundInUse tells if a sound with the given id was loaded by other means than
+    // taking a candidate (e.g. by a query which returned it again): its preview is not deleted, only no longer tracked.
+    // Does nothing if no prefetch finished and no candidates were set since the last call
+    void evictPrefetchedPreviews (std::function<bool (const juce::String&)> isSoundInUse)
+    {
+        const juce::ScopedLock sl (lock);
+        if (!evictionMayBeNeeded){
+            return;
+        }
+        evictionMayBeNeeded = false;
+        prefetchedPreviews.removeIf ([this](const juce::File& preview){
+            return getSizeInDisk (preview) == 0 && !prefetchesInProgress.contains (preview.getFileNameWithoutExtension());  // Deleted by other means
+        });
+        juce::int64 totalBytes = getPrefetchedBytes();
+        for (int i=0; i<prefetchedPreviews.size() && totalBytes >= getMaxPrefetchedBytes();){
+            juce::File preview = prefetchedPreviews[i];
+            juce::String soundId = preview.getFileNameWithoutExtension();
+            if (prefetchesInProgress.contains (soundId) || getCandidateIndex (soundId) >= 0){
+                i++;
+                continue;
+            }
+            totalBytes -= getSizeInDisk (preview);
+            if (!isSoundInUse (soundId)){
+                preview.deleteFile();
+                DownloadScheduler::getPartialFileLocation (preview).deleteFile();
+            }
+            prefetchedPreviews.remove (i);
+        }
+        scheduleNextPrefetches();
+    }
+
+    //==============================================================================
+    void scheduledDownloadProgress (const juce::File&, juce::int64, juce::int64) override {}
+
+    void scheduledDownloadFinished (const juce::File& targetFileLocation, bool) override
+    {
+        // Failed downloads stay tracked, their partial file (if any) is kept to resume them and counts for the budget
+        const juce::ScopedLock sl (lock);
+        prefetchesInProgress.removeString (targetFileLocation.getFileNameWithoutExtension());
+        evictionMayBeNeeded = true;
+        scheduleNextPrefetches();
+    }
+
+private:
+    void addNextPageToCandidatesIfNeeded (const juce::String& queryKey, int numSounds)
+    {
+        // If there are not enough candidates for the query but the next page of results was requested, wait for it (it will
+        // normally have arrived already) and add its results to the candidates. The lock is not held while waiting
+        std::future<SoundList> pendingNextPage;
+        {
+            const juce::ScopedLock sl (lock);
+            if (queryKey != candidatesQueryKey || candidates.size() >= numSounds || !nextPage.valid()){
+                return;
+            }
+            pendingNextPage = std::move (nextPage);
+        }
+        juce::Array<FSSound> nextPageResults = pendingNextPage.get().toArrayOfSounds();
+        unsigned seed = (unsigned) juce::Time::currentTimeMillis();
+        std::shuffle (nextPageResults.begin(), nextPageResults.end(), std::default_random_engine (seed));
+
+        const juce::ScopedLock sl (lock);
+        if (queryKey == candidatesQueryKey){
+            candidates.addArray (nextPageResults);
+        }
+    }
+
+    juce::File getPreviewLocation (const juce::String& soundId) const
+    {
+        // Must match the location used by SourceSound::getFreesoundFileLocation for previews
+        return location.getChildFile (soundId).withFileExtension ("ogg");
+    }
+
+    int getCandidateIndex (const juce::String& soundId) const
+    {
+        for (int i=0; i<candidates.size(); i++){
+            if (candidates.getReference(i).id == soundId){
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool isPreviewInDisk (const juce::String& soundId) const
+    {
+        return location.isDirectory() && getPreviewLocation (soundId).existsAsFile();
+    }
+
+    static juce::int64 getSizeInDisk (const juce::File& preview)
+    {
+        return preview.getSize() + DownloadScheduler::getPartialFileLocation (preview).getSize();  // getSize returns 0 for files that don't exist
+    }
+
+    static juce::int64 getMaxPrefetchedBytes()
+    {
+        return (juce::int64)FREESOUND_CANDIDATE_POOL_MAX_PREFETCH_MB * 1024 * 1024;
+    }
+
+    juce::int64 getPrefetchedBytes() const
+    {
+        juce::int64 totalBytes = 0;
+        for (const auto& preview: prefetchedPreviews){
+            totalBytes += getSizeInDisk (preview);
+        }
+        return totalBytes;
+    }
+
+    void scheduleNextPrefetches()
+    {
+        if (!prefetchingStarted){
+            return;
+        }
+        // Only a couple of downloads are queued at a time so the budget can be checked with the sizes of the files in disk
+        // (the size of the previews is not part of the query results)
+        while (prefetchesInProgress.size() < FREESOUND_CANDIDATE_POOL_MAX_PARALLEL_PREFETCH && prefetchQueue.size() > 0 && getPrefetchedBytes() < getMaxPrefetchedBytes()){
+            juce::String soundId = prefetchQueue[0];
+            prefetchQueue.remove (0);
+            int candidateIndex = getCandidateIndex (soundId);
+            if (candidateIndex < 0 || isPreviewInDisk (soundId)){
+                continue;
+            }
+            prefetchesInProgress.add (soundId);
+            prefetchedPreviews.removeFirstMatchingValue (getPreviewLocation (soundId));  // A partial download of a previous query becomes the newest
+            prefetchedPreviews.add (getPreviewLocation (soundId));
+            downloadScheduler->addDownload (candidates.getReference(candidateIndex).getOGGPreviewURL(), getPreviewLocation (soundId), "", DownloadScheduler::prefetchPriority, this);
+        }
+    }
+
+    juce::CriticalSection lock;  // Download callbacks come from the scheduler worker threads
+    juce::String candidatesQueryKey;
+    int candidatesNumResults = 0;
+    double candidatesTimeMs = 0.0;
+    juce::Array<FSSound> candidates;
+    std::future<SoundList> nextPage;  // Next page of results of the query (if it was requested)
+    juce::File location;
+    juce::StringArray prefetchQueue;  // Sound ids of the candidates whose preview is still to be downloaded
+    juce::StringArray prefetchesInProgress;  // Sound ids of the candidates whose preview is being downloaded
+    juce::Array<juce::File> prefetchedPreviews;  // Previews downloaded (or being downloaded) by the pool and not taken yet, oldest first, of this and previous queries
+    bool prefetchingStarted = false;
+    bool evictionMayBeNeeded = false;
+    juce::SharedResourcePointer<DownloadScheduler> downloadScheduler;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FreesoundCandidatePool)
+};
@@ -17,16 +17,27 @@
 
 
 //==============================================================================
+#ifndef JucePlugin_PreferredChannelConfigurations
+static juce::AudioProcessor::BusesProperties createBusesProperties()
+{
+    // Main stereo output plus NUM_OUTPUT_BUSES - 1 auxiliary stereo outputs which are disabled by default. Sounds can be
+    // routed to any of these with the "outputBus" parameter
+    juce::AudioProcessor::BusesProperties buses;
+   #if ! JucePlugin_IsMidiEffect
+    #if ! JucePlugin_IsSynth
+    buses = buses.withInput  ("Input",  juce::AudioChannelSet::stereo(), true);
+    #endif
+    buses = buses.withOutput ("Output", juce::AudioChannelSet::stereo(), true);
+    for (int i = 1; i < NUM_OUTPUT_BUSES; i++)
+        buses = buses.withOutput ("Output " + juce::String (i + 1), juce::AudioChannelSet::stereo(), false);
+   #endif
+    return buses;
+}
+#endif
+
 SourceSamplerAudioProcessor::SourceSamplerAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                      #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                      #endif
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-                     #endif
-                       )
+     : AudioProcessor (createBusesProperties())
 #endif
 {
     source.setTotalNumOutputChannels(getTotalNumOutputChannels());
@@ -107,6 +118,18 @@ void SourceSamplerAudioProcessor::changeProgramName (int index, const juce::Stri
 //==============================================================================
 void SourceSamplerAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    // Buses layout might have changed since the plugin was created, so pass the position of the channels of each
+    // output bus in the process block buffer so voices can render directly in the bus they're routed to
+    OutputBusesLayout outputBusesLayout;
+    for (int i = 0; i < juce::jmin(getBusCount(false), NUM_OUTPUT_BUSES); i++){
+        auto* bus = getBus(false, i);
+        if ((bus != nullptr) && bus->isEnabled()){
+            outputBusesLayout[i].firstChannel = bus->getChannelIndexInProcessBlockBuffer(0);
+            outputBusesLayout[i].numChannels = bus->getNumberOfChannels();
+        }
+    }
+    source.setTotalNumOutputChannels(getTotalNumOutputChannels());
+    source.setOutputBusesLayout(outputBusesLayout);
     source.prepareToPlay(sampleRate, samplesPerBlock);
     #if INCLUDE_SEQUENCER
     sequencer.prepareSequencer(samplesPerBlock, sampleRate);
@@ -126,10 +149,15 @@ bool SourceSamplerAudioProcessor::isBusesLayoutSupported (const BusesLayout& lay
     return true;
   #else
     // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
+    // Main output can be mono or stereo, auxiliary outputs must be stereo (or disabled)
     if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
      && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
+    
+    for (int i = 1; i < layouts.outputBuses.size(); i++){
+        if (!layouts.outputBuses[i].isDisabled() && layouts.outputBuses[i] != juce::AudioChannelSet::stereo())
+            return false;
+    }
 
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
@@ -171,21 +199,18 @@ juce::AudioProcessorEditor* SourceSamplerAudioProcessor::createEditor()
 
 void SourceSamplerAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // Save current state information to memory block
-    std::unique_ptr<juce::XmlElement> xml ( source.state.createXml());
+    // Save current state information to memory block (this copies a snapshot of the state which is only re-created
+    // when the state changes, see SourceSampler::getStateSnapshot)
     DBG("> Running getStateInformation");
-    DBG(xml->toString()); // Print state for debugging purposes (print it nicely indented)
-    copyXmlToBinary (*xml, destData);
+    source.getStateSnapshot(destData);
 }
 
 void SourceSamplerAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     // Called by the plugin host to load state stored in host into plugin
+    // State is parsed in a background thread and applied later in the message thread so the host is not blocked
     DBG("> Running setStateInformation");
-    std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
-    if (xmlState.get() != nullptr){
-        source.loadPresetFromStateInformation(juce::ValueTree::fromXml(*xmlState.get()));
-    }
+    source.restoreStateInformationAsync(data, sizeInBytes);
 }
 
 //==============================================================================
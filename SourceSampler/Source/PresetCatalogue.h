@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    PresetCatalogue.h
+    Created: 19 Oct 2026 7:12:05pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "defines_source.h"
+#include "PresetFile.h"
+
+
+//==============================================================================
+// Summary of the preset files stored in the presets folder (name, number of sounds, total size of the samples and
+// modification time of the preset file), persisted to a catalogue file in the same folder. Hosts ask for the names of
+// all programs when building program lists (128 of them), so these are served from the catalogue instead of parsing
+// every preset file.
+// Entries are updated incrementally when presets are saved or renamed. Entries whose preset file has been modified by
+// other means (or that are missing from the catalogue) are re-created by parsing that preset file only, so the
+// catalogue never needs to be rebuilt as a whole. Modified catalogues are written to disk with saveIfNeeded, which is
+// called periodically from the message thread.
+
+class PresetCatalogue
+{
+public:
+    struct Entry
+    {
+        int index = -1;
+        juce::String name;
+        int numSounds = 0;
+        juce::int64 totalSampleBytes = 0;
+        juce::int64 modificationTime = 0;  // Modification time of the preset file (in ms) when the entry was created
+    };
+
+    PresetCatalogue() {}
+
+    // Sets the folder where preset files are stored and loads the catalogue file found there (if any)
+    void setLocation (const juce::File& presetFilesLocation)
+    {
+        const juce::ScopedLock sl (lock);
+        location = presetFilesLocation;
+        entries.clear();
+        hasUnsavedChanges = false;
+
+        std::unique_ptr<juce::XmlElement> xml = juce::XmlDocument::parse (getCatalogueFile());
+        if (xml == nullptr || !xml->hasTagName (PRESET_CATALOGUE_XML_TAG)){
+            return;
+        }
+        for (auto* entryXml: xml->getChildWithTagNameIterator (PRESET_CATALOGUE_ENTRY_XML_TAG)){
+            Entry entry;
+            entry.index = entryXml->getIntAttribute ("index", -1);
+            entry.name = entryXml->getStringAttribute (SourceIDs::name);
+            entry.numSounds = entryXml->getIntAttribute ("numSounds");
+            entry.totalSampleBytes = entryXml->getStringAttribute ("totalSampleBytes").getLargeIntValue();
+            entry.modificationTime = entryXml->getStringAttribute ("modificationTime").getLargeIntValue();
+            if (entry.index >= 0){
+                entries[entry.index] = entry;
+            }
+        }
+    }
+
+    // Returns the catalogue entry for the preset with the given index, re-creating it if the preset file changed since the
+    // entry was created. Returns false if there is no preset file for that index
+    bool getEntry (int index, const juce::File& presetFile, Entry& entry)
+    {
+        const juce::ScopedLock sl (lock);
+        if (!presetFile.existsAsFile()){
+            if (entries.erase (index) > 0){
+                hasUnsavedChanges = true;
+            }
+            return false;
+        }
+        auto it = entries.find (index);
+        if (it == entries.end() || it->second.modificationTime != presetFile.getLastModificationTime().toMilliseconds()){
+            // Analysis data is not needed for the catalogue so it is not read
+            juce::ValueTree presetState = PresetFile::readPresetState (presetFile, false);
+            if (!presetState.isValid()){
+                return false;
+            }
+            updateEntry (index, presetState, presetFile);
+            it = entries.find (index);
+        }
+        entry = it->second;
+        return true;
+    }
+
+    juce::String getPresetName (int index, const juce::File& presetFile)
+    {
+        Entry entry;
+        if (getEntry (index, presetFile, entry)){
+            return entry.name;
+        }
+        return {};
+    }
+
+    // Updates the entry of a preset from its state. Must be called after the preset file has been written so the modification
+    // time stored in the entry matches that of the file
+    void updateEntry (int index, const juce::ValueTree& presetState, const juce::File& presetFile)
+    {
+        const juce::ScopedLock sl (lock);
+        Entry entry;
+        entry.index = index;
+        entry.name = presetState.getProperty (SourceIDs::name).toString();
+        entry.modificationTime = presetFile.getLastModificationTime().toMilliseconds();
+        // Old format preset files have the sounds inside a "soundsInfo" node and are not counted
+        for (const auto& soundState: presetState){
+            if (soundState.hasType (SourceIDs::SOUND)){
+                entry.numSounds += 1;
+                for (const auto& sampleState: soundState){
+                    if (sampleState.hasType (SourceIDs::SOUND_SAMPLE)){
+                        entry.totalSampleBytes += (juce::int64)sampleState.getProperty (SourceIDs::filesize, 0);
+                    }
+                }
+            }
+        }
+        entries[index] = entry;
+        hasUnsavedChanges = true;
+    }
+
+    // Writes the catalogue file if entries have changed since it was last written
+    void saveIfNeeded()
+    {
+        const juce::ScopedLock sl (lock);
+        if (!hasUnsavedChanges || !location.isDirectory()){
+            return;
+        }
+        juce::XmlElement xml (PRESET_CATALOGUE_XML_TAG);
+        for (const auto& it: entries){
+            const Entry& entry = it.second;
+            auto* entryXml = xml.createNewChildElement (PRESET_CATALOGUE_ENTRY_XML_TAG);
+            entryXml->setAttribute ("index", entry.index);
+            entryXml->setAttribute (SourceIDs::name, entry.name);
+            entryXml->setAttribute ("numSounds", entry.numSounds);
+            entryXml->setAttribute ("totalSampleBytes", juce::String (entry.totalSampleBytes));
+            entryXml->setAttribute ("modificationTime", juce::String (entry.modificationTime));
+        }
+        if (xml.writeTo (getCatalogueFile())){
+            hasUnsavedChanges = false;
+        }
+    }
+
+private:
+    juce::File getCatalogueFile() const
+    {
+        return location.getChildFile (PRESET_CATALOGUE_FILENAME);
+    }
+
+    juce::CriticalSection lock;  // getProgramName can be called by the host from any thread
+    juce::File location;
+    std::map<int, Entry> entries;
+    bool hasUnsavedChanges = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PresetCatalogue)
+};
@@ -0,0 +1,231 @@
+/*
+  ==============================================================================
+
+    PresetFile.h
+    Created: 19 Oct 2026 8:03:51pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "defines_source.h"
+
+
+//==============================================================================
+// Reading and writing of preset files. Presets are stored in a versioned binary format made of a header, a chunk
+// index and the chunks themselves:
+//
+//   "SRCP" | version (int32) | number of chunks (int32) | N x [chunk type (int32), offset (int64), size (int64)] | chunks...
+//
+// The preset state (sounds, samples, parameters and MIDI mappings) is stored in the "preset" chunk using the binary
+// ValueTree serialisation, which is much faster to parse than XML. The ANALYSIS nodes of the samples (the onsets of
+// big multisample presets can be a large part of the file) are moved to a separate "analysis" chunk which readers
+// only seek to when they need it (e.g. the preset catalogue only reads the preset chunk).
+// Preset files saved with previous versions of the plugin are XML files, these are still imported transparently.
+
+namespace PresetFile
+{
+    enum ChunkType
+    {
+        presetChunk = 1,
+        analysisChunk = 2
+    };
+
+    inline juce::uint32 getMagicNumber()
+    {
+        return juce::ByteOrder::littleEndianInt ("SRCP");
+    }
+
+    inline bool isLegacyXmlFile (const juce::File& file)
+    {
+        return file.hasFileExtension ("xml");
+    }
+
+    // Reads the header and chunk index of a binary preset file and returns the offsets of the preset and analysis chunks
+    // (-1 if not present). Returns false if the file is not a valid preset file or was saved with a newer version of the format
+    inline bool readChunkOffsets (juce::InputStream& input, const juce::File& file, juce::int64& presetChunkOffset, juce::int64& analysisChunkOffset)
+    {
+        presetChunkOffset = -1;
+        analysisChunkOffset = -1;
+        if ((juce::uint32)input.readInt() != getMagicNumber()){
+            return false;
+        }
+        int version = input.readInt();
+        if (version > PRESET_FILE_FORMAT_VERSION){
+            DBG("Preset file " + file.getFullPathName() + " was saved with a newer version of the preset format");
+            return false;
+        }
+        int numChunks = input.readInt();
+        for (int i=0; i<numChunks; i++){
+            int chunkType = input.readInt();
+            juce::int64 offset = input.readInt64();
+            input.readInt64();  // Chunk size, not needed as chunks are self-delimiting
+            if (chunkType == presetChunk){
+                presetChunkOffset = offset;
+            } else if (chunkType == analysisChunk){
+                analysisChunkOffset = offset;
+            }
+            // Chunk types added in newer versions of the format are ignored
+        }
+        return true;
+    }
+
+    // Reads the entries of the analysis chunk (the stream must be positioned at the start of the chunk) and calls
+    // entryRead(soundIndex, sampleIndex, analysis) for each of them
+    inline void readAnalysisEntries (juce::InputStream& input, std::function<void(int, int, const juce::ValueTree&)> entryRead)
+    {
+        int numAnalysisEntries = input.readInt();
+        for (int i=0; i<numAnalysisEntries && !input.isExhausted(); i++){
+            int soundIndex = input.readInt();
+            int sampleIndex = input.readInt();
+            juce::ValueTree analysis = juce::ValueTree::readFromStream (input);
+            if (analysis.isValid()){
+                entryRead (soundIndex, sampleIndex, analysis);
+            }
+        }
+    }
+
+    // Reads the preset state stored in a file (either in binary or legacy XML format). Analysis data is only read from
+    // binary files if includeAnalysis is true (XML files always include it). Returns an invalid ValueTree if the file does
+    // not exist or can't be parsed
+    inline juce::ValueTree readPresetState (const juce::File& file, bool includeAnalysis)
+    {
+        if (isLegacyXmlFile (file)){
+            std::unique_ptr<juce::XmlElement> xml = juce::XmlDocument::parse (file);
+            if (xml == nullptr){
+                return {};
+            }
+            return juce::ValueTree::fromXml (*xml);
+        }
+
+        juce::FileInputStream input (file);
+        juce::int64 presetChunkOffset, analysisChunkOffset;
+        if (!input.openedOk() || !readChunkOffsets (input, file, presetChunkOffset, analysisChunkOffset)){
+            return {};
+        }
+        if (presetChunkOffset < 0 || !input.setPosition (presetChunkOffset)){
+            return {};
+        }
+        juce::ValueTree presetState = juce::ValueTree::readFromStream (input);
+
+        if (includeAnalysis && presetState.isValid() && analysisChunkOffset >= 0 && input.setPosition (analysisChunkOffset)){
+            readAnalysisEntries (input, [&presetState](int soundIndex, int sampleIndex, const juce::ValueTree& analysis){
+                juce::ValueTree sampleState = presetState.getChild(soundIndex).getChild(sampleIndex);
+                if (sampleState.isValid()){
+                    sampleState.addChild (analysis, -1, nullptr);
+                }
+            });
+        }
+        return presetState;
+    }
+
+    //==============================================================================
+    // Lazy loading of analysis data. When a preset is loaded, only the preset chunk is read and the sounds are marked with
+    // the file and position their analysis data comes from. The analysis nodes are attached later by the loader thread of
+    // each sound (before its SourceSamplerSound(s) are created, as these read the onsets), so the message thread does not
+    // parse the analysis chunk.
+
+    inline void markAnalysisAsPending (juce::ValueTree presetState, const juce::File& file)
+    {
+        if (isLegacyXmlFile (file)){
+            return;  // XML files are read with analysis data included
+        }
+        for (int i=0; i<presetState.getNumChildren(); i++){
+            juce::ValueTree soundState = presetState.getChild(i);
+            if (soundState.hasType(SourceIDs::SOUND)){
+                soundState.setProperty (SourceIDs::pendingAnalysisFile, file.getFullPathName(), nullptr);
+                soundState.setProperty (SourceIDs::pendingAnalysisSoundIndex, i, nullptr);
+            }
+        }
+    }
+
+    // Reads the analysis data of a sound marked with markAnalysisAsPending and adds it to its samples (samples which already
+    // have analysis data are not modified). Does nothing if the sound is not marked.
+    inline void attachPendingAnalysis (juce::ValueTree soundState)
+    {
+        if (!soundState.hasProperty (SourceIDs::pendingAnalysisFile)){
+            return;
+        }
+        juce::File file (soundState.getProperty (SourceIDs::pendingAnalysisFile).toString());
+        int soundIndex = soundState.getProperty (SourceIDs::pendingAnalysisSoundIndex, -1);
+        soundState.removeProperty (SourceIDs::pendingAnalysisFile, nullptr);
+        soundState.removeProperty (SourceIDs::pendingAnalysisSoundIndex, nullptr);
+
+        juce::FileInputStream input (file);
+        juce::int64 presetChunkOffset, analysisChunkOffset;
+        if (!input.openedOk() || !readChunkOffsets (input, file, presetChunkOffset, analysisChunkOffset)){
+            return;
+        }
+        if (analysisChunkOffset < 0 || !input.setPosition (analysisChunkOffset)){
+            return;
+        }
+        readAnalysisEntries (input, [&soundState, soundIndex](int entrySoundIndex, int sampleIndex, const juce::ValueTree& analysis){
+            juce::ValueTree sampleState = soundState.getChild(sampleIndex);
+            if ((entrySoundIndex == soundIndex) && sampleState.hasType(SourceIDs::SOUND_SAMPLE) && !sampleState.getChildWithName(SourceIDs::ANALYSIS).isValid()){
+                sampleState.addChild (analysis, -1, nullptr);
+            }
+        });
+    }
+
+    //==============================================================================
+    inline bool writePresetState (const juce::ValueTree& presetState, const juce::File& file)
+    {
+        // Move analysis data to its own chunk. Analysis nodes are identified by the position of the sound and the sample
+        // they belong to
+        juce::ValueTree presetStateWithoutAnalysis = presetState.createCopy();
+        juce::MemoryOutputStream analysisData;
+        juce::MemoryOutputStream analysisEntries;
+        int numAnalysisEntries = 0;
+        for (int i=0; i<presetStateWithoutAnalysis.getNumChildren(); i++){
+            juce::ValueTree soundState = presetStateWithoutAnalysis.getChild(i);
+            attachPendingAnalysis (soundState);  // If the preset is saved before the loader thread attached analysis data
+            for (int j=0; j<soundState.getNumChildren(); j++){
+                juce::ValueTree sampleState = soundState.getChild(j);
+                juce::ValueTree analysis = sampleState.getChildWithName(SourceIDs::ANALYSIS);
+                if (sampleState.hasType(SourceIDs::SOUND_SAMPLE) && analysis.isValid()){
+                    analysisEntries.writeInt (i);
+                    analysisEntries.writeInt (j);
+                    analysis.writeToStream (analysisEntries);
+                    sampleState.removeChild (analysis, nullptr);
+                    numAnalysisEntries += 1;
+                }
+            }
+        }
+        analysisData.writeInt (numAnalysisEntries);
+        analysisData << analysisEntries.getMemoryBlock();
+
+        juce::MemoryOutputStream presetData;
+        presetStateWithoutAnalysis.writeToStream (presetData);
+
+        const int numChunks = 2;
+        const juce::int64 headerSize = 3 * sizeof (juce::int32) + numChunks * (sizeof (juce::int32) + 2 * sizeof (juce::int64));
+
+        // Write to a temporary file first so an existing preset is not lost if writing fails
+        juce::TemporaryFile tempFile (file);
+        {
+            juce::FileOutputStream output (tempFile.getFile());
+            if (!output.openedOk()){
+                return false;
+            }
+            output.writeInt ((int)getMagicNumber());
+            output.writeInt (PRESET_FILE_FORMAT_VERSION);
+            output.writeInt (numChunks);
+            output.writeInt (presetChunk);
+            output.writeInt64 (headerSize);
+            output.writeInt64 ((juce::int64)presetData.getDataSize());
+            output.writeInt (analysisChunk);
+            output.writeInt64 (headerSize + (juce::int64)presetData.getDataSize());
+            output.writeInt64 ((juce::int64)analysisData.getDataSize());
+            output.write (presetData.getData(), presetData.getDataSize());
+            output.write (analysisData.getData(), analysisData.getDataSize());
+            output.flush();
+            if (output.getStatus().failed()){
+                return false;
+            }
+        }
+        return tempFile.overwriteTargetFileWithTemporary();
+    }
+}
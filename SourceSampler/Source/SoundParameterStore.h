@@ -0,0 +1,189 @@
+/*
+  ==============================================================================
+
+    SoundParameterStore.h
+    Created: 19 Oct 2026 4:41:37pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <bitset>
+#include "defines_source.h"
+
+
+//==============================================================================
+// Storage for the parameters of a SourceSound. Parameter values live in an array of atomics indexed by ParamId (ranges
+// and defaults come from the paramInfos table generated in defines_source.h). The atomics are the only thing the audio
+// thread ever reads, so voices never touch the ValueTree (or CachedValues bound to it).
+// The store also keeps the values in sync with the sound's ValueTree state in both directions:
+//  - Changes made to the state by other means (e.g. undo, state synchronisation with a remote UI) are picked up by a
+//    ValueTree listener and copied to the atomics.
+//  - Values set from the message thread are written to the state right away (so listeners behave as they used to).
+//    Values set from other threads (e.g. MIDI CC modulations in the audio thread) are only flagged, and written to
+//    the state later from the message thread by calling writeChangesToState periodically.
+
+class SoundParameterStore: private juce::ValueTree::Listener
+{
+public:
+    typedef std::bitset<(size_t)ParamId::numParams> ParamIdSet;
+
+    SoundParameterStore() {}
+
+    ~SoundParameterStore() override
+    {
+        state.removeListener (this);
+    }
+
+    // Adds missing parameters to the state using the default values, loads the current values into the atomics and
+    // starts listening to changes in the state
+    void bindState (juce::ValueTree& stateToSync)
+    {
+        state.removeListener (this);
+        state = stateToSync;
+        for (size_t i = 0; i < (size_t)ParamId::numParams; i++){
+            auto paramId = (ParamId)i;
+            const auto& identifier = getIdentifier (paramId);
+            if (!state.hasProperty (identifier)){
+                state.setProperty (identifier, toVar (paramId, paramInfos[i].defaultValue), nullptr);
+            }
+            values[i].store (constrain (paramId, (float)state.getProperty (identifier)), std::memory_order_relaxed);
+        }
+        state.addListener (this);
+    }
+
+    float get (ParamId paramId) const noexcept
+    {
+        return values[(size_t)paramId].load (std::memory_order_relaxed);
+    }
+
+    // Can be called from any thread. Values are limited to the parameter range (and rounded for integer parameters). If called
+    // from the message thread the value is also written to the state, otherwise it is flagged and written by the next call to
+    // writeChangesToState
+    void set (ParamId paramId, float value)
+    {
+        values[(size_t)paramId].store (constrain (paramId, value), std::memory_order_relaxed);
+        if (juce::MessageManager::existsAndIsCurrentThread()){
+            writeToState ((size_t)paramId);
+        } else {
+            flagForWriteBack (paramId);
+        }
+    }
+
+    // Same as set but never writes to the state, for use in the audio thread where checking the current thread is not needed.
+    // Values are not constrained here so callers must make sure these are in range
+    void setDeferred (ParamId paramId, float value) noexcept
+    {
+        values[(size_t)paramId].store (value, std::memory_order_relaxed);
+        flagForWriteBack (paramId);
+    }
+
+    // Writes the flagged parameters to the state. Must be called from the message thread. Returns the set of parameters
+    // that were written so callers can react to these changes
+    ParamIdSet writeChangesToState()
+    {
+        ParamIdSet written;
+        if (!hasParametersToWriteBack.exchange (false)){
+            return written;
+        }
+        for (size_t i = 0; i < (size_t)ParamId::numParams; i++){
+            if (needsWriteBack[i].exchange (false)){
+                writeToState (i);
+                written.set (i);
+            }
+        }
+        return written;
+    }
+
+    // Maps the identifier of a parameter to its ParamId using a hash map (so the string based API used by actions and
+    // the UI does not need to compare the identifier with all parameter names). Returns false if there is no parameter
+    // with that name
+    static bool findParamId (const juce::Identifier& identifier, ParamId& paramId)
+    {
+        const auto& lookup = getNameLookup();
+        auto name = identifier.toString();
+        if (!lookup.paramIdsByName.contains (name)){
+            return false;
+        }
+        paramId = (ParamId)lookup.paramIdsByName[name];
+        return true;
+    }
+
+    static const juce::Identifier& getIdentifier (ParamId paramId)
+    {
+        return getNameLookup().identifiers[(size_t)paramId];
+    }
+
+    static float constrain (ParamId paramId, float value) noexcept
+    {
+        const auto& info = getParamInfo (paramId);
+        value = juce::jlimit (info.minValue, info.maxValue, value);
+        return info.isInteger ? (float)juce::roundToInt (value) : value;
+    }
+
+private:
+    void flagForWriteBack (ParamId paramId) noexcept
+    {
+        needsWriteBack[(size_t)paramId].store (true);
+        hasParametersToWriteBack.store (true);
+    }
+
+    struct NameLookup
+    {
+        NameLookup()
+        {
+            for (size_t i = 0; i < (size_t)ParamId::numParams; i++){
+                identifiers[i] = paramInfos[i].name;
+                paramIdsByName.set (paramInfos[i].name, (int)i);
+            }
+        }
+
+        std::array<juce::Identifier, (size_t)ParamId::numParams> identifiers;
+        juce::HashMap<juce::String, int> paramIdsByName;
+    };
+
+    static const NameLookup& getNameLookup()
+    {
+        static const NameLookup lookup;
+        return lookup;
+    }
+
+    static juce::var toVar (ParamId paramId, float value)
+    {
+        if (getParamInfo (paramId).isInteger){
+            return juce::var (juce::roundToInt (value));
+        }
+        return juce::var (value);
+    }
+
+    void writeToState (size_t i)
+    {
+        // Changes made here should not be copied back to the atomics by the listener, otherwise a newer value set from another
+        // thread in the meantime could be overwritten by the one being written
+        const juce::ScopedValueSetter<bool> svs (isWritingToState, true);
+        auto paramId = (ParamId)i;
+        state.setProperty (getIdentifier (paramId), toVar (paramId, values[i].load (std::memory_order_relaxed)), nullptr);
+    }
+
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override
+    {
+        if (isWritingToState || (tree != state)){
+            return;
+        }
+        ParamId paramId;
+        if (findParamId (property, paramId)){
+            values[(size_t)paramId].store (constrain (paramId, (float)tree.getProperty (property)), std::memory_order_relaxed);
+        }
+    }
+
+    juce::ValueTree state;
+    std::array<std::atomic<float>, (size_t)ParamId::numParams> values {};
+    std::array<std::atomic<bool>, (size_t)ParamId::numParams> needsWriteBack {};
+    std::atomic<bool> hasParametersToWriteBack { false };
+    bool isWritingToState = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SoundParameterStore)
+};
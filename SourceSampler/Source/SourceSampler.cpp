@@ -19,6 +19,7 @@
 //==============================================================================
 SourceSampler::SourceSampler():
     queryMakerThread (*this),
+    stateRestoreThread (*this),
     serverInterface ([this]{return getGlobalContext();})
 {
     std::cout << "Creating needed directories" << std::endl;
@@ -49,6 +50,10 @@ SourceSampler::SourceSampler():
     //loadGlobalPersistentStateFromFile();
     // NOTE: loading global persistent state is now part of the bindState method
     
+    // Create the first snapshot of the state now so hosts asking for it before the first timer callback (possibly from
+    // another thread) don't get an empty state
+    updateStateSnapshotIfNeeded(true);
+    
     // Notify that plugin is running
     #if SYNC_STATE_WITH_OSC
     sendOSCMessage(juce::OSCMessage("/plugin_started"));
@@ -63,6 +68,8 @@ SourceSampler::~SourceSampler()
     // Save current global persistent state (global settings)
     saveGlobalPersistentStateToFile();
     
+    stateRestoreThread.stopThread(2000);
+    
     // Remove listeners
     serverInterface.removeActionListener(this);
     sampler.removeActionListener(this);
@@ -95,7 +102,17 @@ void SourceSampler::bindState()
     // Load global settings stored in file, now before sounds are created as these might need the oauth token
     loadGlobalPersistentStateFromFile();
     
-    juce::ValueTree preset = state.getChildWithName(SourceIDs::PRESET);
+    bindPresetProperties(state.getChildWithName(SourceIDs::PRESET));
+    
+    // Swap pointer with oldSound so if there were objects in there still pending to be safely deleted, these will be
+    // deleted when needed. Then create a new SourceSoundList with the new preset information
+    soundsOld.swap(sounds);
+    sounds.reset();
+    sounds = std::make_unique<SourceSoundList>(state.getChildWithName(SourceIDs::PRESET), [this]{return getGlobalContext();});
+}
+
+void SourceSampler::bindPresetProperties(juce::ValueTree preset)
+{
     SourceHelpers::addPropertyWithDefaultValueIfNotExisting(preset, SourceIDs::numVoices, SourceDefaults::numVoices);
     numVoices.referTo(preset, SourceIDs::numVoices, nullptr, SourceDefaults::numVoices);
     SourceHelpers::addPropertyWithDefaultValueIfNotExisting(preset, SourceIDs::name, SourceHelpers::defaultPresetName());
@@ -114,12 +131,6 @@ void SourceSampler::bindState()
     reverbWidth.referTo(preset, SourceIDs::reverbWidth, nullptr, SourceDefaults::reverbWidth);
     SourceHelpers::addPropertyWithDefaultValueIfNotExisting(preset, SourceIDs::reverbFreezeMode, SourceDefaults::reverbFreezeMode);
     reverbFreezeMode.referTo(preset, SourceIDs::reverbFreezeMode, nullptr, SourceDefaults::reverbFreezeMode);
-    
-    // Swap pointer with oldSound so if there were objects in there still pending to be safely deleted, these will be
-    // deleted when needed. Then create a new SourceSoundList with the new preset information
-    soundsOld.swap(sounds);
-    sounds.reset();
-    sounds = std::make_unique<SourceSoundList>(state.getChildWithName(SourceIDs::PRESET), [this]{return getGlobalContext();});
 }
 
 void SourceSampler::createDirectories(const juce::String& appDirectoryName)
@@ -153,6 +164,11 @@ void SourceSampler::createDirectories(const juce::String& appDirectoryName)
     if (!tmpFilesLocation.exists()){
         tmpFilesLocation.createDirectory();
     }
+    presetCatalogue.setLocation(presetFilesLocation);
+    
+    #if USE_FREESOUND_RESPONSE_DISK_CACHE
+    FSResponseCache::getSharedInstance().setDiskLocation(sourceDataLocation.getChildFile("freesound_cache"));
+    #endif
 }
 
 GlobalContextStruct SourceSampler::getGlobalContext()
@@ -189,6 +205,16 @@ void SourceSampler::setTotalNumOutputChannels(int numChannels) {
     numberOfChannels = numChannels;
 }
 
+void SourceSampler::setOutputBusesLayout(const OutputBusesLayout& layout) {
+    // Main output bus is used for previews and level metering, the rest of buses are only used by the sampler voices
+    mainOutputBus = layout[0];
+    sampler.setOutputBusesLayout(layout);
+}
+
+int SourceSampler::getMainOutputNumChannels() {
+    return mainOutputBus.numChannels;
+}
+
 void SourceSampler::prepareToPlay (double _sampleRate, int _samplesPerBlock)
 {
     // Save sample rate and block size to global properties because these might be needed in other parts of the processing chain
@@ -204,7 +230,7 @@ void SourceSampler::prepareToPlay (double _sampleRate, int _samplesPerBlock)
     transportSource.prepareToPlay (blockSize, sampleRate);
     
     // Configure level measurer
-    lms.resize(getTotalNumOutputChannels(), 200 * 0.001f * sampleRate / blockSize); // 200ms average window
+    lms.resize(getMainOutputNumChannels(), 200 * 0.001f * sampleRate / blockSize); // 200ms average window
     
     // Loaded the last loaded preset (only in ELK platform)
     # if LOADED_LATEST_LOADED_PRESET_AT_STARTUP
@@ -241,18 +267,54 @@ void SourceSampler::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBu
     }
     
     // Add MIDI messages from editor to the midiMessages buffer so when we click in the sound from the editor
-    // it gets played here
-    midiMessages.addEvents(midiFromEditor, 0, buffer.getNumSamples(), 0);
-    midiFromEditor.clear();
+    // it gets played here. Messages are placed at the sample offset corresponding to the time they were received,
+    // relative to the start of the previous block (see addMidiMessageFromEditor). This means that messages are played
+    // with a constant latency of one block and relative timing between them is preserved. Messages received after this
+    // block started are kept for the next block. If the lock can't be taken (the message thread is adding a message
+    // right now), messages will be added in the next block.
+    double blockStartTimeMs = juce::Time::getMillisecondCounterHiRes();
+    {
+        const juce::SpinLock::ScopedTryLockType lock (midiFromEditorLock);
+        if (lock.isLocked()){
+            int numKeptMessages = 0;
+            for (int i=0; i<numMidiFromEditor; i++){
+                auto& messageFromEditor = midiFromEditor[i];
+                if ((lastBlockStartTimeMs > 0.0) && (messageFromEditor.receivedTimeMs >= blockStartTimeMs)){
+                    midiFromEditor[numKeptMessages++] = messageFromEditor;
+                    continue;
+                }
+                int sampleOffset = 0;
+                if (lastBlockStartTimeMs > 0.0){
+                    sampleOffset = (int)((messageFromEditor.receivedTimeMs - lastBlockStartTimeMs) * 0.001 * sampleRate);
+                }
+                midiMessages.addEvent(messageFromEditor.message, juce::jlimit(0, juce::jmax(0, buffer.getNumSamples() - 1), sampleOffset));
+            }
+            numMidiFromEditor = numKeptMessages;
+        }
+    }
+    lastBlockStartTimeMs = blockStartTimeMs;
+    
+    // Refer to the channels of the main output bus (auxiliary output buses, if enabled, come after these)
+    int mainBusFirstChannel = juce::jlimit(0, buffer.getNumChannels(), mainOutputBus.firstChannel);
+    int mainBusNumChannels = juce::jlimit(0, buffer.getNumChannels() - mainBusFirstChannel, mainOutputBus.numChannels);
+    juce::AudioBuffer<float> mainBusBuffer (buffer.getArrayOfWritePointers() + mainBusFirstChannel, mainBusNumChannels, buffer.getNumSamples());
+    
+    // Clear channels not in the main bus as these might contain garbage (main bus channels are overwritten by the preview player)
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++){
+        if ((channel < mainBusFirstChannel) || (channel >= mainBusFirstChannel + mainBusNumChannels)){
+            buffer.clear(channel, 0, buffer.getNumSamples());
+        }
+    }
     
-    // Render preview player into buffer
-    transportSource.getNextAudioBlock(juce::AudioSourceChannelInfo(buffer));
+    // Render preview player into main bus
+    transportSource.getNextAudioBlock(juce::AudioSourceChannelInfo(mainBusBuffer));
     
-    // Render sampler voices into buffer
+    // Render sampler voices into buffer (each voice renders in the channels of its output bus)
+    sampler.setGlobalMidiInChannel(globalMidiInChannel.get());
     sampler.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
     
-    // Measure audio levels (will be store in lms object itself)
-    lms.measureBlock (buffer);
+    // Measure audio levels of the main bus (will be store in lms object itself)
+    lms.measureBlock (mainBusBuffer);
     
     // Remove midi messages from buffer if these should not be forwarded
     if (!midiOutForwardsMidiIn.get()){
@@ -275,48 +337,43 @@ void SourceSampler::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBu
 
 juce::String SourceSampler::getPresetFilenameByIndex(int index)
 {
-    return (juce::String)index + ".xml";
+    return (juce::String)index;  // The extension depends on the preset file format (see getPresetFilePath)
 }
 
 juce::String SourceSampler::getPresetNameByIndex(int index)
 {
-    juce::File location = getPresetFilePath(getPresetFilenameByIndex(index));
-    if (location.existsAsFile()){
-        juce::XmlDocument xmlDocument (location);
-        std::unique_ptr<juce::XmlElement> xmlState = xmlDocument.getDocumentElement();
-        if (xmlState.get() != nullptr){
-            juce::ValueTree state = juce::ValueTree::fromXml(*xmlState.get());
-            if (state.hasProperty(SourceIDs::name)){
-                return state.getProperty(SourceIDs::name).toString();
-            }
-        }
-    }
-    return {};
+    // Names are served from the preset catalogue so that hosts listing all programs don't trigger parsing all preset files
+    return presetCatalogue.getPresetName(index, findPresetFile(getPresetFilenameByIndex(index)));
 }
 
 void SourceSampler::renamePreset(int index, const juce::String& newName)
 {
-    juce::File location = getPresetFilePath(getPresetFilenameByIndex(index));
+    if (index == stagedPresetIndex){
+        discardStagedPreset();
+    }
+    juce::File location = findPresetFile(getPresetFilenameByIndex(index));
     if (location.existsAsFile()){
-        juce::XmlDocument xmlDocument (location);
-        std::unique_ptr<juce::XmlElement> xmlState = xmlDocument.getDocumentElement();
-        if (xmlState.get() != nullptr){
-            juce::ValueTree state = juce::ValueTree::fromXml(*xmlState.get());
+        juce::ValueTree state = PresetFile::readPresetState(location, true);
+        if (state.isValid()){
             state.setProperty(SourceIDs::name, newName, nullptr);
-            std::unique_ptr<juce::XmlElement> updatedXmlState (state.createXml());
             juce::String filename = getPresetFilenameFromNameAndIndex(newName, index);
             juce::File location = getPresetFilePath(filename);
-            if (location.existsAsFile()){
-                // If already exists, delete it
-                location.deleteFile();
+            if (PresetFile::writePresetState(state, location)){
+                // Presets in the legacy XML format are converted to the binary format when renamed
+                getLegacyPresetFilePath(filename).deleteFile();
+                presetCatalogue.updateEntry(index, state, location);
+                presetCatalogue.saveIfNeeded();  // Save now as the ELK UI reads preset names from the catalogue
             }
-            updatedXmlState->writeTo(location);
         }
     }
 }
 
 void SourceSampler::saveCurrentPresetToFile (const juce::String& _presetName, int index)
 {
+    if (index == stagedPresetIndex){
+        // Staged preset would be outdated
+        discardStagedPreset();
+    }
     juce::ValueTree presetState = state.getChildWithName(SourceIDs::PRESET);
     if (presetState.isValid()){
         
@@ -330,27 +387,28 @@ void SourceSampler::saveCurrentPresetToFile (const juce::String& _presetName, in
             presetName = _presetName;
         }
         
-        std::unique_ptr<juce::XmlElement> xml (presetState.createXml());
         juce::String filename = getPresetFilenameFromNameAndIndex(presetName, index);
         juce::File location = getPresetFilePath(filename);
-        if (location.existsAsFile()){
-            // If already exists, delete it
-            location.deleteFile();
-        }
         DBG("Saving preset to: " + location.getFullPathName());
-        xml->writeTo(location);
+        if (PresetFile::writePresetState(presetState, location)){
+            // Remove the legacy XML preset file with that index (if any) so it is not loaded instead of the new one
+            getLegacyPresetFilePath(filename).deleteFile();
+            presetCatalogue.updateEntry(index, presetState, location);
+            presetCatalogue.saveIfNeeded();  // Save now as the ELK UI reads preset names from the catalogue
+        }
     }
 }
 
-bool SourceSampler::loadPresetFromFile (const juce::String& fileName)
+juce::ValueTree SourceSampler::loadPresetStateFromFile (const juce::String& fileName)
 {
-    juce::File location = getPresetFilePath(fileName);
+    // Read a preset file and return its PRESET state (converting it from the old format if needed), or an invalid
+    // ValueTree if the file does not exist or can't be parsed. Analysis data is not read here, it is attached later by
+    // the loader thread of each sound (see PresetFile::markAnalysisAsPending)
+    juce::File location = findPresetFile(fileName);
     if (location.existsAsFile()){
-        juce::XmlDocument xmlDocument (location);
-        std::unique_ptr<juce::XmlElement> xmlState = xmlDocument.getDocumentElement();
-        if (xmlState.get() != nullptr){
-            juce::ValueTree newState = SourceHelpers::createNewStateFromCurrentSatate(state);
-            juce::ValueTree presetState = juce::ValueTree::fromXml(*xmlState.get());
+        juce::ValueTree presetState = PresetFile::readPresetState(location, false);
+        if (presetState.isValid()){
+            PresetFile::markAnalysisAsPending(presetState, location);
             // Check if preset has old format, and if so transform it to the new format
             // In old format, root preset node type is "SourcePresetState", in the new one it is "PRESET"
             if (presetState.getType().toString() == "SourcePresetState"){
@@ -420,51 +478,170 @@ bool SourceSampler::loadPresetFromFile (const juce::String& fileName)
                 }
                 presetState = modifiedPresetState;
             }
-            newState.addChild (presetState, -1, nullptr);
-            loadPresetFromStateInformation(newState);
-            return true;
+            return presetState;
         }
     }
-    return false; // No file found
+    return {}; // No file found
 }
 
-void SourceSampler::loadPresetFromIndex(int index)
+bool SourceSampler::loadPresetFromFile (const juce::String& fileName)
 {
-    // Load the preset from the file, this will also clear any existing sounds
-    bool loaded = loadPresetFromFile(getPresetFilenameByIndex(index));
-    if (loaded){
-        // If file was loaded, update the current present index to the new one
-        currentPresetIndex = index;
-    } else {
-        // If no file was loaded (no file found or errors ocurred), create a new empty preset
-        DBG("Creating new empty preset");
+    juce::ValueTree presetState = loadPresetStateFromFile(fileName);
+    if (presetState.isValid()){
         juce::ValueTree newState = SourceHelpers::createNewStateFromCurrentSatate(state);
-        juce::ValueTree newPresetState = SourceHelpers::createEmptyPresetState();
-        newState.addChild(newPresetState, -1, nullptr);
+        newState.addChild (presetState, -1, nullptr);
         loadPresetFromStateInformation(newState);
+        return true;
+    }
+    return false; // No file found
+}
+
+void SourceSampler::loadPresetFromIndex(int index, bool fromProgramChange)
+{
+    int previousPresetIndex = currentPresetIndex;
+    #if ENABLE_PRESET_STAGING
+    if (isStagedPresetReady(index)){
+        // The preset was already loaded in the background, swap it in
+        swapToStagedPreset();
         currentPresetIndex = index;
+    } else
+    #endif
+    {
+        // Load the preset from the file, this will also clear any existing sounds
+        bool loaded = loadPresetFromFile(getPresetFilenameByIndex(index));
+        if (loaded){
+            // If file was loaded, update the current present index to the new one
+            currentPresetIndex = index;
+        } else {
+            // If no file was loaded (no file found or errors ocurred), create a new empty preset
+            DBG("Creating new empty preset");
+            juce::ValueTree newState = SourceHelpers::createNewStateFromCurrentSatate(state);
+            juce::ValueTree newPresetState = SourceHelpers::createEmptyPresetState();
+            newState.addChild(newPresetState, -1, nullptr);
+            loadPresetFromStateInformation(newState);
+            currentPresetIndex = index;
+        }
     }
     saveGlobalPersistentStateToFile(); // Save global settings to file (which inlucdes the latest loaded preset index)
     
+    #if ENABLE_PRESET_STAGING
+    // When stepping through presets with program changes, start loading the next preset so it is ready if it is requested next.
+    // Other loads (at startup, from the UI or jumping to a non-consecutive preset) don't stage presets as it would double the
+    // downloads, decoding and memory used for a preset which might never be loaded
+    if (fromProgramChange && (index == previousPresetIndex + 1) && (index + 1 < 128)){
+        stagePreset(index + 1);
+    } else {
+        discardStagedPreset();
+    }
+    #endif
+    
     // Trigger action to re-send full state to UI clients
     actionListenerCallback(juce::String(ACTION_GET_STATE) + juce::String(":full"));
 }
 
-void SourceSampler::loadPresetFromStateInformation (juce::ValueTree _state)
+void SourceSampler::stagePreset(int index)
 {
-    // If sounds are currently loaded in the state, remove them all
-    // This will trigger the deletion of SampleSound and SourceSamplerSound objects
-    juce::ValueTree presetState = state.getChildWithName(SourceIDs::PRESET);
-    if (presetState.isValid()){
-        removeAllSounds();
+    // Load the preset with the given index into a standby SourceSoundList which is not attached to the state. Sounds are downloaded,
+    // decoded and stretched by their loader threads as usual, but their SourceSamplerSound(s) are not added to the sampler until the
+    // preset is swapped in (see swapToStagedPreset)
+    if ((stagedSounds != nullptr) && (stagedPresetIndex == index)){
+        return;  // Already staged (or being staged)
+    }
+    discardStagedPreset();
+    juce::ValueTree presetState = loadPresetStateFromFile(getPresetFilenameByIndex(index));
+    if (!presetState.isValid()){
+        return;
+    }
+    DBG("Staging preset " << index);
+    stagedPresetState = presetState;
+    stagedPresetIndex = index;
+    stagedSounds = std::make_unique<SourceSoundList>(stagedPresetState, [this]{return getGlobalContext();}, false);
+}
+
+void SourceSampler::discardStagedPreset()
+{
+    stagedSounds.reset();
+    stagedPresetState = juce::ValueTree();
+    stagedPresetIndex = -1;
+}
+
+bool SourceSampler::isStagedPresetReady(int index)
+{
+    return (stagedSounds != nullptr) && (stagedPresetIndex == index) && stagedSounds->allSoundsFinishedLoading();
+}
+
+void SourceSampler::swapToStagedPreset()
+{
+    // Replace the current preset with the staged one. Removing the current sounds and adding the staged ones happens with the
+    // sampler lock held, so the audio thread sees the change in one step at a block boundary. Notes playing current sounds are
+    // released (not cut) and these sounds are deleted once the notes finish. Sounds of the preset replaced in a previous swap
+    // are deleted now (with soundsOld), so notes still playing these are cut.
+    // The samplerSoundCreateDeleteLock of the staged sounds is taken before the sampler lock, as in the rest of the code.
+    jassert(stagedSounds != nullptr);
+    DBG("Swapping to staged preset " << stagedPresetIndex);
+    {
+        const juce::ScopedLock sl (soundDeleteLock);
+        juce::OwnedArray<juce::ScopedLock> stagedSoundsLocks;
+        for (auto* sound: stagedSounds->objects){
+            stagedSoundsLocks.add(new juce::ScopedLock(sound->samplerSoundCreateDeleteLock));
+        }
+        const juce::ScopedLock samplerLock (sampler.getLock());
+        if (soundsOld != nullptr){
+            for (auto* sound: soundsOld->objects){
+                sound->scheduleSoundDeletion();
+            }
+        }
+        removeAllSounds(true);
+        for (auto* sound: stagedSounds->objects){
+            sound->addStagedSourceSamplerSoundsToSampler();
+        }
     }
     
-    // Load new state informaiton to the state
-    DBG("Loading state...");
-    state.copyPropertiesAndChildrenFrom(_state, nullptr);
+    // Sounds added to the preset from now on should be added to the sampler as usual
+    stagedSounds->addSoundsToSamplerWhenLoaded = true;
     
-    // Trigger bind state again to re-create sounds and the rest
-    bindState();
+    juce::ValueTree currentPresetState = state.getChildWithName(SourceIDs::PRESET);
+    if (currentPresetState.isValid()){
+        state.removeChild(currentPresetState, nullptr);
+    }
+    state.addChild(stagedPresetState, -1, nullptr);
+    bindPresetProperties(stagedPresetState);
+    
+    // Same as in bindState, old sounds are kept in soundsOld until these are safely deleted
+    soundsOld.swap(sounds);
+    sounds = std::move(stagedSounds);
+    stagedPresetState = juce::ValueTree();
+    stagedPresetIndex = -1;
+    
+    updateReverbParameters();
+    if (sampler.getNumVoices() != juce::jmin((int)numVoices, (int)SourceSamplerSynthesiser::maxNumVoices)){
+        // Only re-create voices if polyphony changed, otherwise notes ringing from the previous preset would be cut
+        sampler.setSamplerVoices(numVoices);
+    }
+    setGlobalMidiInChannel(globalMidiInChannel);
+}
+
+void SourceSampler::loadPresetFromStateInformation (juce::ValueTree _state)
+{
+    // If a preset is already loaded, load the new one incrementally so sounds which are in both presets don't need to be
+    // re-loaded (see loadPresetIncrementally)
+    juce::ValueTree presetState = state.getChildWithName(SourceIDs::PRESET);
+    if (presetState.isValid() && _state.getChildWithName(SourceIDs::PRESET).isValid() && (sounds != nullptr)){
+        loadPresetIncrementally(_state);
+    } else {
+        // If sounds are currently loaded in the state, remove them all
+        // This will trigger the deletion of SampleSound and SourceSamplerSound objects
+        if (presetState.isValid()){
+            removeAllSounds();
+        }
+        
+        // Load new state informaiton to the state
+        DBG("Loading state...");
+        state.copyPropertiesAndChildrenFrom(_state, nullptr);
+        
+        // Trigger bind state again to re-create sounds and the rest
+        bindState();
+    }
     
     // Run some more actions needed to sync some parameters which are not automatically loaded from state
     updateReverbParameters();
@@ -472,6 +649,70 @@ void SourceSampler::loadPresetFromStateInformation (juce::ValueTree _state)
     setGlobalMidiInChannel(globalMidiInChannel);
 }
 
+void SourceSampler::loadPresetIncrementally (juce::ValueTree _state)
+{
+    // Load a new preset by diffing it with the currently loaded one instead of removing all sounds and creating them again.
+    // Sounds in the new preset whose audio content (sample files and stretch parameters) matches a loaded sound re-use that
+    // SourceSound and its SourceSamplerSound(s), so audio is not decoded and stretched again and only parameters, note mappings
+    // and MIDI CC mappings are updated. Other sounds are added to the preset (and loaded as usual) and the loaded sounds which
+    // are not used in the new preset are scheduled for deletion.
+    DBG("Loading state incrementally...");
+    const juce::ScopedLock sl (soundDeleteLock);
+    
+    for (int i=0; i<_state.getNumProperties(); i++){
+        auto property = _state.getPropertyName(i);
+        state.setProperty(property, _state.getProperty(property), nullptr);
+    }
+    loadGlobalPersistentStateFromFile();
+    
+    juce::ValueTree presetState = state.getChildWithName(SourceIDs::PRESET);
+    juce::ValueTree newPresetState = _state.getChildWithName(SourceIDs::PRESET);
+    presetState.copyPropertiesFrom(newPresetState, nullptr);
+    bindPresetProperties(presetState);
+    
+    std::vector<SourceSound*> reusableSounds;
+    for (auto* sound: sounds->objects){
+        if (!sound->isScheduledForDeletion()){
+            reusableSounds.push_back(sound);
+        }
+    }
+    
+    int numReused = 0;
+    std::vector<juce::ValueTree> soundStatesInNewOrder;
+    for (int i=0; i<newPresetState.getNumChildren(); i++){
+        auto newSoundState = newPresetState.getChild(i);
+        if (!newSoundState.hasType(SourceIDs::SOUND)){
+            continue;
+        }
+        auto match = std::find_if(reusableSounds.begin(), reusableSounds.end(), [&newSoundState](SourceSound* sound){
+            return sound->canBeUpdatedInPlaceFrom(newSoundState);
+        });
+        if (match != reusableSounds.end()){
+            (*match)->updateInPlaceFrom(newSoundState);
+            soundStatesInNewOrder.push_back((*match)->state);
+            reusableSounds.erase(match);
+            numReused += 1;
+        } else {
+            auto soundStateCopy = newSoundState.createCopy();
+            presetState.addChild(soundStateCopy, -1, nullptr);
+            soundStatesInNewOrder.push_back(soundStateCopy);
+        }
+    }
+    
+    for (auto* sound: reusableSounds){
+        sound->scheduleSoundDeletion();
+    }
+    
+    // Make the order of the sounds the same as in the new preset (sounds scheduled for deletion are left at the end)
+    for (int i=0; i<(int)soundStatesInNewOrder.size(); i++){
+        int currentIndex = presetState.indexOf(soundStatesInNewOrder[i]);
+        if (currentIndex != i){
+            presetState.moveChild(currentIndex, i, nullptr);
+        }
+    }
+    DBG("Re-used " << numReused << " sound(s), " << (int)soundStatesInNewOrder.size() - numReused << " new sound(s) to load");
+}
+
 void SourceSampler::saveGlobalPersistentStateToFile()
 {
     // This is to save settings that need to persist between sampler runs and that do not
@@ -523,10 +764,28 @@ void SourceSampler::loadGlobalPersistentStateFromFile()
 
 
 juce::File SourceSampler::getPresetFilePath(const juce::String& presetFilename)
+{
+    return presetFilesLocation.getChildFile(presetFilename).withFileExtension(PRESET_FILE_EXTENSION);
+}
+
+juce::File SourceSampler::getLegacyPresetFilePath(const juce::String& presetFilename)
 {
     return presetFilesLocation.getChildFile(presetFilename).withFileExtension("xml");
 }
 
+juce::File SourceSampler::findPresetFile(const juce::String& presetFilename)
+{
+    // Return the binary preset file if it exists, otherwise the XML preset file saved by older versions (if it exists)
+    juce::File location = getPresetFilePath(presetFilename);
+    if (!location.existsAsFile()){
+        juce::File legacyLocation = getLegacyPresetFilePath(presetFilename);
+        if (legacyLocation.existsAsFile()){
+            return legacyLocation;
+        }
+    }
+    return location;
+}
+
 
 juce::String SourceSampler::getPresetFilenameFromNameAndIndex(const juce::String& presetName, int index)
 {
@@ -574,13 +833,168 @@ juce::ValueTree SourceSampler::collectVolatileStateInformation (){
     state.setProperty(SourceIDs::voiceSoundPlayPosition, voiceSoundPlayPositions, nullptr);
     
     juce::String audioLevels = "";
-    for (int i=0; i<getTotalNumOutputChannels(); i++){
+    for (int i=0; i<getMainOutputNumChannels(); i++){
         audioLevels += (juce::String)lms.getRMSLevel(i) + ",";
     }
     state.setProperty(SourceIDs::audioLevels, audioLevels, nullptr);
+    state.setProperty(SourceIDs::numSkippedVoiceBlocks, sampler.getNumSkippedVoiceBlocks(), nullptr);
+    state.setProperty(SourceIDs::stateRestoreProgress, stateRestoreProgress.load(), nullptr);
+    state.setProperty(SourceIDs::queryToFirstSoundPlayableMs, lastQueryToFirstSoundPlayableMs, nullptr);
     return state;
 }
 
+//==============================================================================
+
+void SourceSampler::getStateSnapshot (juce::MemoryBlock& destData)
+{
+    // Copy the latest snapshot of the state to destData. Snapshots are serialisations of the state which are only
+    // re-created when the state changed since the last one, so hosts that save the state often (e.g. autosave) just get
+    // a copy of the memory block. If called from the message thread the snapshot is updated first, otherwise the latest
+    // snapshot created from the timer is used (which can be up to STATE_SNAPSHOT_MIN_INTERVAL_MS old). The first snapshot
+    // is created in the constructor so there is always one to return
+    if (juce::MessageManager::existsAndIsCurrentThread()){
+        updateStateSnapshotIfNeeded(true);
+    }
+    const juce::ScopedLock sl (stateSnapshotLock);
+    if (stateDataToRestore.getSize() > 0){
+        // A state restore is still in progress, return the state that is being restored instead of the current one
+        destData = stateDataToRestore;
+    } else {
+        destData = stateSnapshot;
+    }
+}
+
+void SourceSampler::updateStateSnapshotIfNeeded (bool force)
+{
+    // Must be called from the message thread
+    juce::uint32 currentStateVersion = stateVersion.load();
+    if (currentStateVersion == stateSnapshotVersion){
+        return;
+    }
+    double now = juce::Time::getMillisecondCounterHiRes();
+    if (!force && (now - lastStateSnapshotTimeMs < STATE_SNAPSHOT_MIN_INTERVAL_MS)){
+        return;
+    }
+    // Snapshots use the same XML format as previous versions of the plugin so these can still open the saved state
+    juce::MemoryBlock snapshotData;
+    if (std::unique_ptr<juce::XmlElement> xml = state.createXml()){
+        juce::AudioProcessor::copyXmlToBinary(*xml, snapshotData);
+    }
+    {
+        const juce::ScopedLock sl (stateSnapshotLock);
+        stateSnapshot.swapWith(snapshotData);
+    }
+    stateSnapshotVersion = currentStateVersion;
+    lastStateSnapshotTimeMs = now;
+}
+
+void SourceSampler::restoreStateInformationAsync (const void* data, int sizeInBytes)
+{
+    // Queue the state passed by the host to be restored. The data is parsed in a background thread and the resulting
+    // state is applied from the timer in the message thread (see applyRestoredStateIfReady), so this returns immediately.
+    // If a new state is passed before the previous one was applied, the previous one is discarded
+    if (sizeInBytes <= 0){
+        return;
+    }
+    {
+        const juce::ScopedLock sl (stateSnapshotLock);
+        stateDataToRestore.replaceAll(data, (size_t)sizeInBytes);
+        stateToRestoreRequestId += 1;
+        parsedStateToRestore = juce::ValueTree();
+    }
+    stateRestoreProgress = 0.0f;
+    stateRestoreThread.startThread();
+}
+
+void SourceSampler::parseStateInformationToRestore()
+{
+    // Runs in stateRestoreThread. Parse until the data of the latest restore request has been parsed
+    while (!stateRestoreThread.threadShouldExit()){
+        juce::MemoryBlock data;
+        int requestId;
+        {
+            const juce::ScopedLock sl (stateSnapshotLock);
+            if (stateDataToRestore.getSize() == 0 || parsedStateToRestoreRequestId == stateToRestoreRequestId){
+                return;
+            }
+            data = stateDataToRestore;
+            requestId = stateToRestoreRequestId;
+        }
+        
+        // States are saved as XML. Some development versions of the plugin saved binary ValueTree snapshots instead, these
+        // are still accepted
+        juce::ValueTree newState;
+        std::unique_ptr<juce::XmlElement> xmlState (juce::AudioProcessor::getXmlFromBinary(data.getData(), (int)data.getSize()));
+        if (xmlState.get() != nullptr){
+            newState = juce::ValueTree::fromXml(*xmlState.get());
+        } else {
+            newState = juce::ValueTree::readFromData(data.getData(), data.getSize());
+        }
+        
+        const juce::ScopedLock sl (stateSnapshotLock);
+        if (requestId == stateToRestoreRequestId){
+            parsedStateToRestoreRequestId = requestId;
+            if (newState.hasType(SourceIDs::SOURCE_STATE)){
+                parsedStateToRestore = newState;
+                stateRestoreProgress = 0.1f;
+            } else {
+                DBG("Could not parse state information passed by the host");
+                stateDataToRestore.reset();
+                stateRestoreProgress = 1.0f;
+            }
+        }
+    }
+}
+
+void SourceSampler::applyRestoredStateIfReady()
+{
+    // Called from the timer. Apply the parsed state to restore (if any) and report the progress of loading its sounds
+    juce::ValueTree newState;
+    {
+        const juce::ScopedLock sl (stateSnapshotLock);
+        if (stateDataToRestore.getSize() > 0 && !parsedStateToRestore.isValid() && !stateRestoreThread.isThreadRunning()){
+            // A restore was requested while the thread was finishing the previous one, start it again
+            stateRestoreThread.startThread();
+        }
+        if (parsedStateToRestore.isValid()){
+            newState = parsedStateToRestore;
+            parsedStateToRestore = juce::ValueTree();
+        }
+    }
+    
+    if (newState.isValid()){
+        DBG("Restoring state information passed by the host");
+        stateRestoreProgress = 0.2f;
+        loadPresetFromStateInformation(newState);
+        isLoadingSoundsOfRestoredState = true;
+        {
+            // Only clear the data once the state has been applied so getStateSnapshot does not return the old state meanwhile
+            const juce::ScopedLock sl (stateSnapshotLock);
+            if (parsedStateToRestoreRequestId == stateToRestoreRequestId){
+                stateDataToRestore.reset();
+            }
+        }
+        updateStateSnapshotIfNeeded(true);
+    }
+    
+    if (isLoadingSoundsOfRestoredState && sounds != nullptr){
+        // Sounds are loaded in their own threads, the remaining progress is the fraction of sounds already loaded
+        int numLoadedSounds = 0;
+        for (auto* sound: sounds->objects){
+            if (sound->hasFinishedLoading()){
+                numLoadedSounds += 1;
+            }
+        }
+        int numSounds = sounds->objects.size();
+        if (numLoadedSounds == numSounds){
+            stateRestoreProgress = 1.0f;
+            isLoadingSoundsOfRestoredState = false;
+        } else {
+            stateRestoreProgress = 0.2f + 0.8f * (float)numLoadedSounds / (float)numSounds;
+        }
+    }
+}
+
 juce::String SourceSampler::collectVolatileStateInformationAsString(){
     
     juce::StringArray stateAsStringParts = {};
@@ -618,11 +1032,12 @@ juce::String SourceSampler::collectVolatileStateInformationAsString(){
     stateAsStringParts.add(voiceSoundPlayPositions);
     
     juce::String audioLevels = "";
-    for (int i=0; i<getTotalNumOutputChannels(); i++){
+    for (int i=0; i<getMainOutputNumChannels(); i++){
         audioLevels += (juce::String)lms.getRMSLevel(i) + ",";
     }
     
     stateAsStringParts.add(audioLevels);
+    stateAsStringParts.add((juce::String)sampler.getNumSkippedVoiceBlocks());
     
     return stateAsStringParts.joinIntoString(";");
 }
@@ -709,20 +1124,21 @@ void SourceSampler::actionListenerCallback (const juce::String &message)
         int velocity = parameters[1].getIntValue();
         int channel = parameters[2].getIntValue();
         juce::MidiMessage message = juce::MidiMessage::noteOn(channel > 0 ? channel : (globalMidiInChannel > 0 ? globalMidiInChannel : 1), note, (juce::uint8)velocity);
-        midiFromEditor.addEvent(message, 0);
+        addMidiMessageFromEditor(message);
     }
     else if (actionName == ACTION_NOTE_OFF){
         int note = parameters[0].getIntValue();
         int velocity = parameters[1].getIntValue();
         int channel = parameters[2].getIntValue();
         juce::MidiMessage message = juce::MidiMessage::noteOff(channel > 0 ? channel : (globalMidiInChannel > 0 ? globalMidiInChannel : 1), note, (juce::uint8)velocity);
-        midiFromEditor.addEvent(message, 0);
+        addMidiMessageFromEditor(message);
     }
     
     // Preset actions -----------------------------------------------------------------------------------
     else if (actionName == ACTION_LOAD_PRESET){
         int index = parameters[0].getIntValue();
-        loadPresetFromIndex(index);
+        bool fromProgramChange = (parameters.size() > 1) && (parameters[1].getIntValue() == 1);
+        loadPresetFromIndex(index, fromProgramChange);
     }
     else if (actionName == ACTION_SAVE_PRESET){
         juce::String presetName = parameters[0];
@@ -1036,6 +1452,31 @@ void SourceSampler::setMidiThru(bool doMidiTrhu)
 
 //==============================================================================
 
+void SourceSampler::reportQueryLatencyIfReady()
+{
+    // The latency of a query is the time from the start of makeQueryAndLoadSounds until the first of the sounds it creates
+    // can be played (a SourceSamplerSound, possibly a provisional one, is added to the sampler). Sounds which became playable
+    // after the query started are assumed to come from the query. The result is logged and reported in the volatile state
+    double queryStartTimeMs = lastQueryStartTimeMs.load();
+    if (queryStartTimeMs <= 0.0 || isQuerying || sounds == nullptr){
+        return;
+    }
+    double firstPlayableTimeMs = 0.0;
+    for (auto* sound: sounds->objects){
+        double soundPlayableTimeMs = sound->getFirstPlayableTimeMs();
+        if (soundPlayableTimeMs >= queryStartTimeMs && (firstPlayableTimeMs == 0.0 || soundPlayableTimeMs < firstPlayableTimeMs)){
+            firstPlayableTimeMs = soundPlayableTimeMs;
+        }
+    }
+    if (firstPlayableTimeMs > 0.0){
+        lastQueryToFirstSoundPlayableMs = firstPlayableTimeMs - queryStartTimeMs;
+        lastQueryStartTimeMs = 0.0;
+        std::cout << "Query to first sound playable: " << lastQueryToFirstSoundPlayableMs << " ms" << std::endl;
+    } else if (juce::Time::getMillisecondCounterHiRes() - queryStartTimeMs > QUERY_LATENCY_MEASUREMENT_TIMEOUT_MS){
+        lastQueryStartTimeMs = 0.0;  // Sounds of the query could not be loaded
+    }
+}
+
 void SourceSampler::makeQueryAndLoadSounds(const juce::String& addReplaceOrReplaceSound, const juce::String& textQuery, int numSounds, float minSoundLength, float maxSoundLength)
 {
     /* This function makes a query to Freesound and loads the results in the sammpler. This is only used when running SOURCE as a plugin in Desktop environment (not deployed in ELK
@@ -1060,6 +1501,7 @@ void SourceSampler::makeQueryAndLoadSounds(const juce::String& addReplaceOrRepla
     
     FreesoundClient client(FREESOUND_API_KEY);
     isQuerying = true;
+    lastQueryStartTimeMs = juce::Time::getMillisecondCounterHiRes();
     state.setProperty(SourceIDs::numResultsLastQuery, -1, nullptr);
     juce::String query = "";
     juce::String filter = "";
@@ -1076,18 +1518,47 @@ void SourceSampler::makeQueryAndLoadSounds(const juce::String& addReplaceOrRepla
         query = textQuery;
         pageSize = 100;
     }
-    SoundList list = client.textSearch(query, filter, "score", 0, -1, pageSize, "id,name,username,license,type,filesize,previews,analysis", "rhythm.onset_times", 0);
-    int numResults = list.getCount();
+    juce::String candidatePoolKey = query + "|" + filter;
+    juce::Array<FSSound> soundsFound;
+    int numResults = 0;
+    bool hasNewCandidates = false;
+    juce::Array<FSSound> remainingResults;
+    std::future<SoundList> nextPage;
+    if (pageSize > 1 && candidatePool.takeCandidates(candidatePoolKey, numSounds, soundsFound, numResults)){
+        // Results which were not loaded in a previous query with the same parameters are still available, use them instead
+        // of querying again (the previews of some of them will already be downloaded)
+        DBG("Using " + (juce::String)soundsFound.size() + " sounds from the results of the last query");
+    } else {
+        juce::String fields = "id,name,username,license,type,filesize,previews,analysis";
+        juce::String descriptors = "rhythm.onset_times";
+        SoundList list = client.textSearch(query, filter, "score", 0, -1, pageSize, fields, descriptors, 0);
+        numResults = list.getCount();
+        if (numResults > 0){
+            // Randmomize results and prepare for iteration
+            soundsFound = list.toArrayOfSounds();
+            DBG("Query got " + (juce::String)list.getCount() + " results, " + (juce::String)soundsFound.size() + " in the first page. Will load " + (juce::String)numSounds + " sounds.");
+            
+            // Request the next page of results in the background while sounds are loaded. It will be used by the candidate pool
+            // if later actions with the same query need more sounds than the remaining results of this page
+            if (list.getNextPage().isNotEmpty()){
+                nextPage = client.fetchNextPageAsync(list);
+            }
+            unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+            std::shuffle(soundsFound.begin(), soundsFound.end(), std::default_random_engine(seed));
+            
+            // Keep the results that won't be loaded as candidates for later actions with the same query (these are passed to
+            // the candidate pool once the sounds have been created, see below)
+            for (int i=numSounds; i<soundsFound.size(); i++){
+                remainingResults.add(soundsFound.getReference(i));
+            }
+            hasNewCandidates = true;
+            soundsFound.resize(juce::jmin(numSounds, soundsFound.size()));
+        }
+    }
     state.setProperty(SourceIDs::numResultsLastQuery, numResults, nullptr);
     isQuerying = false;
-    if (numResults > 0){
+    if (soundsFound.size() > 0){
         
-        // Randmomize results and prepare for iteration
-        juce::Array<FSSound> soundsFound = list.toArrayOfSounds();
-        DBG("Query got " + (juce::String)list.getCount() + " results, " + (juce::String)soundsFound.size() + " in the first page. Will load " + (juce::String)numSounds + " sounds.");
-        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-        std::shuffle(soundsFound.begin(), soundsFound.end(), std::default_random_engine(seed));
-        soundsFound.resize(juce::jmin(numSounds, list.getCount()));
         int nSounds = soundsFound.size();
         
         // Move this elsewhere in a helper function (?)
@@ -1146,6 +1617,15 @@ void SourceSampler::makeQueryAndLoadSounds(const juce::String& addReplaceOrRepla
         }
     } else {
         DBG("Query got no results...");
+        lastQueryStartTimeMs = 0.0;  // Nothing to measure
+    }
+    
+    if (hasNewCandidates){
+        // Candidates are set after creating the sounds so their loader threads are already queueing their downloads. The previews
+        // of the candidates will only be prefetched once all loader threads have finished (see timerCallback), and only if previews
+        // (and not original files) will be used when loading them
+        bool usesPreviews = freesoundOauthAccessToken.get() == "" || useOriginalFilesPreference.get() == USE_ORIGINAL_FILES_NEVER;
+        candidatePool.setCandidates(candidatePoolKey, numResults, remainingResults, usesPreviews ? soundsDownloadLocation : juce::File(), std::move(nextPage));
     }
 }
 
@@ -1173,14 +1653,38 @@ void SourceSampler::removeSamplerSound(const juce::String& soundUUID, const juce
 }
 
 
-void SourceSampler::removeAllSounds()
+void SourceSampler::removeAllSounds(bool allowTailOff)
 {
     // Trigger the deletion of the sounds by disabling them
-    // Once disabled, all playing notes will be stopped and the sounds removed a while after that
+    // Once disabled, all playing notes will be stopped (or released if allowTailOff) and the sounds removed a while after that
     const juce::ScopedLock sl (soundDeleteLock);
     for (auto* sound: sounds->objects){
-        sound->scheduleSoundDeletion();
+        sound->scheduleSoundDeletion(allowTailOff);
+    }
+}
+
+bool SourceSampler::isSourceSamplerSoundBeingPlayed(SourceSamplerSound* sourceSamplerSound)
+{
+    const juce::ScopedLock sl (sampler.getLock());
+    for (int i=0; i<sampler.getNumVoices(); i++){
+        auto* voice = static_cast<SourceSamplerVoice*>(sampler.getVoice(i));
+        if (voice->isVoiceActive() && voice->getCurrentlyPlayingSourceSamplerSound() == sourceSamplerSound){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SourceSampler::isSourceSoundBeingPlayed(SourceSound* sourceSound)
+{
+    const juce::ScopedLock sl (sampler.getLock());
+    for (int i=0; i<sampler.getNumVoices(); i++){
+        auto* voice = static_cast<SourceSamplerVoice*>(sampler.getVoice(i));
+        if (voice->isVoiceActive() && (voice->getCurrentlyPlayingSourceSamplerSound() != nullptr) && (voice->getCurrentlyPlayingSourceSamplerSound()->getSourceSound() == sourceSound)){
+            return true;
+        }
     }
+    return false;
 }
 
 void SourceSampler::addOrReplaceSoundFromBasicSoundProperties(const juce::String& soundUUID,
@@ -1210,7 +1714,7 @@ void SourceSampler::addOrReplaceSoundFromBasicSoundProperties(const juce::String
             midiNotes = sound->getMappedMidiNotes();
             midiRootNote = sound->getMidiNoteFromFirstSourceSamplerSound();
             if (midiChannel == -1){ // If replacing a sound, keep the assigned midi channel
-                midiChannel = sound->getParameterInt(SourceIDs::midiChannel);
+                midiChannel = (int)sound->getParameter(ParamId::midiChannel);
             }
         }
         
@@ -1284,7 +1788,7 @@ void SourceSampler::reapplyNoteLayout(int newNoteLayoutType)
                     midiNotes.setRange(i * nNotesPerSound, nNotesPerSound, true);
                     sound->setMappedMidiNotes(midiNotes);
                     sound->setMidiRootNote(rootNote);
-                    sound->setParameterByNameInt(SourceIDs::midiChannel, SourceDefaults::midiChannel);
+                    sound->setParameter(ParamId::midiChannel, (float)SourceDefaults::midiChannel);
                 } else if (noteLayoutType == NOTE_MAPPING_TYPE_INTERLEAVED){
                     int rootNote = NOTE_MAPPING_INTERLEAVED_ROOT_NOTE + i;
                     juce::BigInteger midiNotes;
@@ -1296,13 +1800,13 @@ void SourceSampler::reapplyNoteLayout(int newNoteLayoutType)
                     }
                     sound->setMappedMidiNotes(midiNotes);
                     sound->setMidiRootNote(rootNote);
-                    sound->setParameterByNameInt(SourceIDs::midiChannel, SourceDefaults::midiChannel);
+                    sound->setParameter(ParamId::midiChannel, (float)SourceDefaults::midiChannel);
                 } else if (noteLayoutType == NOTE_MAPPING_TYPE_ALL) {
                     juce::BigInteger midiNotes;
                     midiNotes.setRange(0, 127, true);
                     sound->setMappedMidiNotes(midiNotes);
                     sound->setMidiRootNote(64);
-                    sound->setParameterByNameInt(SourceIDs::midiChannel, (i % 16) + 1); // In All mode, sounds have "consecutive" midi channels because all notes of the channel are assigned to them
+                    sound->setParameter(ParamId::midiChannel, (float)((i % 16) + 1)); // In All mode, sounds have "consecutive" midi channels because all notes of the channel are assigned to them
                 }
             }
         }
@@ -1323,7 +1827,7 @@ void SourceSampler::addToMidiBuffer(const juce::String& soundUUID, bool doNoteOf
         if (midiNoteForNormalPitch < 0){
             // If for some reason no note was found, don't play anything
         } else {
-            int midiChannel = sound->getParameterInt(SourceIDs::midiChannel);
+            int midiChannel = (int)sound->getParameter(ParamId::midiChannel);
             if (midiChannel == 0){
                 if (globalMidiInChannel > 0){
                     midiChannel = globalMidiInChannel;
@@ -1335,11 +1839,22 @@ void SourceSampler::addToMidiBuffer(const juce::String& soundUUID, bool doNoteOf
             if (doNoteOff){
                 message = juce::MidiMessage::noteOff(midiChannel, midiNoteForNormalPitch, (juce::uint8)127);
             }
-            midiFromEditor.addEvent(message, 0);
+            addMidiMessageFromEditor(message);
         }
     }
 }
 
+void SourceSampler::addMidiMessageFromEditor(juce::MidiMessage message)
+{
+    // Store the time at which the message was received so it can be converted to a sample offset in processBlock. If
+    // too many messages are pending (e.g. audio is not being processed), the message is dropped
+    double receivedTimeMs = juce::Time::getMillisecondCounterHiRes();
+    const juce::SpinLock::ScopedLockType lock (midiFromEditorLock);
+    if (numMidiFromEditor < (int)midiFromEditor.size()){
+        midiFromEditor[numMidiFromEditor++] = { message, receivedTimeMs };
+    }
+}
+
 double SourceSampler::getStartTime(){
     return startTime;
 }
@@ -1353,7 +1868,7 @@ void SourceSampler::timerCallback()
     if (sounds != nullptr){
         for (int i=sounds->objects.size() - 1; i>=0 ; i--){
             auto* sound = sounds->objects[i];
-            if (sound->shouldBeDeleted()){
+            if (sound->shouldBeDeleted() && !isSourceSoundBeingPlayed(sound)){
                 sounds->removeSoundWithUUID(sound->getUUID());
             }
         }
@@ -1361,16 +1876,59 @@ void SourceSampler::timerCallback()
     if (soundsOld != nullptr){
         for (int i=soundsOld->objects.size() - 1; i>=0 ; i--){
             auto* sound = soundsOld->objects[i];
-            if (sound->shouldBeDeleted()){
+            if (sound->shouldBeDeleted() && !isSourceSoundBeingPlayed(sound)){
                 soundsOld->removeSoundWithUUID(sound->getUUID());
             }
         }
     }
     
-    // Also, delete SourceSampleSounds that are schedule for deletion (and have not been deleted yet)
+    // Start prefetching the previews of the candidates of the last query once the loaded sounds have queued their downloads
+    if ((sounds != nullptr) && candidatePool.isWaitingToStartPrefetching() && sounds->allSoundsQueuedTheirDownloads()){
+        candidatePool.startPrefetching();
+    }
+    
+    // Keep the previews prefetched for this and previous queries within their disk budget. Previews of sounds in the preset
+    // are not deleted (these might have been loaded from a query which returned them again)
+    candidatePool.evictPrefetchedPreviews([this](const juce::String& soundId){
+        for (auto sound: state.getChildWithName(SourceIDs::PRESET)){
+            for (auto sample: sound){
+                if (sample.hasType(SourceIDs::SOUND_SAMPLE) && sample.getProperty(SourceIDs::soundId).toString() == soundId){
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+    
+    // Discard the staged preset if its audio does not fit in the memory budget
+    if ((stagedSounds != nullptr) && (stagedSounds->getMemorySizeBytes() > (size_t)PRESET_STAGING_MAX_MEMORY_MB * 1024 * 1024)){
+        DBG("Discarding staged preset " << stagedPresetIndex << " as it exceeds the memory budget");
+        discardStagedPreset();
+    }
+    
+    // Measure how long the last query took to make its first sound playable
+    reportQueryLatencyIfReady();
+    
+    // Apply state passed by the host (if any) and keep the snapshot of the state returned to the host up to date
+    applyRestoredStateIfReady();
+    updateStateSnapshotIfNeeded(false);
+    
+    // Write the preset catalogue if any entry changed
+    presetCatalogue.saveIfNeeded();
+    
+    // Write parameter values modulated by MIDI CC back to the state
+    if (sounds != nullptr){
+        for (auto* sound: sounds->objects){
+            sound->writeBackParameterChanges();
+        }
+    }
+    
+    // Also, delete SourceSampleSounds that are schedule for deletion (and have not been deleted yet). Sounds which are still
+    // being played by some voice (e.g. provisional sounds released with tail off) are deleted once the voice stops, so the last
+    // reference to the sound is not released from the audio thread
     for (int i=sampler.getNumSounds() - 1; i>=0; i--){
         auto* sourceSamplerSound = static_cast<SourceSamplerSound*>(sampler.getSound(i).get());
-        if (sourceSamplerSound->shouldBeDeleted()){
+        if (sourceSamplerSound->shouldBeDeleted() && !isSourceSamplerSoundBeingPlayed(sourceSamplerSound)){
             sourceSamplerSound->getSourceSound()->removeSourceSamplerSound(sourceSamplerSound->getUUID(), i);
         }
     }
@@ -1496,6 +2054,7 @@ void SourceSampler::valueTreePropertyChanged (juce::ValueTree& treeWhoseProperty
     // We should never call this function from the realtime thread because editing VT might not be RT safe...
     // TODO: proper check that this is not audio thread
     //jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+    stateVersion += 1;
     DBG("Changed " << treeWhosePropertyHasChanged[SourceIDs::name].toString() << " " << property.toString() << ": " << treeWhosePropertyHasChanged[property].toString());
     juce::OSCMessage message = juce::OSCMessage("/state_update");
     message.addString("propertyChanged");
@@ -1516,6 +2075,7 @@ void SourceSampler::valueTreeChildAdded (juce::ValueTree& parentTree, juce::Valu
     // We should never call this function from the realtime thread because editing VT might not be RT safe...
     // TODO: proper check that this is not audio thread
     //jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+    stateVersion += 1;
     DBG("Added VT child " << childWhichHasBeenAdded.getType());
     juce::OSCMessage message = juce::OSCMessage("/state_update");
     message.addString("addedChild");
@@ -1537,6 +2097,7 @@ void SourceSampler::valueTreeChildRemoved (juce::ValueTree& parentTree, juce::Va
     // We should never call this function from the realtime thread because editing VT might not be RT safe...
     // TODO: proper check that this is not audio thread
     //jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+    stateVersion += 1;
     DBG("Removed VT child " << childWhichHasBeenRemoved.getType());
     juce::OSCMessage message = juce::OSCMessage("/state_update");
     message.addString("removedChild");
@@ -1554,6 +2115,7 @@ void SourceSampler::valueTreeChildOrderChanged (juce::ValueTree& parentTree, int
 {
     // We should never call this function from the realtime thread because editing VT might not be RT safe...
     // jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+    stateVersion += 1;
 }
 
 void SourceSampler::valueTreeParentChanged (juce::ValueTree& treeWhoseParentHasChanged)
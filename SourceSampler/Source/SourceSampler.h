@@ -17,6 +17,9 @@
 #include "SourceSamplerSynthesiser.h"
 #include "SourceSamplerSound.h"
 #include "LevelMeterSource.h"
+#include "PresetCatalogue.h"
+#include "PresetFile.h"
+#include "FreesoundCandidatePool.h"
 
 
 //==============================================================================
@@ -34,6 +37,7 @@ public:
     
     juce::ValueTree state;
     void bindState();
+    void bindPresetProperties(juce::ValueTree preset);
     GlobalContextStruct getGlobalContext();
     
     void createDirectories(const juce::String& appDirectoryName);
@@ -46,6 +50,8 @@ public:
     int getBlockSize();
     int getTotalNumOutputChannels();
     void setTotalNumOutputChannels(int numChannels);
+    void setOutputBusesLayout(const OutputBusesLayout& layout);
+    int getMainOutputNumChannels();
 
     //==============================================================================
     juce::String getPresetFilenameByIndex(int index);
@@ -55,9 +61,16 @@ public:
     int latestLoadedPreset = 0; // Only used in ELK builds to re-load the last preset that was loaded (in previous runs included)
 
     void loadPresetFromStateInformation (juce::ValueTree state);
+    void loadPresetIncrementally (juce::ValueTree state);
     void saveCurrentPresetToFile(const juce::String& presetName, int index);
+    juce::ValueTree loadPresetStateFromFile (const juce::String& fileName);
     bool loadPresetFromFile (const juce::String& fileName);
-    void loadPresetFromIndex(int index);
+    void loadPresetFromIndex(int index, bool fromProgramChange=false);
+    
+    void stagePreset(int index);
+    void discardStagedPreset();
+    bool isStagedPresetReady(int index);
+    void swapToStagedPreset();
     
     void saveGlobalPersistentStateToFile();
     void loadGlobalPersistentStateFromFile();
@@ -65,6 +78,9 @@ public:
     juce::ValueTree collectVolatileStateInformation ();
     juce::String collectVolatileStateInformationAsString ();
     
+    void getStateSnapshot (juce::MemoryBlock& destData);
+    void restoreStateInformationAsync (const void* data, int sizeInBytes);
+    
     //==============================================================================
     void actionListenerCallback (const juce::String &message) override;
     
@@ -75,6 +91,8 @@ public:
     juce::File tmpFilesLocation;
     
     juce::File getPresetFilePath(const juce::String& presetFilename);
+    juce::File getLegacyPresetFilePath(const juce::String& presetFilename);
+    juce::File findPresetFile(const juce::String& presetFilename);
     juce::String getPresetFilenameFromNameAndIndex(const juce::String& presetName, int index);
     juce::File getGlobalSettingsFilePathFromName();
     
@@ -112,10 +130,26 @@ public:
     };
     QueryMakerThread queryMakerThread;
     //==============================================================================
+    class StateRestoreThread : public juce::Thread
+    {
+    public:
+        StateRestoreThread(SourceSampler& s) : juce::Thread ("StateRestoreThread"), sampler (s){}
+        
+        void run() override
+        {
+            sampler.parseStateInformationToRestore();
+        }
+        SourceSampler& sampler;
+    };
+    StateRestoreThread stateRestoreThread;
+    void parseStateInformationToRestore();
+    //==============================================================================
     void makeQueryAndLoadSounds(const juce::String& addReplaceOrReplaceSound, const juce::String& query, int numSounds, float minSoundLength, float maxSoundLength);
     void removeSound(const juce::String& soundUUID);
     void removeSamplerSound(const juce::String& soundUUID, const juce::String& samplerSoundUUID);
-    void removeAllSounds();
+    void removeAllSounds(bool allowTailOff=false);
+    bool isSourceSamplerSoundBeingPlayed(SourceSamplerSound* sourceSamplerSound);
+    bool isSourceSoundBeingPlayed(SourceSound* sourceSound);
     void addOrReplaceSoundFromBasicSoundProperties(const juce::String& soundUUID,
                                                    int soundID,
                                                    const juce::String& soundName,
@@ -140,6 +174,7 @@ public:
                                                    bool addToExistingSourceSampleSounds);
     void reapplyNoteLayout(int newNoteLayoutType);
     void addToMidiBuffer(const juce::String& soundUUID, bool doNoteOff);
+    void addMidiMessageFromEditor(juce::MidiMessage message);
     double getStartTime();
     
     void timerCallback() override;
@@ -172,6 +207,10 @@ private:
     
     std::unique_ptr<SourceSoundList> sounds;
     std::unique_ptr<SourceSoundList> soundsOld;  // Used when sounds is replaced to not immediately delete all objects inside and give time for save deletion
+    std::unique_ptr<SourceSoundList> stagedSounds;  // Sounds of the staged preset (see stagePreset)
+    juce::ValueTree stagedPresetState;
+    int stagedPresetIndex = -1;
+    PresetCatalogue presetCatalogue;  // Names and summaries of the presets in presetFilesLocation
     juce::CachedValue<juce::String> presetName;
     juce::CachedValue<int> numVoices;
     juce::CachedValue<int> noteLayoutType;
@@ -184,7 +223,22 @@ private:
     
     // Other "volatile" properties
     bool isQuerying = false;
-    juce::MidiBuffer midiFromEditor;
+    std::atomic<double> lastQueryStartTimeMs { 0.0 };  // Set when a query starts, reset once the latency of the query is reported (see reportQueryLatencyIfReady)
+    double lastQueryToFirstSoundPlayableMs = -1.0;
+    void reportQueryLatencyIfReady();
+    juce::SharedResourcePointer<FreesoundAsyncRequestsPool> freesoundAsyncRequestsPool;  // Keeps the pool of asynchronous Freesound requests alive while the plugin exists
+    FreesoundCandidatePool candidatePool;  // Results of the last query which were not loaded (see makeQueryAndLoadSounds)
+    // MIDI messages from the editor/UI together with the time at which they were received (juce::MidiBuffer only stores
+    // sample positions, so the times are kept here until processBlock converts them to sample offsets)
+    struct MidiMessageFromEditor
+    {
+        juce::MidiMessage message;
+        double receivedTimeMs = 0.0;
+    };
+    std::array<MidiMessageFromEditor, MIDI_FROM_EDITOR_MAX_PENDING_MESSAGES> midiFromEditor;
+    int numMidiFromEditor = 0;
+    juce::SpinLock midiFromEditorLock;
+    double lastBlockStartTimeMs = 0.0;  // Used to convert the received times of messages in midiFromEditor to sample offsets
     int lastReceivedMIDIControllerNumber = -1;
     int lastReceivedMIDINoteNumber = -1;
     bool midiMessagesPresentInLastStateReport = false;
@@ -203,12 +257,28 @@ private:
     std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
     juce::AudioTransportSource transportSource;
     
+    // Host state snapshots and restore (see getStateSnapshot and restoreStateInformationAsync)
+    void updateStateSnapshotIfNeeded (bool force);
+    void applyRestoredStateIfReady();
+    std::atomic<juce::uint32> stateVersion { 1 };  // Incremented every time the state changes
+    juce::uint32 stateSnapshotVersion = 0;  // Version of the state in stateSnapshot
+    double lastStateSnapshotTimeMs = 0.0;
+    juce::MemoryBlock stateSnapshot;
+    juce::CriticalSection stateSnapshotLock;  // Protects stateSnapshot and the state to restore below
+    juce::MemoryBlock stateDataToRestore;  // Data passed by the host, kept until it has been applied to the state
+    int stateToRestoreRequestId = 0;
+    juce::ValueTree parsedStateToRestore;  // Parsed from stateDataToRestore, waiting to be applied in the message thread
+    int parsedStateToRestoreRequestId = 0;
+    std::atomic<float> stateRestoreProgress { 1.0f };  // 1.0 when no restore is in progress
+    bool isLoadingSoundsOfRestoredState = false;
+    
     // Other
     juce::CriticalSection soundDeleteLock;
     bool loadedPresetAtElkStartup = false;
     double sampleRate = 44100.0;
     int blockSize = 512;
     int numberOfChannels = 2;
+    OutputBusChannels mainOutputBus = { 0, 2 };
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SourceSampler)
@@ -10,6 +10,7 @@
 
 #include "SourceSamplerSound.h"
 #include "SourceSamplerVoice.h"
+#include "PresetFile.h"
 
 
 SourceSamplerSound::SourceSamplerSound (const juce::ValueTree& _state,
@@ -17,11 +18,13 @@ SourceSamplerSound::SourceSamplerSound (const juce::ValueTree& _state,
                                         juce::AudioFormatReader& source,
                                         double maxSampleLengthSeconds,
                                         double _pluginSampleRate,
-                                        int _pluginBlockSize)
+                                        int _pluginBlockSize,
+                                        bool _isProvisional)
     : state(_state),
       soundSampleRate (source.sampleRate),
       pluginSampleRate (_pluginSampleRate),
       pluginBlockSize (_pluginBlockSize),
+      provisional (_isProvisional),
       stretchProcessorThread (*this)
 {
     sourceSoundPointer = _sourceSoundPointer;
@@ -33,22 +36,36 @@ SourceSamplerSound::SourceSamplerSound (const juce::ValueTree& _state,
         data.reset (new juce::AudioBuffer<float> (juce::jmin (2, (int) source.numChannels), lengthInSamples + 4));
         source.read (data.get(), 0, lengthInSamples + 4, 0, true, true);
         
-        // Add duration to state
-        state.setProperty(SourceIDs::duration, getLengthInSeconds(), nullptr);
+        // Add duration to state (provisional sounds only have part of the audio so would report a wrong duration)
+        if (!provisional){
+            state.setProperty(SourceIDs::duration, getLengthInSeconds(), nullptr);
+        }
     }
     
     // Pre-allocate space for stretched audio buffer
     stretchProcessedData.reset (new juce::AudioBuffer<float> (data->getNumChannels(), data->getNumSamples() * maxTimeStretchRatio));
     
-    // Load calculated onsets (if any)
+    // Load calculated onsets (if any) and compute the initial slices table
     loadOnsetTimesSamplesFromAnalysis();
+    updateSliceTableIfNeeded();
     
     // Write PCM version of the audio to disk so it can be used in the UI for displaying waveforms
     // (either by serving through the http server or directly loading from disk)
-    writeBufferToDisk();
+    if (!provisional){
+        writeBufferToDisk();
+    }
     
-    // Schecule pre-processing of audio data with stretch (so time stretching/pitch shifting is not computed in real time)
-    setStretchParameters(getParameterFloat(SourceIDs::pitchShift), getParameterFloat(SourceIDs::timeStretch));
+    if (!provisional){
+        // Schecule pre-processing of audio data with stretch (so time stretching/pitch shifting is not computed in real time)
+        setStretchParameters(getParameterFloat(ParamId::pitchShift), getParameterFloat(ParamId::timeStretch));
+    } else {
+        // Provisional sounds only live until the download finishes, so these are not pre-processed with stretch and the
+        // decoded audio is played as is
+        shouldProcessWithStretchAtTime = -1;
+        stretchProcessedData->makeCopyOf(*data, true);
+        lengthInSamples = stretchProcessedData->getNumSamples();
+        computeZeroCrossings();
+    }
     
     // Start timer that will periodically check if "async" tasks need to be done like re-processing with stretch
     startTimer(SAMPLER_SOUND_TIMER_MS);
@@ -90,6 +107,13 @@ void SourceSamplerSound::timerCallback()
             stretchProcessorThread.startThread(); // Runs preProcessAudioWithStretch() in thread
         }
     }
+    
+    // Re-compute the slices table if any relevant parameter changed, and delete old tables which are no longer used
+    updateSliceTableIfNeeded();
+    double now = juce::Time::getMillisecondCounterHiRes();
+    retiredSliceTables.erase(std::remove_if(retiredSliceTables.begin(), retiredSliceTables.end(),
+                                            [now](const std::unique_ptr<SliceTable>& table){ return (now - table->retiredAtTime) > SAFE_SOUND_DELETION_TIME_MS; }),
+                             retiredSliceTables.end());
 }
 
 void SourceSamplerSound::writeBufferToDisk()
@@ -144,11 +168,17 @@ void SourceSamplerSound::preProcessAudioWithStretch()
     // Update stored property of length in samples which is used at playback time by sound voice
     lengthInSamples = stretchProcessedData->getNumSamples();
     
+    // Update the zero crossings index for the new audio (slices table will be re-computed in the next timer callback)
+    computeZeroCrossings();
+    
     lastTimeProcessedWithStretchAtTime = juce::Time::getMillisecondCounterHiRes();
     computingTimeStretch = false;
 }
 
 void SourceSamplerSound::setStretchParameters(float newPitchShiftSemitones, float newTimeStretchRatio) {
+    if (provisional){
+        return;  // See constructor
+    }
     nextTimeStretchRatio = (float)juce::jmax(0.1, juce::jmin((double)newTimeStretchRatio, (double)maxTimeStretchRatio));
     nextPitchShiftSemitones = newPitchShiftSemitones;
     shouldProcessWithStretchAtTime = juce::Time::getMillisecondCounterHiRes() + STRETCH_PROCESSING_TIME_DEBOUNCE_MS;
@@ -156,8 +186,8 @@ void SourceSamplerSound::setStretchParameters(float newPitchShiftSemitones, floa
 
 bool SourceSamplerSound::appliesToNote (int midiNoteNumber)
 {
-    // If sound is disabled, return false so new notes are not triggered
-    return !sourceSoundPointer->isScheduledForDeletion() && getMappedMidiNotes()[midiNoteNumber];
+    // If sound is disabled (or is about to be deleted), return false so new notes are not triggered
+    return !willBeDeleted && !sourceSoundPointer->isScheduledForDeletion() && midiNotes[midiNoteNumber];
 }
 
 bool SourceSamplerSound::appliesToVelocity (int midiVelocity)
@@ -168,18 +198,18 @@ bool SourceSamplerSound::appliesToVelocity (int midiVelocity)
 int SourceSamplerSound::getCorrectedVelocity(int midiVelocity)
 {
     // Modified velocity value according to velSensitivity parameter (midiVelocity 0-127)
-    return (int)std::round(127.0 * juce::jlimit(0.0, 1.0, std::pow((double)midiVelocity/127.0, getParameterFloat(SourceIDs::velSensitivity))));
+    return (int)std::round(127.0 * juce::jlimit(0.0, 1.0, std::pow((double)midiVelocity/127.0, getParameterFloat(ParamId::velSensitivity))));
 }
 
 float SourceSamplerSound::getCorrectedVelocity(float midiVelocity)
 {
     // Modified velocity value according to velSensitivity parameter (midiVelocity 0.0-1.0)
-    return (float)juce::jlimit(0.0, 1.0, std::pow((double)midiVelocity, getParameterFloat(SourceIDs::velSensitivity)));
+    return (float)juce::jlimit(0.0, 1.0, std::pow((double)midiVelocity, getParameterFloat(ParamId::velSensitivity)));
 }
 
 bool SourceSamplerSound::appliesToChannel (int midiChannel)
 {
-    int soundMidiChannel = getParameterInt(SourceIDs::midiChannel);
+    int soundMidiChannel = getParameterInt(ParamId::midiChannel);
     if (soundMidiChannel == 0){
         // use global channel
         int globalMidiChannel = sourceSoundPointer->getGlobalContext().midiInChannel;
@@ -190,23 +220,23 @@ bool SourceSamplerSound::appliesToChannel (int midiChannel)
     }
 }
 
-float SourceSamplerSound::getParameterFloat(juce::Identifier identifier){
+float SourceSamplerSound::getParameterFloat(ParamId paramId){
     // Return parameters from the corresponding SourceSound object
     // For some parameters, first check if the SourceSamplerSound object has a special "override"
-    if ((identifier == SourceIDs::startPosition) && (sampleStartPosition >= 0.0)){
+    if ((paramId == ParamId::startPosition) && (sampleStartPosition >= 0.0)){
         return sampleStartPosition;
-    } else if ((identifier == SourceIDs::endPosition) && (sampleEndPosition >= 0.0)){
+    } else if ((paramId == ParamId::endPosition) && (sampleEndPosition >= 0.0)){
         return sampleEndPosition;
-    } else if ((identifier == SourceIDs::loopStartPosition) && (sampleLoopStartPosition >= 0.0)){
+    } else if ((paramId == ParamId::loopStartPosition) && (sampleLoopStartPosition >= 0.0)){
         return sampleLoopStartPosition;
-    } else if ((identifier == SourceIDs::loopEndPosition) && (sampleLoopEndPosition >= 0.0)){
+    } else if ((paramId == ParamId::loopEndPosition) && (sampleLoopEndPosition >= 0.0)){
         return sampleLoopEndPosition;
     }
-    return sourceSoundPointer->getParameterFloat(identifier, false);
+    return sourceSoundPointer->getParameter(paramId);
 }
 
-int SourceSamplerSound::getParameterInt(juce::Identifier identifier){
-    return sourceSoundPointer->getParameterInt(identifier);
+int SourceSamplerSound::getParameterInt(ParamId paramId){
+    return (int)sourceSoundPointer->getParameter(paramId);
 }
 
 void SourceSamplerSound::setSampleStartEndAndLoopPositions(float start, float end, float loopStart, float loopEnd){
@@ -241,13 +271,25 @@ int SourceSamplerSound::getLengthInSamples(){
     return lengthInSamples;
 }
 
+size_t SourceSamplerSound::getMemorySizeBytes(){
+    // Size of the audio buffers (original and stretch processed data)
+    size_t numSamples = 0;
+    if (data != nullptr){
+        numSamples += (size_t)data->getNumChannels() * (size_t)data->getNumSamples();
+    }
+    if (stretchProcessedData != nullptr){
+        numSamples += (size_t)stretchProcessedData->getNumChannels() * (size_t)stretchProcessedData->getNumSamples();
+    }
+    return numSamples * sizeof(float);
+}
+
 float SourceSamplerSound::getLengthInSeconds(){
     return (float)getLengthInSamples()/soundSampleRate;
 }
 
 int SourceSamplerSound::getNumberOfMappedMidiNotes()
 {
-    return getMappedMidiNotes().countNumberOfSetBits();
+    return numberOfMappedMidiNotes;
 }
 
 juce::BigInteger SourceSamplerSound::getMappedMidiNotes()
@@ -258,6 +300,47 @@ juce::BigInteger SourceSamplerSound::getMappedMidiNotes()
 void SourceSamplerSound::setMappedMidiNotes(juce::BigInteger newMappedMidiNotes)
 {
     midiNotes = newMappedMidiNotes;
+    numberOfMappedMidiNotes = midiNotes.countNumberOfSetBits();
+    for (int midiNote=0; midiNote<(int)midiNoteIndexes.size(); midiNote++){
+        midiNoteIndexes[midiNote].store(computeMidiNoteIndex(midiNote), std::memory_order_relaxed);
+    }
+}
+
+int SourceSamplerSound::computeMidiNoteIndex(int midiNote)
+{
+    /* This function compares the MIDI note passed as parameter and the list of midi notes assigned to the
+     sound and returns the "index" of the note passed as parameter. For example, if the first MIDI note
+     assigned to the sound is C3 and the passed note is also C3, this function returns 0. If sound
+     is assigned notes C3, C#3 and D3 and the passed note is C5, this function returns 2. If no notes
+     are assigned to the sound, this function returns 0. If there are note discontinuities in the mapping,
+     the discontinuities are not counted (e.g. if a sound is assigned notes [C3, C#3, E3] and the note being
+     played is E3, this function will return 2. If the note being passed is not one of the assigned notes,
+     returns the closest one.
+     This is only called when mapped notes change to fill midiNoteIndexes (use getMidiNoteIndex instead).
+          */
+    if (numberOfMappedMidiNotes > 0){
+        int noteIndex = 0;
+        int closestNoteIndex = 0;
+        int minDistanceWithNote = 1000;
+        int i = 0;
+        while (true) {
+            int nextMappedNote = midiNotes.findNextSetBit(i);
+            if (nextMappedNote == midiNote){
+                return noteIndex;
+            } else if (nextMappedNote == -1){
+                break;
+            }
+            noteIndex += 1;
+            int distanceWithNote = std::abs(noteIndex - midiNote);
+            if (distanceWithNote <= minDistanceWithNote){
+                closestNoteIndex = noteIndex;
+                minDistanceWithNote = distanceWithNote;
+            }
+            i = nextMappedNote + 1;
+        }
+        return closestNoteIndex;
+    }
+    return 0;
 }
 
 int SourceSamplerSound::getMidiRootNote()
@@ -285,6 +368,7 @@ void SourceSamplerSound::setOnsetTimesSamples(std::vector<float> onsetTimes){
     for (int i=0; i<onsetTimes.size(); i++){
         onsetTimesSamples.push_back((int)(onsetTimes[i] * soundSampleRate));
     }
+    onsetTimesVersion += 1;
 }
 
 std::vector<int> SourceSamplerSound::getOnsetTimesSamples(){
@@ -309,6 +393,121 @@ void SourceSamplerSound::loadOnsetTimesSamplesFromAnalysis(){
 
 // --------------------------------------------------------------------------------------------
 
+SliceTable SourceSamplerSound::getSliceTableParameters()
+{
+    SliceTable parameters;
+    parameters.lengthInSamples = getLengthInSamples();
+    parameters.startPositionSample = (int)(getParameterFloat(ParamId::startPosition) * parameters.lengthInSamples);
+    parameters.endPositionSample = (int)(getParameterFloat(ParamId::endPosition) * parameters.lengthInSamples);
+    parameters.loopStartPositionSample = (int)(getParameterFloat(ParamId::loopStartPosition) * parameters.lengthInSamples);
+    parameters.loopEndPositionSample = (int)(getParameterFloat(ParamId::loopEndPosition) * parameters.lengthInSamples);
+    parameters.numSlices = getParameterInt(ParamId::numSlices);
+    parameters.numMappedMidiNotes = getNumberOfMappedMidiNotes();
+    parameters.onsetTimesVersion = onsetTimesVersion;
+    const juce::ScopedLock sl (zeroCrossingsLock);
+    parameters.zeroCrossingsVersion = zeroCrossingsVersion;
+    return parameters;
+}
+
+void SourceSamplerSound::computeSlices(SliceTable& table)
+{
+    // Compute the start/end positions of each slice. If numSlices is SLICE_MODE_AUTO_ONSETS, slices are defined by the
+    // onsets found inside the start/end region. Otherwise the start/end region is divided in N equal slices, N being
+    // the number of mapped notes (if in SLICE_MODE_AUTO_NNOTES mode) or the number of slices set in the parameter
+    if (table.numSlices != SLICE_MODE_AUTO_ONSETS){
+        int nSlices = table.numSlices == SLICE_MODE_AUTO_NNOTES ? table.numMappedMidiNotes : table.numSlices;
+        if (nSlices > 0){
+            int startToEndSoundLength = table.endPositionSample - table.startPositionSample;
+            float sliceLength = startToEndSoundLength / nSlices;
+            for (int i=0; i<nSlices; i++){
+                table.sliceStartSamples.push_back(table.startPositionSample + (int)(i * sliceLength));
+                table.sliceEndSamples.push_back(table.startPositionSample + (int)((i + 1) * sliceLength));
+            }
+        }
+    } else {
+        // Only consider those onsets inside the global start/end selection. If no onsets are found, the table will be
+        // empty and voices will use the whole start/end region
+        for (int i=0; i<onsetTimesSamples.size(); i++){
+            if ((onsetTimesSamples[i] >= table.startPositionSample) && (onsetTimesSamples[i] <= table.endPositionSample)){
+                if (table.sliceStartSamples.size() > 0){
+                    table.sliceEndSamples.push_back(onsetTimesSamples[i]);
+                }
+                table.sliceStartSamples.push_back(onsetTimesSamples[i]);
+            }
+        }
+        if (table.sliceStartSamples.size() > 0){
+            table.sliceEndSamples.push_back(table.endPositionSample);
+        }
+    }
+    
+    // Move loop positions and slice boundaries to the nearest positive zero crossings to avoid clicks. Start positions
+    // are moved forward and end positions backwards so these never go outside of the selected region
+    const juce::ScopedLock sl (zeroCrossingsLock);
+    table.fixedStartPositionSample = findNearestPositiveZeroCrossing(table.startPositionSample, 2000);
+    table.fixedEndPositionSample = findNearestPositiveZeroCrossing(table.endPositionSample, -2000);
+    table.fixedLoopStartPositionSample = findNearestPositiveZeroCrossing(table.loopStartPositionSample, 2000);
+    table.fixedLoopEndPositionSample = findNearestPositiveZeroCrossing(table.loopEndPositionSample, -2000);
+    for (int i=0; i<table.sliceStartSamples.size(); i++){
+        table.sliceStartSamples[i] = findNearestPositiveZeroCrossing(table.sliceStartSamples[i], 2000);
+        table.sliceEndSamples[i] = findNearestPositiveZeroCrossing(table.sliceEndSamples[i], -2000);
+    }
+}
+
+void SourceSamplerSound::updateSliceTableIfNeeded()
+{
+    // This should be called from the message thread (or before the sound is added to the sampler). Slices are only
+    // re-computed if any of the parameters used to compute the current table has changed
+    SliceTable parameters = getSliceTableParameters();
+    if ((currentSliceTable != nullptr) && currentSliceTable->wasComputedWithSameParametersAs(parameters)){
+        return;
+    }
+    auto newTable = std::make_unique<SliceTable>(parameters);
+    computeSlices(*newTable);
+    sliceTable.store(newTable.get());
+    if (currentSliceTable != nullptr){
+        currentSliceTable->retiredAtTime = juce::Time::getMillisecondCounterHiRes();
+        retiredSliceTables.push_back(std::move(currentSliceTable));
+    }
+    currentSliceTable = std::move(newTable);
+}
+
+void SourceSamplerSound::computeZeroCrossings()
+{
+    // Store the positions of the positive zero crossings in the first channel of the audio that will be played
+    std::vector<int> newZeroCrossings = {};
+    const float* const signal = stretchProcessedData->getReadPointer (0);
+    for (int i=0; i<lengthInSamples - 1; i++){
+        if ((signal[i] < 0) && (signal[i+1] >= 0)){
+            newZeroCrossings.push_back(i);
+        }
+    }
+    
+    const juce::ScopedLock sl (zeroCrossingsLock);
+    zeroCrossings.swap(newZeroCrossings);
+    zeroCrossingsVersion += 1;
+}
+
+int SourceSamplerSound::findNearestPositiveZeroCrossing(int position, int maxSamplesSearch)
+{
+    // Return the position of the nearest positive zero crossing after "position" (or before if maxSamplesSearch is negative)
+    // and not further than maxSamplesSearch samples. If none is found, return the original position. zeroCrossingsLock
+    // should be held when calling this
+    if (maxSamplesSearch >= 0){
+        auto it = std::lower_bound(zeroCrossings.begin(), zeroCrossings.end(), position);
+        if ((it != zeroCrossings.end()) && (*it < position + maxSamplesSearch)){
+            return *it;
+        }
+    } else {
+        auto it = std::lower_bound(zeroCrossings.begin(), zeroCrossings.end(), position);
+        if ((it != zeroCrossings.begin()) && (*(it - 1) >= position + maxSamplesSearch)){
+            return *(it - 1);
+        }
+    }
+    return position;  // If none found, return original
+}
+
+// --------------------------------------------------------------------------------------------
+
 bool SourceSamplerSound::isScheduledForDeletion() {
     return willBeDeleted;
 }
@@ -330,9 +529,11 @@ bool SourceSamplerSound::shouldBeDeleted(){
 
 
 SourceSound::SourceSound (const juce::ValueTree& _state,
-             std::function<GlobalContextStruct()> globalContextGetter): state(_state), soundLoaderThread (*this)
+             std::function<GlobalContextStruct()> globalContextGetter,
+             bool _addToSamplerWhenLoaded): state(_state), soundLoaderThread (*this)
 {
     getGlobalContext = globalContextGetter;
+    addToSamplerWhenLoaded = _addToSamplerWhenLoaded;
     bindState();
     
     // Trigger the loading of sounds in a separate thread
@@ -341,10 +542,8 @@ SourceSound::SourceSound (const juce::ValueTree& _state,
 
 SourceSound::~SourceSound ()
 {
-    for (int i = 0; i < downloadTasks.size(); i++) {
-        downloadTasks.at(i).reset();
-    }
     soundLoaderThread.stopThread(20000);
+    downloadScheduler->cancelDownloads(this);
 }
 
 void SourceSound::bindState ()
@@ -356,86 +555,10 @@ void SourceSound::bindState ()
     SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::midiNotes, SourceDefaults::midiNotes);
     midiNotesAsString.referTo(state, SourceIDs::midiNotes, nullptr);
     
-    // --> Start auto-generated code C
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::launchMode, SourceDefaults::launchMode);
-    launchMode.referTo(state, SourceIDs::launchMode, nullptr, SourceDefaults::launchMode);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::startPosition, SourceDefaults::startPosition);
-    startPosition.referTo(state, SourceIDs::startPosition, nullptr, SourceDefaults::startPosition);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::endPosition, SourceDefaults::endPosition);
-    endPosition.referTo(state, SourceIDs::endPosition, nullptr, SourceDefaults::endPosition);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::loopStartPosition, SourceDefaults::loopStartPosition);
-    loopStartPosition.referTo(state, SourceIDs::loopStartPosition, nullptr, SourceDefaults::loopStartPosition);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::loopEndPosition, SourceDefaults::loopEndPosition);
-    loopEndPosition.referTo(state, SourceIDs::loopEndPosition, nullptr, SourceDefaults::loopEndPosition);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::loopXFadeNSamples, SourceDefaults::loopXFadeNSamples);
-    loopXFadeNSamples.referTo(state, SourceIDs::loopXFadeNSamples, nullptr, SourceDefaults::loopXFadeNSamples);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::reverse, SourceDefaults::reverse);
-    reverse.referTo(state, SourceIDs::reverse, nullptr, SourceDefaults::reverse);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::noteMappingMode, SourceDefaults::noteMappingMode);
-    noteMappingMode.referTo(state, SourceIDs::noteMappingMode, nullptr, SourceDefaults::noteMappingMode);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::numSlices, SourceDefaults::numSlices);
-    numSlices.referTo(state, SourceIDs::numSlices, nullptr, SourceDefaults::numSlices);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::playheadPosition, SourceDefaults::playheadPosition);
-    playheadPosition.referTo(state, SourceIDs::playheadPosition, nullptr, SourceDefaults::playheadPosition);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::freezePlayheadSpeed, SourceDefaults::freezePlayheadSpeed);
-    freezePlayheadSpeed.referTo(state, SourceIDs::freezePlayheadSpeed, nullptr, SourceDefaults::freezePlayheadSpeed);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterCutoff, SourceDefaults::filterCutoff);
-    filterCutoff.referTo(state, SourceIDs::filterCutoff, nullptr, SourceDefaults::filterCutoff);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterRessonance, SourceDefaults::filterRessonance);
-    filterRessonance.referTo(state, SourceIDs::filterRessonance, nullptr, SourceDefaults::filterRessonance);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterKeyboardTracking, SourceDefaults::filterKeyboardTracking);
-    filterKeyboardTracking.referTo(state, SourceIDs::filterKeyboardTracking, nullptr, SourceDefaults::filterKeyboardTracking);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterAttack, SourceDefaults::filterAttack);
-    filterAttack.referTo(state, SourceIDs::filterAttack, nullptr, SourceDefaults::filterAttack);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterDecay, SourceDefaults::filterDecay);
-    filterDecay.referTo(state, SourceIDs::filterDecay, nullptr, SourceDefaults::filterDecay);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterSustain, SourceDefaults::filterSustain);
-    filterSustain.referTo(state, SourceIDs::filterSustain, nullptr, SourceDefaults::filterSustain);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterRelease, SourceDefaults::filterRelease);
-    filterRelease.referTo(state, SourceIDs::filterRelease, nullptr, SourceDefaults::filterRelease);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::filterADSR2CutoffAmt, SourceDefaults::filterADSR2CutoffAmt);
-    filterADSR2CutoffAmt.referTo(state, SourceIDs::filterADSR2CutoffAmt, nullptr, SourceDefaults::filterADSR2CutoffAmt);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::gain, SourceDefaults::gain);
-    gain.referTo(state, SourceIDs::gain, nullptr, SourceDefaults::gain);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::attack, SourceDefaults::attack);
-    attack.referTo(state, SourceIDs::attack, nullptr, SourceDefaults::attack);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::decay, SourceDefaults::decay);
-    decay.referTo(state, SourceIDs::decay, nullptr, SourceDefaults::decay);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::sustain, SourceDefaults::sustain);
-    sustain.referTo(state, SourceIDs::sustain, nullptr, SourceDefaults::sustain);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::release, SourceDefaults::release);
-    release.referTo(state, SourceIDs::release, nullptr, SourceDefaults::release);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::pan, SourceDefaults::pan);
-    pan.referTo(state, SourceIDs::pan, nullptr, SourceDefaults::pan);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::pitch, SourceDefaults::pitch);
-    pitch.referTo(state, SourceIDs::pitch, nullptr, SourceDefaults::pitch);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::pitchBendRangeUp, SourceDefaults::pitchBendRangeUp);
-    pitchBendRangeUp.referTo(state, SourceIDs::pitchBendRangeUp, nullptr, SourceDefaults::pitchBendRangeUp);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::pitchBendRangeDown, SourceDefaults::pitchBendRangeDown);
-    pitchBendRangeDown.referTo(state, SourceIDs::pitchBendRangeDown, nullptr, SourceDefaults::pitchBendRangeDown);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::mod2CutoffAmt, SourceDefaults::mod2CutoffAmt);
-    mod2CutoffAmt.referTo(state, SourceIDs::mod2CutoffAmt, nullptr, SourceDefaults::mod2CutoffAmt);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::mod2GainAmt, SourceDefaults::mod2GainAmt);
-    mod2GainAmt.referTo(state, SourceIDs::mod2GainAmt, nullptr, SourceDefaults::mod2GainAmt);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::mod2PitchAmt, SourceDefaults::mod2PitchAmt);
-    mod2PitchAmt.referTo(state, SourceIDs::mod2PitchAmt, nullptr, SourceDefaults::mod2PitchAmt);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::mod2PlayheadPos, SourceDefaults::mod2PlayheadPos);
-    mod2PlayheadPos.referTo(state, SourceIDs::mod2PlayheadPos, nullptr, SourceDefaults::mod2PlayheadPos);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::vel2CutoffAmt, SourceDefaults::vel2CutoffAmt);
-    vel2CutoffAmt.referTo(state, SourceIDs::vel2CutoffAmt, nullptr, SourceDefaults::vel2CutoffAmt);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::vel2GainAmt, SourceDefaults::vel2GainAmt);
-    vel2GainAmt.referTo(state, SourceIDs::vel2GainAmt, nullptr, SourceDefaults::vel2GainAmt);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::velSensitivity, SourceDefaults::velSensitivity);
-    velSensitivity.referTo(state, SourceIDs::velSensitivity, nullptr, SourceDefaults::velSensitivity);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::midiChannel, SourceDefaults::midiChannel);
-    midiChannel.referTo(state, SourceIDs::midiChannel, nullptr, SourceDefaults::midiChannel);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::pitchShift, SourceDefaults::pitchShift);
-    pitchShift.referTo(state, SourceIDs::pitchShift, nullptr, SourceDefaults::pitchShift);
-    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::timeStretch, SourceDefaults::timeStretch);
-    timeStretch.referTo(state, SourceIDs::timeStretch, nullptr, SourceDefaults::timeStretch);
-    // --> End auto-generated code C
+    parameters.bindState(state);
     
     midiCCmappings = std::make_unique<MidiCCMappingList>(state);
+    rebuildMidiCCTable();
 }
 
 std::vector<SourceSamplerSound*> SourceSound::getLinkedSourceSamplerSounds() {
@@ -463,7 +586,8 @@ SourceSamplerSound* SourceSound::getFirstLinkedSourceSamplerSound() {
 SourceSamplerSound* SourceSound::getLinkedSourceSamplerSoundWithUUID(const juce::String& sourceSamplerSoundUUID) {
     for (int i=0; i<getGlobalContext().sampler->getNumSounds(); i++){
         auto* sourceSamplerSound = static_cast<SourceSamplerSound*>(getGlobalContext().sampler->getSound(i).get());
-        if (sourceSamplerSound->getUUID() == sourceSamplerSoundUUID){
+        // Sounds scheduled for deletion are skipped as a provisional sound being deleted has the same UUID as the definitive one
+        if (sourceSamplerSound->getUUID() == sourceSamplerSoundUUID && !sourceSamplerSound->isScheduledForDeletion()){
             return sourceSamplerSound;
         }
     }
@@ -480,15 +604,16 @@ bool SourceSound::isScheduledForDeletion() {
     return willBeDeleted.get();
 }
 
-void SourceSound::scheduleSoundDeletion(){
-    // Trigger stop all currently active notes for that sound and set timestamp so sound gets deleted async
+void SourceSound::scheduleSoundDeletion(bool allowTailOff){
+    // Trigger stop all currently active notes for that sound and set timestamp so sound gets deleted async. If allowTailOff
+    // is true, notes are released instead of cut and the sound is only deleted once these finish (see SourceSampler::timerCallback)
     for (int i=0; i<getGlobalContext().sampler->getNumVoices(); i++){
         auto* voice = getGlobalContext().sampler->getVoice(i);
         if (voice != nullptr){
             if (voice->isVoiceActive()){
                 auto* currentlyPlayingSound = static_cast<SourceSamplerVoice*>(voice)->getCurrentlyPlayingSourceSamplerSound();
                 if (currentlyPlayingSound->getSourceSound()->getUUID() == getUUID()){
-                    voice->stopNote(0.0f, false);
+                    voice->stopNote(0.0f, allowTailOff);
                 }
             }
         }
@@ -501,129 +626,121 @@ bool SourceSound::shouldBeDeleted(){
     return isScheduledForDeletion() && ((juce::Time::getMillisecondCounterHiRes() - scheduledForDeletionTime) > SAFE_SOUND_DELETION_TIME_MS);
 }
 
+bool SourceSound::hasFinishedLoading(){
+    return allSoundsLoaded.get();
+}
+
+size_t SourceSound::getMemorySizeBytes(){
+    const juce::ScopedLock sl (samplerSoundCreateDeleteLock);
+    size_t size = 0;
+    for (auto& stagedSound: stagedSourceSamplerSounds){
+        size += static_cast<SourceSamplerSound*>(stagedSound.get())->getMemorySizeBytes();
+    }
+    for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
+        size += sourceSamplerSound->getMemorySizeBytes();
+    }
+    return size;
+}
+
+void SourceSound::addStagedSourceSamplerSoundsToSampler(){
+    // Add the SourceSamplerSound(s) loaded while the sound was part of a staged preset to the sampler. From now on the sound
+    // behaves as any other loaded sound. This is called when swapping presets with samplerSoundCreateDeleteLock and then the
+    // sampler lock held (same order as in addSourceSamplerSoundsToSampler)
+    for (auto& stagedSound: stagedSourceSamplerSounds){
+        getGlobalContext().sampler->addSound(stagedSound);
+    }
+    stagedSourceSamplerSounds.clear();
+    addToSamplerWhenLoaded = true;
+    assignMidiNotesAndVelocityToSourceSamplerSounds();
+}
+
 // --------------------------------------------------------------------------------------------
 
+float SourceSound::getParameter(ParamId paramId){
+    return parameters.get(paramId);
+}
+
+void SourceSound::setParameter(ParamId paramId, float value){
+    parameters.set(paramId, value);
+    
+    // Do some checking of start/end loop start/end positions to make sure we don't do anything wrong
+    bool isPositionParameter = (paramId == ParamId::startPosition) || (paramId == ParamId::endPosition) || (paramId == ParamId::loopStartPosition) || (paramId == ParamId::loopEndPosition);
+    if (isPositionParameter){
+        checkStartEndAndLoopPositions();
+    }
+    
+    // If setting pitch shift/time stretch properties, also trigger re pre-processing of audio data
+    if ((paramId == ParamId::pitchShift) || (paramId == ParamId::timeStretch)) {
+        for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
+            sourceSamplerSound->setStretchParameters(parameters.get(ParamId::pitchShift), parameters.get(ParamId::timeStretch));
+        }
+    }
+    
+    // If setting start/end/loop positions from the message thread, re-compute the slice tables right away so positions are moved to
+    // zero crossings here and not in the audio thread. Changes made from other threads will be picked up by the sound's timer
+    if (isPositionParameter && juce::MessageManager::existsAndIsCurrentThread()) {
+        for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
+            sourceSamplerSound->updateSliceTableIfNeeded();
+        }
+    }
+}
+
 int SourceSound::getParameterInt(juce::Identifier identifier){
-    // --> Start auto-generated code E
-        if (identifier == SourceIDs::launchMode) { return launchMode.get(); }
-        else if (identifier == SourceIDs::loopXFadeNSamples) { return loopXFadeNSamples.get(); }
-        else if (identifier == SourceIDs::reverse) { return reverse.get(); }
-        else if (identifier == SourceIDs::noteMappingMode) { return noteMappingMode.get(); }
-        else if (identifier == SourceIDs::numSlices) { return numSlices.get(); }
-        else if (identifier == SourceIDs::midiChannel) { return midiChannel.get(); }
-        // --> End auto-generated code E
-    throw std::runtime_error("No int parameter with this name");
+    ParamId paramId;
+    if (!SoundParameterStore::findParamId(identifier, paramId) || !getParamInfo(paramId).isInteger){
+        throw std::runtime_error("No int parameter with this name");
+    }
+    return (int)parameters.get(paramId);
 }
 
 float SourceSound::getParameterFloat(juce::Identifier identifier, bool normed){
-    // --> Start auto-generated code F
-        if (identifier == SourceIDs::startPosition) { return !normed ? startPosition.get() : juce::jmap(startPosition.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::endPosition) { return !normed ? endPosition.get() : juce::jmap(endPosition.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::loopStartPosition) { return !normed ? loopStartPosition.get() : juce::jmap(loopStartPosition.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::loopEndPosition) { return !normed ? loopEndPosition.get() : juce::jmap(loopEndPosition.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::playheadPosition) { return !normed ? playheadPosition.get() : juce::jmap(playheadPosition.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::freezePlayheadSpeed) { return !normed ? freezePlayheadSpeed.get() : juce::jmap(freezePlayheadSpeed.get(), 1.0f, 5000.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterCutoff) { return !normed ? filterCutoff.get() : juce::jmap(filterCutoff.get(), 10.0f, 20000.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterRessonance) { return !normed ? filterRessonance.get() : juce::jmap(filterRessonance.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterKeyboardTracking) { return !normed ? filterKeyboardTracking.get() : juce::jmap(filterKeyboardTracking.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterAttack) { return !normed ? filterAttack.get() : juce::jmap(filterAttack.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterDecay) { return !normed ? filterDecay.get() : juce::jmap(filterDecay.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterSustain) { return !normed ? filterSustain.get() : juce::jmap(filterSustain.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterRelease) { return !normed ? filterRelease.get() : juce::jmap(filterRelease.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterADSR2CutoffAmt) { return !normed ? filterADSR2CutoffAmt.get() : juce::jmap(filterADSR2CutoffAmt.get(), 0.0f, 100.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::gain) { return !normed ? gain.get() : juce::jmap(gain.get(), -80.0f, 12.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::attack) { return !normed ? attack.get() : juce::jmap(attack.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::decay) { return !normed ? decay.get() : juce::jmap(decay.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::sustain) { return !normed ? sustain.get() : juce::jmap(sustain.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::release) { return !normed ? release.get() : juce::jmap(release.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::pan) { return !normed ? pan.get() : juce::jmap(pan.get(), -1.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::pitch) { return !normed ? pitch.get() : juce::jmap(pitch.get(), -36.0f, 36.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::pitchBendRangeUp) { return !normed ? pitchBendRangeUp.get() : juce::jmap(pitchBendRangeUp.get(), 0.0f, 36.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::pitchBendRangeDown) { return !normed ? pitchBendRangeDown.get() : juce::jmap(pitchBendRangeDown.get(), 0.0f, 36.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::mod2CutoffAmt) { return !normed ? mod2CutoffAmt.get() : juce::jmap(mod2CutoffAmt.get(), 0.0f, 100.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::mod2GainAmt) { return !normed ? mod2GainAmt.get() : juce::jmap(mod2GainAmt.get(), -12.0f, 12.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::mod2PitchAmt) { return !normed ? mod2PitchAmt.get() : juce::jmap(mod2PitchAmt.get(), -12.0f, 12.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::mod2PlayheadPos) { return !normed ? mod2PlayheadPos.get() : juce::jmap(mod2PlayheadPos.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::vel2CutoffAmt) { return !normed ? vel2CutoffAmt.get() : juce::jmap(vel2CutoffAmt.get(), 0.0f, 100.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::vel2GainAmt) { return !normed ? vel2GainAmt.get() : juce::jmap(vel2GainAmt.get(), 0.0f, 1.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::velSensitivity) { return !normed ? velSensitivity.get() : juce::jmap(velSensitivity.get(), 0.0f, 6.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::pitchShift) { return !normed ? pitchShift.get() : juce::jmap(pitchShift.get(), -36.0f, 36.0f, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::timeStretch) { return !normed ? timeStretch.get() : juce::jmap(timeStretch.get(), 0.1f, 4.0f, 0.0f, 1.0f); }
-        // --> End auto-generated code F
-    throw std::runtime_error("No float parameter with this name");
+    ParamId paramId;
+    if (!SoundParameterStore::findParamId(identifier, paramId) || getParamInfo(paramId).isInteger){
+        throw std::runtime_error("No float parameter with this name");
+    }
+    const auto& info = getParamInfo(paramId);
+    return !normed ? parameters.get(paramId) : juce::jmap(parameters.get(paramId), info.minValue, info.maxValue, 0.0f, 1.0f);
 }
 
 void SourceSound::setParameterByNameFloat(juce::Identifier identifier, float value, bool normed){
-    // --> Start auto-generated code B
-        if (identifier == SourceIDs::startPosition) { startPosition = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::endPosition) { endPosition = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::loopStartPosition) { loopStartPosition = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::loopEndPosition) { loopEndPosition = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::playheadPosition) { playheadPosition = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::freezePlayheadSpeed) { freezePlayheadSpeed = !normed ? juce::jlimit(1.0f, 5000.0f, value) : juce::jmap(value, 1.0f, 5000.0f); }
-        else if (identifier == SourceIDs::filterCutoff) { filterCutoff = !normed ? juce::jlimit(10.0f, 20000.0f, value) : juce::jmap(value, 10.0f, 20000.0f); }
-        else if (identifier == SourceIDs::filterRessonance) { filterRessonance = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterKeyboardTracking) { filterKeyboardTracking = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterAttack) { filterAttack = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterDecay) { filterDecay = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterSustain) { filterSustain = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterRelease) { filterRelease = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::filterADSR2CutoffAmt) { filterADSR2CutoffAmt = !normed ? juce::jlimit(0.0f, 100.0f, value) : juce::jmap(value, 0.0f, 100.0f); }
-        else if (identifier == SourceIDs::gain) { gain = !normed ? juce::jlimit(-80.0f, 12.0f, value) : juce::jmap(value, -80.0f, 12.0f); }
-        else if (identifier == SourceIDs::attack) { attack = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::decay) { decay = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::sustain) { sustain = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::release) { release = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::pan) { pan = !normed ? juce::jlimit(-1.0f, 1.0f, value) : juce::jmap(value, -1.0f, 1.0f); }
-        else if (identifier == SourceIDs::pitch) { pitch = !normed ? juce::jlimit(-36.0f, 36.0f, value) : juce::jmap(value, -36.0f, 36.0f); }
-        else if (identifier == SourceIDs::pitchBendRangeUp) { pitchBendRangeUp = !normed ? juce::jlimit(0.0f, 36.0f, value) : juce::jmap(value, 0.0f, 36.0f); }
-        else if (identifier == SourceIDs::pitchBendRangeDown) { pitchBendRangeDown = !normed ? juce::jlimit(0.0f, 36.0f, value) : juce::jmap(value, 0.0f, 36.0f); }
-        else if (identifier == SourceIDs::mod2CutoffAmt) { mod2CutoffAmt = !normed ? juce::jlimit(0.0f, 100.0f, value) : juce::jmap(value, 0.0f, 100.0f); }
-        else if (identifier == SourceIDs::mod2GainAmt) { mod2GainAmt = !normed ? juce::jlimit(-12.0f, 12.0f, value) : juce::jmap(value, -12.0f, 12.0f); }
-        else if (identifier == SourceIDs::mod2PitchAmt) { mod2PitchAmt = !normed ? juce::jlimit(-12.0f, 12.0f, value) : juce::jmap(value, -12.0f, 12.0f); }
-        else if (identifier == SourceIDs::mod2PlayheadPos) { mod2PlayheadPos = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::vel2CutoffAmt) { vel2CutoffAmt = !normed ? juce::jlimit(0.0f, 100.0f, value) : juce::jmap(value, 0.0f, 100.0f); }
-        else if (identifier == SourceIDs::vel2GainAmt) { vel2GainAmt = !normed ? juce::jlimit(0.0f, 1.0f, value) : juce::jmap(value, 0.0f, 1.0f); }
-        else if (identifier == SourceIDs::velSensitivity) { velSensitivity = !normed ? juce::jlimit(0.0f, 6.0f, value) : juce::jmap(value, 0.0f, 6.0f); }
-        else if (identifier == SourceIDs::pitchShift) { pitchShift = !normed ? juce::jlimit(-36.0f, 36.0f, value) : juce::jmap(value, -36.0f, 36.0f); }
-        else if (identifier == SourceIDs::timeStretch) { timeStretch = !normed ? juce::jlimit(0.1f, 4.0f, value) : juce::jmap(value, 0.1f, 4.0f); }
-        // --> End auto-generated code B
-    else { throw std::runtime_error("No float parameter with this name"); }
-    
-    // Do some checking of start/end loop start/end positions to make sure we don't do anything wrong
+    ParamId paramId;
+    if (!SoundParameterStore::findParamId(identifier, paramId) || getParamInfo(paramId).isInteger){
+        throw std::runtime_error("No float parameter with this name");
+    }
+    const auto& info = getParamInfo(paramId);
+    setParameter(paramId, !normed ? value : juce::jmap(value, info.minValue, info.maxValue));
+}
+
+void SourceSound::setParameterByNameInt(juce::Identifier identifier, int value){
+    ParamId paramId;
+    if (!SoundParameterStore::findParamId(identifier, paramId) || !getParamInfo(paramId).isInteger){
+        throw std::runtime_error("No int parameter with this name");
+    }
+    setParameter(paramId, (float)value);
+}
+
+void SourceSound::checkStartEndAndLoopPositions(){
+    float startPosition = parameters.get(ParamId::startPosition);
+    float endPosition = parameters.get(ParamId::endPosition);
+    float loopStartPosition = parameters.get(ParamId::loopStartPosition);
+    float loopEndPosition = parameters.get(ParamId::loopEndPosition);
     if (endPosition < startPosition) {
-        endPosition = startPosition.get();
+        parameters.set(ParamId::endPosition, startPosition);
+        endPosition = startPosition;
     }
     if (loopStartPosition < startPosition){
-        loopStartPosition = startPosition.get();
+        parameters.set(ParamId::loopStartPosition, startPosition);
+        loopStartPosition = startPosition;
     }
     if (loopEndPosition > endPosition){
-        loopEndPosition = endPosition.get();
+        parameters.set(ParamId::loopEndPosition, endPosition);
+        loopEndPosition = endPosition;
     }
     if (loopStartPosition > loopEndPosition){
-        loopStartPosition = loopEndPosition.get();
-    }
-    
-    // If setting pitch shift/time stretch properties, also trigger re pre-processing of audio data
-    if ((identifier == SourceIDs::pitchShift) || (identifier == SourceIDs::timeStretch)) {
-        for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
-            sourceSamplerSound->setStretchParameters(pitchShift, timeStretch);
-        }
+        parameters.set(ParamId::loopStartPosition, loopEndPosition);
     }
 }
 
-void SourceSound::setParameterByNameInt(juce::Identifier identifier, int value){
-    // --> Start auto-generated code D
-        if (identifier == SourceIDs::launchMode) { launchMode = juce::jlimit(0, 4, value); }
-        else if (identifier == SourceIDs::loopXFadeNSamples) { loopXFadeNSamples = juce::jlimit(10, 100000, value); }
-        else if (identifier == SourceIDs::reverse) { reverse = juce::jlimit(0, 1, value); }
-        else if (identifier == SourceIDs::noteMappingMode) { noteMappingMode = juce::jlimit(0, 3, value); }
-        else if (identifier == SourceIDs::numSlices) { numSlices = juce::jlimit(0, 100, value); }
-        else if (identifier == SourceIDs::midiChannel) { midiChannel = juce::jlimit(0, 16, value); }
-        // --> End auto-generated code D
-    else { throw std::runtime_error("No int parameter with this name"); }
-}
-
 juce::BigInteger SourceSound::getMappedMidiNotes(){
     // Returns the MIDI notes of the Sound (note that individual SourceSamplerSound(s) might have different assingments depending on root note)
     juce::BigInteger midiNotes;
@@ -773,61 +890,191 @@ void SourceSound::setOnsetTimesSamples(std::vector<float> onsetTimes){
 // ------------------------------------------------------------------------------------------------
 
 void SourceSound::addOrEditMidiMapping(juce::String uuid, int ccNumber, juce::String parameterName, float minRange, float maxRange){
-    const juce::ScopedLock sl (midiMappingCreateDeleteLock);
-    
-    juce::ValueTree existingMapping = state.getChildWithProperty(SourceIDs::uuid, uuid);
-    if (existingMapping.isValid()) {
-        // Modify existing mapping
-        existingMapping.setProperty (SourceIDs::ccNumber, ccNumber, nullptr);
-        existingMapping.setProperty (SourceIDs::parameterName, parameterName, nullptr);
-        existingMapping.setProperty (SourceIDs::minRange, juce::jlimit(0.0f, 1.0f, minRange), nullptr);
-        existingMapping.setProperty (SourceIDs::maxRange, juce::jlimit(0.0f, 1.0f, maxRange), nullptr);
-    } else {
-        // No mapping with uuid found, create a new one
-        // TODO: move this to the MidiCCMappingList class?
-        juce::ValueTree newMapping = SourceHelpers::createMidiMappingState(ccNumber, parameterName, juce::jlimit(0.0f, 1.0f, minRange), juce::jlimit(0.0f, 1.0f, maxRange));
-        state.addChild(newMapping, -1, nullptr);
+    {
+        const juce::ScopedLock sl (midiMappingCreateDeleteLock);
+        
+        juce::ValueTree existingMapping = state.getChildWithProperty(SourceIDs::uuid, uuid);
+        if (existingMapping.isValid()) {
+            // Modify existing mapping
+            existingMapping.setProperty (SourceIDs::ccNumber, ccNumber, nullptr);
+            existingMapping.setProperty (SourceIDs::parameterName, parameterName, nullptr);
+            existingMapping.setProperty (SourceIDs::minRange, juce::jlimit(0.0f, 1.0f, minRange), nullptr);
+            existingMapping.setProperty (SourceIDs::maxRange, juce::jlimit(0.0f, 1.0f, maxRange), nullptr);
+        } else {
+            // No mapping with uuid found, create a new one
+            // TODO: move this to the MidiCCMappingList class?
+            juce::ValueTree newMapping = SourceHelpers::createMidiMappingState(ccNumber, parameterName, juce::jlimit(0.0f, 1.0f, minRange), juce::jlimit(0.0f, 1.0f, maxRange));
+            state.addChild(newMapping, -1, nullptr);
+        }
     }
+    rebuildMidiCCTable();
 }
 
-std::vector<MidiCCMapping*> SourceSound::getMidiMappingsForCcNumber(int ccNumber){
-    std::vector<MidiCCMapping*> toReturn = {};
-    for (auto* midiCCmapping: midiCCmappings->objects){
-        if (midiCCmapping->ccNumber == ccNumber){
-            toReturn.push_back(midiCCmapping);
+void SourceSound::removeMidiMapping(juce::String uuid){
+    {
+        const juce::ScopedLock sl (midiMappingCreateDeleteLock);
+        midiCCmappings->removeMidiCCMappingWithUUID(uuid);
+    }
+    rebuildMidiCCTable();
+}
+
+void SourceSound::rebuildMidiCCTable(){
+    // Compile the MIDI CC mappings into a table indexed by CC number with the numeric ID of the target parameters and the
+    // mapped range already converted to parameter units. This runs in the message thread every time mappings change, the
+    // table is then swapped atomically and the old one is kept for a while in case the audio thread is still reading it.
+    auto newTable = std::make_unique<MidiCCTable>();
+    {
+        const juce::ScopedLock sl (midiMappingCreateDeleteLock);
+        for (auto* midiCCmapping: midiCCmappings->objects){
+            int ccNumber = midiCCmapping->ccNumber.get();
+            juce::String parameterName = midiCCmapping->parameterName.get();
+            ParamId paramId;
+            if ((ccNumber >= 0) && (ccNumber < 128) && parameterName.isNotEmpty() && SoundParameterStore::findParamId(parameterName, paramId) && !getParamInfo(paramId).isInteger){
+                const auto& info = getParamInfo(paramId);
+                MidiCCTable::Entry entry;
+                entry.parameter = paramId;
+                entry.minValue = juce::jmap(midiCCmapping->minRange.get(), info.minValue, info.maxValue);
+                entry.maxValue = juce::jmap(midiCCmapping->maxRange.get(), info.minValue, info.maxValue);
+                newTable->entriesForCcNumber[ccNumber].push_back(entry);
+            }
         }
     }
-    return toReturn;
+    
+    double now = juce::Time::getMillisecondCounterHiRes();
+    if (currentMidiCCTable != nullptr){
+        currentMidiCCTable->retiredAtTime = now;
+        retiredMidiCCTables.push_back(std::move(currentMidiCCTable));
+    }
+    currentMidiCCTable = std::move(newTable);
+    midiCCTable.store(currentMidiCCTable.get());
+    freeRetiredMidiCCTables();
 }
 
-void SourceSound::removeMidiMapping(juce::String uuid){
-    const juce::ScopedLock sl (midiMappingCreateDeleteLock);
-    midiCCmappings->removeMidiCCMappingWithUUID(uuid);
+void SourceSound::freeRetiredMidiCCTables(){
+    double now = juce::Time::getMillisecondCounterHiRes();
+    retiredMidiCCTables.erase(std::remove_if(retiredMidiCCTables.begin(), retiredMidiCCTables.end(), [now](const std::unique_ptr<MidiCCTable>& table){
+        return (now - table->retiredAtTime) > SAFE_SOUND_DELETION_TIME_MS;
+    }), retiredMidiCCTables.end());
 }
 
-void SourceSound::applyMidiCCModulations(int channel, int number, int value) {
-    const juce::ScopedLock sl (midiMappingCreateDeleteLock);
-    
-    int globalMidiChannel = getGlobalContext().midiInChannel;
-    int soundMidiChannel = midiChannel.get();
+void SourceSound::applyMidiCCModulations(int channel, int number, int value, int globalMidiInChannel) {
+    // This is called from the audio thread for every MIDI CC message. Modulated values are written to the parameter store
+    // (so voices use them right away) and flagged so these are written back to the state later from the message thread
+    // (see writeBackParameterChanges). No locks are taken and no ValueTree listeners are called here.
+    int soundMidiChannel = (int)parameters.get(ParamId::midiChannel);
     bool appliesToChannel = false;
     if (soundMidiChannel == 0){
         // Check with global
-        appliesToChannel = (globalMidiChannel == 0) || (globalMidiChannel == channel);
+        appliesToChannel = (globalMidiInChannel == 0) || (globalMidiInChannel == channel);
     } else {
         // Check with sound channel
         appliesToChannel = soundMidiChannel == channel;
     }
-    if (appliesToChannel){
-        std::vector<MidiCCMapping*> mappings = getMidiMappingsForCcNumber(number);
-        for (int i=0; i<mappings.size(); i++){
-            float normInputValue = (float)value/127.0;  // This goes from 0 to 1
-            float value = juce::jmap(normInputValue, mappings[i]->minRange.get(), mappings[i]->maxRange.get());
-            setParameterByNameFloat(mappings[i]->parameterName.get(), value, true);
+    auto* table = midiCCTable.load();
+    if (appliesToChannel && (table != nullptr) && (number >= 0) && (number < 128)){
+        float normInputValue = (float)value/127.0f;  // This goes from 0 to 1
+        for (const auto& entry: table->entriesForCcNumber[number]){
+            parameters.setDeferred(entry.parameter, juce::jmap(normInputValue, entry.minValue, entry.maxValue));
         }
     }
 };
 
+void SourceSound::writeBackParameterChanges() {
+    // Write parameter values changed from other threads (e.g. MIDI CC modulations) back to the state. This is called periodically
+    // from the message thread so state listeners (e.g. UI state synchronization) are also called from the message thread
+    freeRetiredMidiCCTables();
+    auto written = parameters.writeChangesToState();
+    if (written.test((size_t)ParamId::startPosition) || written.test((size_t)ParamId::endPosition) || written.test((size_t)ParamId::loopStartPosition) || written.test((size_t)ParamId::loopEndPosition)){
+        checkStartEndAndLoopPositions();
+        for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
+            sourceSamplerSound->updateSliceTableIfNeeded();
+        }
+    }
+    if (written.test((size_t)ParamId::pitchShift) || written.test((size_t)ParamId::timeStretch)){
+        for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
+            sourceSamplerSound->setStretchParameters(parameters.get(ParamId::pitchShift), parameters.get(ParamId::timeStretch));
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+juce::String SourceSound::getAudioContentKey(const juce::ValueTree& soundState){
+    // Returns a string which identifies the audio content that needs to be loaded for a sound: the files of all its
+    // samples and the stretch parameters used to pre-process them. If two sounds have the same key, the audio buffers
+    // of one can be used for the other and only parameters need to be updated (see updateInPlaceFrom).
+    juce::String key;
+    for (int i=0; i<soundState.getNumChildren(); i++){
+        auto child = soundState.getChild(i);
+        if (child.hasType(SourceIDs::SOUND_SAMPLE)){
+            key += child.getProperty(SourceIDs::soundId, "").toString() + ":" + child.getProperty(SourceIDs::filePath, "").toString() + ";";
+        }
+    }
+    key += "ps=" + juce::String((float)soundState.getProperty(SourceIDs::pitchShift, SourceDefaults::pitchShift));
+    key += ";ts=" + juce::String((float)soundState.getProperty(SourceIDs::timeStretch, SourceDefaults::timeStretch));
+    return key;
+}
+
+bool SourceSound::canBeUpdatedInPlaceFrom(const juce::ValueTree& newSoundState){
+    // Only sounds which finished loading are re-used, otherwise the loader thread could still be reading the state
+    return !isScheduledForDeletion() && allSoundsLoaded.get() && (getAudioContentKey(state) == getAudioContentKey(newSoundState));
+}
+
+void SourceSound::updateInPlaceFrom(const juce::ValueTree& newSoundState){
+    // Update this sound with the contents of a sound with the same audio content key (e.g. a sound from a preset which
+    // is being loaded). Audio buffers (and their stretched versions) are kept, only properties, parameters, sample
+    // properties and MIDI CC mappings are copied. Parameter changes are picked up by the parameter store listener.
+    jassert(getAudioContentKey(state) == getAudioContentKey(newSoundState));
+    
+    for (int i=0; i<newSoundState.getNumProperties(); i++){
+        auto property = newSoundState.getPropertyName(i);
+        if ((property != SourceIDs::willBeDeleted) && (property != SourceIDs::allSoundsLoaded)
+            && (property != SourceIDs::pendingAnalysisFile) && (property != SourceIDs::pendingAnalysisSoundIndex)){
+            state.setProperty(property, newSoundState.getProperty(property), nullptr);
+        }
+    }
+    
+    // Samples are matched by order as the audio content key is the same. Properties computed when loading the audio
+    // (duration) are the same so these can be copied as well
+    int newSampleIndex = 0;
+    for (int i=0; i<state.getNumChildren(); i++){
+        auto sample = state.getChild(i);
+        if (sample.hasType(SourceIDs::SOUND_SAMPLE)){
+            while ((newSampleIndex < newSoundState.getNumChildren()) && !newSoundState.getChild(newSampleIndex).hasType(SourceIDs::SOUND_SAMPLE)){
+                newSampleIndex += 1;
+            }
+            auto newSample = newSoundState.getChild(newSampleIndex);
+            for (int j=0; j<newSample.getNumProperties(); j++){
+                auto property = newSample.getPropertyName(j);
+                sample.setProperty(property, newSample.getProperty(property), nullptr);
+            }
+            newSampleIndex += 1;
+        }
+    }
+    
+    {
+        const juce::ScopedLock sl (midiMappingCreateDeleteLock);
+        for (int i=state.getNumChildren() - 1; i>=0; i--){
+            if (state.getChild(i).hasType(SourceIDs::MIDI_CC_MAPPING)){
+                state.removeChild(i, nullptr);
+            }
+        }
+        for (int i=0; i<newSoundState.getNumChildren(); i++){
+            auto child = newSoundState.getChild(i);
+            if (child.hasType(SourceIDs::MIDI_CC_MAPPING)){
+                state.addChild(child.createCopy(), -1, nullptr);
+            }
+        }
+    }
+    rebuildMidiCCTable();
+    
+    checkStartEndAndLoopPositions();
+    assignMidiNotesAndVelocityToSourceSamplerSounds();
+    for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
+        sourceSamplerSound->updateSliceTableIfNeeded();
+    }
+}
+
 // ------------------------------------------------------------------------------------------------
 
 std::vector<SourceSamplerSound*> SourceSound::createSourceSamplerSounds ()
@@ -877,8 +1124,9 @@ std::vector<SourceSamplerSound*> SourceSound::createSourceSamplerSounds ()
 
 bool SourceSound::sourceSamplerSoundWithUUIDAlreadyCreated(const juce::String& sourceSamplerSoundUUID)
 {
+    // Sounds scheduled for deletion (e.g. provisional sounds being replaced) don't count
     for (auto sourceSamplerSound: getLinkedSourceSamplerSounds()){
-        if (sourceSamplerSound->getUUID() == sourceSamplerSoundUUID){
+        if (sourceSamplerSound->getUUID() == sourceSamplerSoundUUID && !sourceSamplerSound->isScheduledForDeletion()){
             return true;
         }
     }
@@ -888,7 +1136,20 @@ bool SourceSound::sourceSamplerSoundWithUUIDAlreadyCreated(const juce::String& s
 void SourceSound::addSourceSamplerSoundsToSampler()
 {
     const juce::ScopedLock sl (samplerSoundCreateDeleteLock);
+    // Provisional sounds (if any) are replaced by the ones created from the complete files
+    if (addToSamplerWhenLoaded){
+        removeProvisionalSourceSamplerSounds();
+    }
     std::vector<SourceSamplerSound*> sourceSamplerSounds = createSourceSamplerSounds();
+    if (!addToSamplerWhenLoaded){
+        // Sound is part of a staged preset, keep the SourceSamplerSound(s) until the preset is swapped in
+        for (auto sourceSamplerSound: sourceSamplerSounds) {
+            stagedSourceSamplerSounds.push_back(sourceSamplerSound);
+        }
+        std::cout << "Staged " << sourceSamplerSounds.size() << " SourceSamplerSound(s)... " << std::endl;
+        allSoundsLoaded = true;
+        return;
+    }
     for (auto sourceSamplerSound: sourceSamplerSounds) {
         if (shouldStopLoading()){
             // If loading process was cancelled, do an early return
@@ -898,6 +1159,9 @@ void SourceSound::addSourceSamplerSoundsToSampler()
         getGlobalContext().sampler->addSound(sourceSamplerSound);
     }
     assignMidiNotesAndVelocityToSourceSamplerSounds();
+    if (sourceSamplerSounds.size() > 0){
+        setFirstPlayableTimeIfNotSet();
+    }
     std::cout << "Added " << sourceSamplerSounds.size() << " SourceSamplerSound(s) to sampler... " << std::endl;
     allSoundsLoaded = true;
 }
@@ -926,8 +1190,13 @@ void SourceSound::removeSourceSampleSoundsFromSampler()
 void SourceSound::removeSourceSamplerSound(const juce::String& samplerSoundUUID, int indexInSampler)
 {
     const juce::ScopedLock sl (samplerSoundCreateDeleteLock);
+    auto* sourceSamplerSound = static_cast<SourceSamplerSound*>(getGlobalContext().sampler->getSound(indexInSampler).get());
+    bool wasProvisional = sourceSamplerSound->isProvisional();
     getGlobalContext().sampler->removeSound(indexInSampler); // Remove source sampler sound from the sampler
-    state.removeChild(state.getChildWithProperty(SourceIDs::uuid, samplerSoundUUID), nullptr);  // Also remove the bit of state corresponding to the sampler sound
+    if (!wasProvisional){
+        // Also remove the bit of state corresponding to the sampler sound (provisional sounds share it with the definitive sound)
+        state.removeChild(state.getChildWithProperty(SourceIDs::uuid, samplerSoundUUID), nullptr);
+    }
     std::cout << "Removed 1 SourceSamplerSound(s) from sampler... " << std::endl;
 }
 
@@ -977,6 +1246,8 @@ void SourceSound::loadSounds(std::function<bool()> _shouldStopLoading)
     
     allSoundsLoaded = false;
     
+    // If the sound comes from a preset file, analysis data was not loaded with the preset so attach it now
+    PresetFile::attachPendingAnalysis(state);
 
     // Set all download progress/completed properties to 0/false to start from scratch
     for (int i=0; i<state.getNumChildren(); i++){
@@ -1027,12 +1298,7 @@ void SourceSound::loadSounds(std::function<bool()> _shouldStopLoading)
                         juce::String downloadURL = juce::String("https://freesound.org/apiv2/sounds/<sound_id>/download/").replace("<sound_id>", child.getProperty(SourceIDs::soundId).toString(), false);
                         child.setProperty(SourceIDs::usesPreview, false, nullptr);
                         # if !USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS
-                        juce::URL::DownloadTaskOptions options = juce::URL::DownloadTaskOptions().withExtraHeaders("Authorization: Bearer " + getGlobalContext().freesoundOauthAccessToken).withListener(this);
-                        # if USE_APP_GROUP_ID
-                        options = options.withSharedContainer(APP_GROUP_ID);
-                        #endif
-                        std::unique_ptr<juce::URL::DownloadTask> downloadTask = juce::URL(downloadURL).downloadToFile(locationInDisk, options);
-                        downloadTasks.push_back(std::move(downloadTask));
+                        downloadScheduler->addDownload(juce::URL(downloadURL), locationInDisk, "Authorization: Bearer " + getGlobalContext().freesoundOauthAccessToken, getDownloadPriority(), this);
                         DBG("Downloading sound to " << locationInDisk.getFullPathName());
                         # else
                         juce::URL downloadServerUrlEndpoint;
@@ -1053,12 +1319,7 @@ void SourceSound::loadSounds(std::function<bool()> _shouldStopLoading)
                         child.setProperty(SourceIDs::usesPreview, true, nullptr);
                         juce::String previewURL = child.getProperty(SourceIDs::previewURL, "").toString();
                         # if !USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS
-                        juce::URL::DownloadTaskOptions options = juce::URL::DownloadTaskOptions().withListener(this);
-                        # if USE_APP_GROUP_ID
-                        options = options.withSharedContainer(APP_GROUP_ID);
-                        #endif
-                        std::unique_ptr<juce::URL::DownloadTask> downloadTask = juce::URL(previewURL).downloadToFile(locationInDisk, options);
-                        downloadTasks.push_back(std::move(downloadTask));
+                        downloadScheduler->addDownload(juce::URL(previewURL), locationInDisk, "", getDownloadPriority(), this);
                         DBG("Downloading sound to " << locationInDisk.getFullPathName());
                         # else
                         juce::URL downloadServerUrlEndpoint;
@@ -1184,13 +1445,113 @@ void SourceSound::downloadFinished(juce::File targetFileLocation, bool taskSucce
     }
 }
 
-void SourceSound::progress (juce::URL::DownloadTask *task, juce::int64 bytesDownloaded, juce::int64 totalLength)
+int SourceSound::getDownloadPriority()
+{
+    // Sounds mapped to notes are downloaded first as these can be played as soon as they are loaded
+    return getNumberOfMappedMidiNotes() > 0 ? DownloadScheduler::mappedSoundPriority : DownloadScheduler::defaultPriority;
+}
+
+void SourceSound::scheduledDownloadProgress (const juce::File& targetFileLocation, juce::int64 bytesDownloaded, juce::int64 totalLength)
 {
     float percentageCompleted = 100.0*(float)bytesDownloaded/(float)totalLength;
-    downloadProgressUpdate(task->getTargetLocation(), percentageCompleted);
+    downloadProgressUpdate(targetFileLocation, percentageCompleted);
+    #if ENABLE_PROVISIONAL_SOUNDS
+    createProvisionalSourceSamplerSoundIfPossible(targetFileLocation, bytesDownloaded);
+    #endif
+}
+
+void SourceSound::scheduledDownloadFinished (const juce::File& targetFileLocation, bool success)
+{
+    if (!success){
+        // Don't keep playing a part of a sound that will never finish loading
+        const juce::ScopedLock sl (samplerSoundCreateDeleteLock);
+        removeProvisionalSourceSamplerSounds();
+    }
+    downloadFinished(targetFileLocation, success);
 }
 
-void SourceSound::finished(juce::URL::DownloadTask *task, bool success)
+void SourceSound::createProvisionalSourceSamplerSoundIfPossible(const juce::File& targetFileLocation, juce::int64 bytesDownloaded)
 {
-    downloadFinished(task->getTargetLocation(), success);
+    // Create a SourceSamplerSound from the part of an OGG preview that has already been downloaded and add it to the sampler, so
+    // the sound can be played (at least its beginning) without waiting for the download of the whole file (and of the other
+    // samples of the sound). Ogg files can be decoded up to their last complete page. Provisional sounds are removed when all
+    // samples finish downloading and the definitive SourceSamplerSounds are created (see addSourceSamplerSoundsToSampler).
+    // This is called from the download threads. Sounds of staged presets are not audible yet so they are never made provisional.
+    if (!addToSamplerWhenLoaded || !targetFileLocation.hasFileExtension("ogg") || bytesDownloaded < PROVISIONAL_SOUND_MIN_BYTES){
+        return;
+    }
+    juce::ValueTree sampleState;
+    for (int i=0; i<state.getNumChildren(); i++){
+        auto child = state.getChild(i);
+        if (child.hasType(SourceIDs::SOUND_SAMPLE) && targetFileLocation == getGlobalContext().sourceDataLocation.getChildFile(child.getProperty(SourceIDs::filePath, "").toString())){
+            sampleState = child;
+            break;
+        }
+    }
+    if (!sampleState.isValid()){
+        return;
+    }
+    
+    const juce::ScopedLock sl (samplerSoundCreateDeleteLock);
+    juce::String sampleUUID = sampleState.getProperty(SourceIDs::uuid, "").toString();
+    auto nextAttempt = provisionalSoundNextAttemptBytes.find(sampleUUID);
+    if (nextAttempt == provisionalSoundNextAttemptBytes.end()){
+        if (sourceSamplerSoundWithUUIDAlreadyCreated(sampleUUID)){
+            return;
+        }
+        nextAttempt = provisionalSoundNextAttemptBytes.insert({sampleUUID, (juce::int64)PROVISIONAL_SOUND_MIN_BYTES}).first;
+    }
+    if (bytesDownloaded < nextAttempt->second){
+        return;
+    }
+    
+    juce::AudioFormatManager audioFormatManager;
+    audioFormatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(audioFormatManager.createReaderFor(DownloadScheduler::getPartialFileLocation(targetFileLocation)));
+    if (reader == nullptr || reader->lengthInSamples <= 0){
+        // Not enough data to decode yet, try again when twice as many bytes have been downloaded
+        nextAttempt->second = bytesDownloaded * 2;
+        return;
+    }
+    provisionalSoundNextAttemptBytes.erase(nextAttempt);
+    SourceSamplerSound* provisionalSound = new SourceSamplerSound(sampleState,
+                                                                  this,
+                                                                  *reader,
+                                                                  MAX_SAMPLE_LENGTH,
+                                                                  getGlobalContext().sampleRate,
+                                                                  getGlobalContext().samplesPerBlock,
+                                                                  true);
+    getGlobalContext().sampler->addSound(provisionalSound);
+    assignMidiNotesAndVelocityToSourceSamplerSounds();
+    setFirstPlayableTimeIfNotSet();
+    DBG("Added provisional SourceSamplerSound with " << provisionalSound->getLengthInSeconds() << " seconds of audio for " << targetFileLocation.getFileName());
+}
+
+void SourceSound::setFirstPlayableTimeIfNotSet()
+{
+    double notSet = 0.0;
+    firstPlayableTimeMs.compare_exchange_strong(notSet, juce::Time::getMillisecondCounterHiRes());
+}
+
+void SourceSound::removeProvisionalSourceSamplerSounds()
+{
+    // Must be called with samplerSoundCreateDeleteLock held. Voices playing provisional sounds are released (with tail off) and
+    // the provisional sounds are scheduled for deletion like any other SourceSamplerSound. These will be removed from the sampler
+    // in the message thread once no voice is playing them (see SourceSampler::timerCallback). In the meantime, provisional sounds
+    // don't trigger new notes and are ignored when looking up sounds by UUID, so the definitive sounds can be created right away.
+    provisionalSoundNextAttemptBytes.clear();
+    auto* sampler = getGlobalContext().sampler;
+    const juce::ScopedLock sl (sampler->getLock());
+    for (int i=0; i<sampler->getNumSounds(); i++){
+        auto* sourceSamplerSound = static_cast<SourceSamplerSound*>(sampler->getSound(i).get());
+        if (sourceSamplerSound->getSourceSound() == this && sourceSamplerSound->isProvisional() && !sourceSamplerSound->isScheduledForDeletion()){
+            for (int j=0; j<sampler->getNumVoices(); j++){
+                auto* voice = static_cast<SourceSamplerVoice*>(sampler->getVoice(j));
+                if (voice->isVoiceActive() && voice->getCurrentlyPlayingSourceSamplerSound() == sourceSamplerSound){
+                    voice->stopNote(0.0f, true);
+                }
+            }
+            sourceSamplerSound->scheduleSampleSoundDeletion();
+        }
+    }
 }
@@ -11,6 +11,8 @@
 #pragma once
 #include <JuceHeader.h>
 #include "helpers_source.h"
+#include "SoundParameterStore.h"
+#include "DownloadScheduler.h"
 #include "signalsmith-stretch.h"
 
 
@@ -20,6 +22,70 @@ using Stretch = signalsmith::stretch::SignalsmithStretch<float>;
 class SourceSound;
 
 
+//==============================================================================
+// Immutable table with the start/end positions (in samples) of the slices of a SourceSamplerSound when
+// playing in one of the slicing note mapping modes, and with the loop start/end positions to be used in the
+// other modes. Tables are computed in the message thread when any of the parameters they depend on changes,
+// and then published to the audio thread using an atomic pointer. In this way voices can get the slice
+// boundaries for a note by simply indexing the table instead of having to re-compute slices (and allocate
+// vectors of onsets) at every processing block. Loop positions and slice boundaries are stored already moved
+// to the nearest positive zero crossings so that voices don't need to search for them either.
+
+struct SliceTable
+{
+    // Parameters used to compute the table (used to check if the table needs to be re-computed)
+    int startPositionSample = 0;
+    int endPositionSample = 0;
+    int loopStartPositionSample = 0;
+    int loopEndPositionSample = 0;
+    int numSlices = 0;
+    int numMappedMidiNotes = 0;
+    int lengthInSamples = 0;
+    int onsetTimesVersion = 0;
+    int zeroCrossingsVersion = 0;
+    
+    // Computed loop positions (moved to zero crossings)
+    int fixedStartPositionSample = 0;
+    int fixedEndPositionSample = 0;
+    int fixedLoopStartPositionSample = 0;
+    int fixedLoopEndPositionSample = 0;
+    
+    // Computed slices (moved to zero crossings, both vectors have the same length)
+    std::vector<int> sliceStartSamples = {};
+    std::vector<int> sliceEndSamples = {};
+    
+    // Time at which the table was replaced by a newer one (used for deferred deletion)
+    double retiredAtTime = 0.0;
+    
+    bool wasComputedWithSameParametersAs (const SliceTable& other) const noexcept
+    {
+        return startPositionSample == other.startPositionSample
+            && endPositionSample == other.endPositionSample
+            && loopStartPositionSample == other.loopStartPositionSample
+            && loopEndPositionSample == other.loopEndPositionSample
+            && numSlices == other.numSlices
+            && numMappedMidiNotes == other.numMappedMidiNotes
+            && lengthInSamples == other.lengthInSamples
+            && onsetTimesVersion == other.onsetTimesVersion
+            && zeroCrossingsVersion == other.zeroCrossingsVersion;
+    }
+    
+    void getSliceStartAndEnd (int noteIndex, int& sliceStart, int& sliceEnd) const noexcept
+    {
+        int nSlices = (int)sliceStartSamples.size();
+        if (nSlices == 0){
+            // If there are no slices (e.g. no onsets detected), the whole start/end region is used
+            sliceStart = fixedStartPositionSample;
+            sliceEnd = fixedEndPositionSample;
+            return;
+        }
+        int currentSlice = noteIndex % nSlices;
+        sliceStart = sliceStartSamples[currentSlice];
+        sliceEnd = sliceEndSamples[currentSlice];
+    }
+};
+
+
 class SourceSamplerSound: public juce::SynthesiserSound, juce::Timer
 {
 public:
@@ -42,7 +108,8 @@ public:
                         juce::AudioFormatReader& source,
                         double maxSampleLengthSeconds,
                         double _pluginSampleRate,
-                        int _pluginBlockSize);
+                        int _pluginBlockSize,
+                        bool _isProvisional = false);
     
     ~SourceSamplerSound() override;
     
@@ -68,10 +135,10 @@ public:
     float getCorrectedVelocity(float midiVelocity);
     
     //==============================================================================
-    float getParameterFloat(juce::Identifier identifier);
-    float gpf(juce::Identifier identifier) { return getParameterFloat(identifier);};
-    int getParameterInt(juce::Identifier identifier);
-    float gpi(juce::Identifier identifier) { return getParameterInt(identifier);};
+    float getParameterFloat(ParamId paramId);
+    float gpf(ParamId paramId) { return getParameterFloat(paramId);};
+    int getParameterInt(ParamId paramId);
+    float gpi(ParamId paramId) { return getParameterInt(paramId);};
     
     //==============================================================================
     void setSampleStartEndAndLoopPositions(float start, float end, float loopStart, float loopEnd);
@@ -81,11 +148,13 @@ public:
     int getLengthInSamples();
     float getLengthInSeconds();
     float getPlayingPositionPercentage();
+    size_t getMemorySizeBytes();
     
     //==============================================================================
     int getNumberOfMappedMidiNotes();
     juce::BigInteger getMappedMidiNotes();
     void setMappedMidiNotes(juce::BigInteger newMappedMidiNotes);
+    int getMidiNoteIndex(int midiNote) const noexcept { return midiNoteIndexes[juce::jlimit(0, 127, midiNote)].load(std::memory_order_relaxed); };
     int getMidiRootNote();
     void setMidiRootNote(int newRootNote);
     int getMidiVelocityLayer();
@@ -96,10 +165,19 @@ public:
     void setOnsetTimesSamples(std::vector<float> _onsetTimes);
     std::vector<int> getOnsetTimesSamples();
     
+    //==============================================================================
+    const SliceTable* getSliceTable() const noexcept { return sliceTable.load(); }
+    void updateSliceTableIfNeeded();
+    
+    //==============================================================================
+    void computeZeroCrossings();
+    int findNearestPositiveZeroCrossing(int position, int maxSamplesSearch);
+    
     //==============================================================================
     bool isScheduledForDeletion();
     void scheduleSampleSoundDeletion();
     bool shouldBeDeleted();
+    bool isProvisional() const noexcept { return provisional; };
     
     //==============================================================================
     void preProcessAudioWithStretch();
@@ -138,13 +216,23 @@ private:
     std::unique_ptr<juce::AudioBuffer<float>> data;
     std::unique_ptr<juce::AudioBuffer<float>> stretchProcessedData;  // used for storing pre-processed pitch shifted/time stretched versions of the audio
     int lengthInSamples = 0;
+    bool provisional = false;  // Created from a partially downloaded file, will be replaced once the download finishes
     double soundSampleRate;
     double pluginSampleRate;
     int pluginBlockSize;
     std::vector<int> onsetTimesSamples = {};
+    int onsetTimesVersion = 0;  // Incremented every time onsets change so the slice table is re-computed
     juce::BigInteger midiNotes = 0;
     juce::BigInteger midiVelocities = 0;
     
+    // Index of each MIDI note relative to the mapped notes (see computeMidiNoteIndex). This is pre-computed every time mapped
+    // notes change so voices can get note indexes without walking through the bits of midiNotes. Elements are atomic because
+    // the table is re-written from the message thread while voices read it from the audio thread (while it is being
+    // re-written, a voice can get the index of a note from the old or from the new mapping, but never a torn value)
+    int computeMidiNoteIndex(int midiNote);
+    std::array<std::atomic<int>, 128> midiNoteIndexes {};
+    int numberOfMappedMidiNotes = 0;
+    
     // 3rd party time stretcher/pitch shifter
     int maxTimeStretchRatio = 4; // Set a maximum time stretch ratio so we allocate enough samples for the processed buffer and don't do re-allocations in real time thread
     float timeStretchRatio = 1.0;
@@ -156,8 +244,22 @@ private:
     float nextTimeStretchRatio = 1.0;
     float nextPitchShiftSemitones = 0.0;
     
+    // Slices table (computed in message thread, read by the audio thread). Tables that get replaced are not
+    // deleted immediately but kept in retiredSliceTables for some time in case a voice is still reading them
+    SliceTable getSliceTableParameters();
+    void computeSlices(SliceTable& table);
+    std::unique_ptr<SliceTable> currentSliceTable;
+    std::atomic<SliceTable*> sliceTable { nullptr };
+    std::vector<std::unique_ptr<SliceTable>> retiredSliceTables;
+    
+    // Sorted positions of the positive zero crossings of the (stretched) audio, computed after each stretch
+    // processing and used to move loop/slice positions to zero crossings with a binary search
+    std::vector<int> zeroCrossings = {};
+    int zeroCrossingsVersion = 0;
+    juce::CriticalSection zeroCrossingsLock;
+    
     // we use these properties to specify when a sample sound will be deleted. Unlike SourceSound, we don't bind this to state
-    bool willBeDeleted = false;
+    std::atomic<bool> willBeDeleted { false };  // Read from the audio thread in appliesToNote
     double scheduledForDeletionTime = 0.0;
 
     
@@ -174,11 +276,31 @@ private:
 // or sounds sampled at different pitches.
 
 
-class SourceSound: public juce::URL::DownloadTask::Listener
+//==============================================================================
+// Table with the parameters modulated by each MIDI CC number. It is compiled in the message thread from the MIDI CC
+// mappings of a SourceSound so the audio thread does not need to walk through mappings, compare parameter names or
+// take locks when MIDI CC messages are received.
+
+struct MidiCCTable
+{
+    struct Entry
+    {
+        ParamId parameter;
+        float minValue;  // Parameter value when CC value is 0
+        float maxValue;  // Parameter value when CC value is 127
+    };
+    
+    std::array<std::vector<Entry>, 128> entriesForCcNumber;
+    double retiredAtTime = 0.0;
+};
+
+
+class SourceSound: public DownloadScheduler::Listener
 {
 public:
     SourceSound (const juce::ValueTree& _state,
-                 std::function<GlobalContextStruct()> globalContextGetter);
+                 std::function<GlobalContextStruct()> globalContextGetter,
+                 bool _addToSamplerWhenLoaded = true);
     ~SourceSound ();
     
     juce::ValueTree state;
@@ -189,17 +311,26 @@ public:
     SourceSamplerSound* getLinkedSourceSamplerSoundWithUUID(const juce::String& sourceSamplerSoundUUID);
     juce::String getUUID();
     bool isScheduledForDeletion();
-    void scheduleSoundDeletion();
+    void scheduleSoundDeletion(bool allowTailOff=false);
     bool shouldBeDeleted();
+    bool hasFinishedLoading();
+    double getFirstPlayableTimeMs() const { return firstPlayableTimeMs.load(); }  // 0.0 if no SourceSamplerSound was added to the sampler yet
     
     std::function<GlobalContextStruct()> getGlobalContext;
     
     // --------------------------------------------------------------------------------------------
     
+    size_t getMemorySizeBytes();
+    void addStagedSourceSamplerSoundsToSampler();
+    
+    // --------------------------------------------------------------------------------------------
+    
     int getParameterInt(juce::Identifier identifier);
     float getParameterFloat(juce::Identifier identifier, bool normed);
     void setParameterByNameFloat(juce::Identifier identifier, float value, bool normed);
     void setParameterByNameInt(juce::Identifier identifier, int value);
+    float getParameter(ParamId paramId);
+    void setParameter(ParamId paramId, float value);
     
     // ------------------------------------------------------------------------------------------------
     
@@ -217,9 +348,15 @@ public:
     // ------------------------------------------------------------------------------------------------
     
     void addOrEditMidiMapping(juce::String uuid, int ccNumber, juce::String parameterName, float minRange, float maxRange);
-    std::vector<MidiCCMapping*> getMidiMappingsForCcNumber(int ccNumber);
     void removeMidiMapping(juce::String uuid);
-    void applyMidiCCModulations(int channel, int number, int value);
+    void applyMidiCCModulations(int channel, int number, int value, int globalMidiInChannel);
+    void writeBackParameterChanges();
+    
+    // ------------------------------------------------------------------------------------------------
+    
+    static juce::String getAudioContentKey(const juce::ValueTree& soundState);
+    bool canBeUpdatedInPlaceFrom(const juce::ValueTree& newSoundState);
+    void updateInPlaceFrom(const juce::ValueTree& newSoundState);
     
     // ------------------------------------------------------------------------------------------------
     
@@ -239,9 +376,12 @@ public:
     bool fileAlreadyInDisk(juce::File locationInDisk);
     void downloadProgressUpdate(juce::File targetFileLocation, float percentageCompleted);
     void downloadFinished(juce::File targetFileLocation, bool taskSucceeded);
+    int getDownloadPriority();
+    void createProvisionalSourceSamplerSoundIfPossible(const juce::File& targetFileLocation, juce::int64 bytesDownloaded);
+    void removeProvisionalSourceSamplerSounds();
     
-    void progress (juce::URL::DownloadTask *task, juce::int64 bytesDownloaded, juce::int64 totalLength);
-    void finished(juce::URL::DownloadTask *task, bool success);
+    void scheduledDownloadProgress (const juce::File& targetFileLocation, juce::int64 bytesDownloaded, juce::int64 totalLength) override;
+    void scheduledDownloadFinished (const juce::File& targetFileLocation, bool success) override;
     
     //==============================================================================
     class SoundLoaderThread : public juce::Thread
@@ -265,50 +405,36 @@ private:
     
     juce::CachedValue<juce::String> midiNotesAsString;
     std::unique_ptr<MidiCCMappingList> midiCCmappings;
-
-    // --> Start auto-generated code A
-    juce::CachedValue<int> launchMode;
-    juce::CachedValue<float> startPosition;
-    juce::CachedValue<float> endPosition;
-    juce::CachedValue<float> loopStartPosition;
-    juce::CachedValue<float> loopEndPosition;
-    juce::CachedValue<int> loopXFadeNSamples;
-    juce::CachedValue<int> reverse;
-    juce::CachedValue<int> noteMappingMode;
-    juce::CachedValue<int> numSlices;
-    juce::CachedValue<float> playheadPosition;
-    juce::CachedValue<float> freezePlayheadSpeed;
-    juce::CachedValue<float> filterCutoff;
-    juce::CachedValue<float> filterRessonance;
-    juce::CachedValue<float> filterKeyboardTracking;
-    juce::CachedValue<float> filterAttack;
-    juce::CachedValue<float> filterDecay;
-    juce::CachedValue<float> filterSustain;
-    juce::CachedValue<float> filterRelease;
-    juce::CachedValue<float> filterADSR2CutoffAmt;
-    juce::CachedValue<float> gain;
-    juce::CachedValue<float> attack;
-    juce::CachedValue<float> decay;
-    juce::CachedValue<float> sustain;
-    juce::CachedValue<float> release;
-    juce::CachedValue<float> pan;
-    juce::CachedValue<float> pitch;
-    juce::CachedValue<float> pitchBendRangeUp;
-    juce::CachedValue<float> pitchBendRangeDown;
-    juce::CachedValue<float> mod2CutoffAmt;
-    juce::CachedValue<float> mod2GainAmt;
-    juce::CachedValue<float> mod2PitchAmt;
-    juce::CachedValue<float> mod2PlayheadPos;
-    juce::CachedValue<float> vel2CutoffAmt;
-    juce::CachedValue<float> vel2GainAmt;
-    juce::CachedValue<float> velSensitivity;
-    juce::CachedValue<int> midiChannel;
-    juce::CachedValue<float> pitchShift;
-    juce::CachedValue<float> timeStretch;
-    // --> End auto-generated code A
+    
+    // Compiled MIDI CC mappings (see MidiCCTable). Tables that get replaced are kept in retiredMidiCCTables for some time
+    // in case the audio thread is still reading them
+    void rebuildMidiCCTable();
+    void freeRetiredMidiCCTables();
+    std::unique_ptr<MidiCCTable> currentMidiCCTable;
+    std::atomic<MidiCCTable*> midiCCTable { nullptr };
+    std::vector<std::unique_ptr<MidiCCTable>> retiredMidiCCTables;
+    
+    // Sound parameters (see SoundParameterStore). Getters only read from the store's atomics so these are safe to call from the
+    // audio thread, the store takes care of mirroring changes to and from the state
+    void checkStartEndAndLoopPositions();
+    SoundParameterStore parameters;
+    
+    // Sounds which are part of a staged preset (see SourceSampler::stagePreset) are loaded as usual but their SourceSamplerSound(s)
+    // are kept here instead of being added to the sampler until the staged preset is swapped in
+    bool addToSamplerWhenLoaded = true;
+    std::vector<juce::SynthesiserSound::Ptr> stagedSourceSamplerSounds;
+    
+    // Number of downloaded bytes at which a provisional SourceSamplerSound will be created (or re-tried if decoding failed)
+    // for each sample (by UUID). Samples which already have a provisional sound are not in the map
+    std::map<juce::String, juce::int64> provisionalSoundNextAttemptBytes;
+    
+    // Time (as given by juce::Time::getMillisecondCounterHiRes) at which the first SourceSamplerSound of this sound (provisional
+    // or not) was added to the sampler, used to measure the latency of queries (see SourceSampler::reportQueryLatencyIfReady)
+    void setFirstPlayableTimeIfNotSet();
+    std::atomic<double> firstPlayableTimeMs { 0.0 };
     
     // Other
-    std::vector<std::unique_ptr<juce::URL::DownloadTask>> downloadTasks;
+    juce::SharedResourcePointer<DownloadScheduler> downloadScheduler;
     bool allDownloaded = false;
     double scheduledForDeletionTime = 0.0;
     std::function<bool()> shouldStopLoading;
@@ -321,10 +447,12 @@ private:
 struct SourceSoundList: public drow::ValueTreeObjectList<SourceSound>
 {
     SourceSoundList (const juce::ValueTree& v,
-                     std::function<GlobalContextStruct()> globalContextGetter)
+                     std::function<GlobalContextStruct()> globalContextGetter,
+                     bool _addSoundsToSamplerWhenLoaded = true)
     : drow::ValueTreeObjectList<SourceSound> (v)
     {
         getGlobalContext = globalContextGetter;
+        addSoundsToSamplerWhenLoaded = _addSoundsToSamplerWhenLoaded;
         rebuildObjects();
     }
 
@@ -340,7 +468,7 @@ struct SourceSoundList: public drow::ValueTreeObjectList<SourceSound>
 
     SourceSound* createNewObject (const juce::ValueTree& v) override
     {
-        return new SourceSound (v, getGlobalContext);
+        return new SourceSound (v, getGlobalContext, addSoundsToSamplerWhenLoaded);
     }
 
     void deleteObject (SourceSound* s) override
@@ -356,6 +484,35 @@ struct SourceSoundList: public drow::ValueTreeObjectList<SourceSound>
     void objectOrderChanged() override       {}
     
     std::function<GlobalContextStruct()> getGlobalContext;
+    bool addSoundsToSamplerWhenLoaded = true;  // false for lists of staged presets (see SourceSampler::stagePreset)
+    
+    bool allSoundsQueuedTheirDownloads() {
+        // Sound loader threads queue downloads and return (if all files are already in disk, these also create the
+        // SourceSamplerSounds before returning)
+        for (auto* sound: objects){
+            if (sound->soundLoaderThread.isThreadRunning()){
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    bool allSoundsFinishedLoading() {
+        for (auto* sound: objects){
+            if (!sound->hasFinishedLoading()){
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    size_t getMemorySizeBytes() {
+        size_t size = 0;
+        for (auto* sound: objects){
+            size += sound->getMemorySizeBytes();
+        }
+        return size;
+    }
     
     SourceSound* getSoundAt(int position) {
         if ((position >= 0) && (position < objects.size())){
@@ -15,24 +15,38 @@ SourceSamplerSynthesiser::SourceSamplerSynthesiser()
 {
     setSamplerVoices(maxNumVoices);
     
+    // MIDI events (including CC messages which modulate sound parameters) are applied at their sample position. The synthesiser
+    // splits rendering at event positions, and voices read sound parameters at the start of each sub-block
+    setMinimumRenderingSubdivisionSize(MIDI_EVENTS_MIN_RENDER_SUBDIVISION, true);
+    
+    #if PARALLEL_VOICE_RENDERING
+    renderWorkerPool = std::make_unique<VoiceRenderWorkerPool> (NUM_VOICE_RENDER_WORKERS);
+    #endif
+    
+    // By default everything is rendered to the main (stereo) output bus
+    outputBusesLayout[0] = { 0, 2 };
+    
     // Configure effects chain
-    juce::Reverb::Parameters reverbParameters;
-    reverbParameters.roomSize = 0.5f;
-    reverbParameters.damping = 0.5f;
-    reverbParameters.wetLevel = 0.0f;
-    reverbParameters.dryLevel = 1.0f;
-    reverbParameters.width = 1.0f;
-    reverbParameters.freezeMode = 0.0f;
-    auto& reverb = fxChain.get<reverbIndex>();
-    reverb.setParameters(reverbParameters);
+    juce::Reverb::Parameters defaultReverbParameters;
+    defaultReverbParameters.roomSize = 0.5f;
+    defaultReverbParameters.damping = 0.5f;
+    defaultReverbParameters.wetLevel = 0.0f;
+    defaultReverbParameters.dryLevel = 1.0f;
+    defaultReverbParameters.width = 1.0f;
+    defaultReverbParameters.freezeMode = 0.0f;
+    setReverbParameters(defaultReverbParameters);
+    lastDryGain = defaultReverbParameters.dryLevel * reverbDryScaleFactor;
 }
 
 void SourceSamplerSynthesiser::setSamplerVoices(int nVoices)
 {
     // Clear existing voices and re-create new ones
     clearVoices();
-    for (auto i = 0; i < juce::jmin(maxNumVoices, nVoices); ++i)
-        addVoice (new SourceSamplerVoice);
+    for (auto i = 0; i < juce::jmin(maxNumVoices, nVoices); ++i){
+        auto* voice = new SourceSamplerVoice;
+        voice->setOutputBusesLayout (&outputBusesLayout);
+        addVoice (voice);
+    }
     
     // Prepare newly created voices if processing specs are given (re-prepare voices)
     if (currentNumChannels > 0 ){
@@ -63,6 +77,22 @@ void SourceSamplerSynthesiser::prepare (const juce::dsp::ProcessSpec& spec) noex
         dynamic_cast<SourceSamplerVoice*> (v)->prepare (spec);
 
     fxChain.prepare (spec);
+    reverbSendBuffer.setSize ((int) spec.numChannels, (int) spec.maximumBlockSize);
+    reverbSendBuffer.clear();
+    reverbIsProcessing = false;
+    
+    #if PARALLEL_VOICE_RENDERING
+    // Allocate one output and reverb send buffer per worker with as many channels as all output buses together
+    int numOutputChannels = (int) spec.numChannels;
+    for (const auto& bus : outputBusesLayout)
+        numOutputChannels = juce::jmax (numOutputChannels, bus.firstChannel + bus.numChannels);
+    workerOutputBuffers.resize (NUM_VOICE_RENDER_WORKERS);
+    workerSendBuffers.resize (NUM_VOICE_RENDER_WORKERS);
+    for (int i = 0; i < NUM_VOICE_RENDER_WORKERS; i++){
+        workerOutputBuffers[i].setSize (numOutputChannels, (int) spec.maximumBlockSize);
+        workerSendBuffers[i].setSize ((int) spec.numChannels, (int) spec.maximumBlockSize);
+    }
+    #endif
 }
 
 //==============================================================================
@@ -137,30 +167,215 @@ void SourceSamplerSynthesiser::handleMidiEvent (const juce::MidiMessage& m)
         for (auto* s : sounds)
         {
             if (auto* sound = dynamic_cast<SourceSamplerSound*> (s)){
-                sound->getSourceSound()->applyMidiCCModulations(channel, number, value);
+                sound->getSourceSound()->applyMidiCCModulations(channel, number, value, globalMidiInChannel);
             }
         }
     }
     else if (m.isProgramChange())
     {
         int index = m.getProgramChangeNumber();  // Preset index, this is 0-based so MIDI value 0 will be also 0 here
-        juce::String actionMessage = juce::String(ACTION_LOAD_PRESET) + ":" + (juce::String)index;
+        juce::String actionMessage = juce::String(ACTION_LOAD_PRESET) + ":" + (juce::String)index + SERIALIZATION_SEPARATOR + "1";  // Second parameter tells the preset is loaded from a program change
         sendActionMessage(actionMessage);
     }
 }
 
 void SourceSamplerSynthesiser::renderVoices (juce::AudioBuffer< float > &outputAudio, int startSample, int numSamples)
 {
-    Synthesiser::renderVoices (outputAudio, startSample, numSamples);
-    auto block = juce::dsp::AudioBlock<float> (outputAudio);
-    auto blockToUse = block.getSubBlock ((size_t) startSample, (size_t) numSamples);
-    auto contextToUse = juce::dsp::ProcessContextReplacing<float> (blockToUse);
-    fxChain.process (contextToUse);
+    // The reverb is a send/return effect which is only processed when its wet level is not 0 and some voice sends to it (or
+    // the reverb tail has not yet decayed). In that case voices also add their output to reverbSendBuffer (scaled by their send
+    // level), otherwise they only render to their output bus
+    bool reverbCanBeActive = (reverbParameters.wetLevel > 0.0f) && (startSample + numSamples <= reverbSendBuffer.getNumSamples());
+    bool reverbHasInput = reverbCanBeActive && voicesSendToReverb();
+    if (reverbHasInput){
+        if (!reverbIsProcessing){
+            // Don't play old reverb tails when re-activating
+            fxChain.reset();
+            reverbIsProcessing = true;
+        }
+        reverbTailSilentSamples = 0;
+    }
+    bool reverbIsActive = reverbCanBeActive && reverbIsProcessing;
+    if (!reverbCanBeActive){
+        reverbIsProcessing = false;
+    }
+    if (reverbIsActive){
+        for (int channel = 0; channel < reverbSendBuffer.getNumChannels(); channel++)
+            reverbSendBuffer.clear (channel, startSample, numSamples);
+    }
+    for (auto* voice : voices)
+        static_cast<SourceSamplerVoice*> (voice)->setReverbSendBuffer (reverbIsActive ? &reverbSendBuffer : nullptr);
+    
+    // Before rendering, stop voices that are no longer audible so these are not rendered at all
+    for (auto* voice : voices)
+        static_cast<SourceSamplerVoice*> (voice)->stopIfEnvelopeIsSilent();
+    
+    numActiveVoices = 0;
+    int numVoicesToRender = juce::jmin (voices.size(), maxNumVoices);
+    for (int i = 0; i < numVoicesToRender; i++){
+        auto* voice = static_cast<SourceSamplerVoice*> (voices.getUnchecked (i));
+        if (voice->getCurrentlyPlayingSourceSamplerSound() != nullptr)
+            activeVoices[numActiveVoices++] = voice;
+    }
+    
+    if (!renderActiveVoicesInParallel (outputAudio, startSample, numSamples, reverbIsActive)){
+        for (int i = 0; i < numActiveVoices; i++)
+            activeVoices[i]->renderNextBlock (outputAudio, startSample, numSamples);
+    }
+    
+    // If for some reason there are more voices than maxNumVoices, render them as usual
+    for (int i = numVoicesToRender; i < voices.size(); i++){
+        voices.getUnchecked (i)->renderNextBlock (outputAudio, startSample, numSamples);
+    }
+    
+    // Apply the dry level to all output channels (only if it is not unity gain)
+    float dryGain = reverbParameters.dryLevel * reverbDryScaleFactor;
+    if ((dryGain != 1.0f) || (lastDryGain != 1.0f)){
+        for (int channel = 0; channel < outputAudio.getNumChannels(); channel++)
+            outputAudio.applyGainRamp (channel, startSample, numSamples, lastDryGain, dryGain);
+    }
+    lastDryGain = dryGain;
+    
+    // Process reverb send and add the return to the main output bus
+    if (reverbIsActive){
+        auto sendBlock = juce::dsp::AudioBlock<float> (reverbSendBuffer).getSubBlock ((size_t) startSample, (size_t) numSamples);
+        auto contextToUse = juce::dsp::ProcessContextReplacing<float> (sendBlock);
+        fxChain.process (contextToUse);
+        
+        const auto& mainBus = outputBusesLayout[0];
+        int numMainBusChannels = juce::jmin (mainBus.numChannels, outputAudio.getNumChannels() - mainBus.firstChannel);
+        if (numMainBusChannels > 0){
+            juce::dsp::AudioBlock<float> (outputAudio)
+                .getSubsetChannelBlock ((size_t) mainBus.firstChannel, (size_t) numMainBusChannels)
+                .getSubBlock ((size_t) startSample, (size_t) numSamples)
+                .add (sendBlock);
+        }
+        
+        // If no voice sent to the reverb, check if the tail has decayed and stop processing it if that is the case
+        if (!reverbHasInput){
+            float returnMagnitude = 0.0f;
+            for (int channel = 0; channel < reverbSendBuffer.getNumChannels(); channel++)
+                returnMagnitude = juce::jmax (returnMagnitude, reverbSendBuffer.getMagnitude (channel, startSample, numSamples));
+            if (returnMagnitude < juce::Decibels::decibelsToGain ((float)REVERB_TAIL_SILENCE_THRESHOLD_DB)){
+                reverbTailSilentSamples += numSamples;
+                if (reverbTailSilentSamples >= (int)(REVERB_TAIL_SILENCE_HOLD_MS * 0.001 * getSampleRate())){
+                    reverbIsProcessing = false;
+                }
+            } else {
+                reverbTailSilentSamples = 0;
+            }
+        }
+    }
+}
+
+bool SourceSamplerSynthesiser::renderActiveVoicesInParallel (juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples, bool reverbIsActive)
+{
+    // Render active voices using the worker pool. The audio thread renders its voices directly to the output and each worker
+    // accumulates the voices it renders in its own output (and reverb send) buffers, which are then added to the output in
+    // worker order. Returns false if voices should be rendered in the audio thread instead (not worth it, buffers don't
+    // match the output or workers were recently late).
+    if (renderWorkerPool == nullptr || numActiveVoices < 2 || numSamples < VOICE_RENDER_PARALLEL_MIN_NUM_SAMPLES)
+        return false;
+    if (parallelRenderingFallbackBlocks > 0){
+        parallelRenderingFallbackBlocks--;
+        return false;
+    }
+    if ((workerOutputBuffers.size() < (size_t) renderWorkerPool->getNumParticipants() - 1)
+        || (workerOutputBuffers[0].getNumChannels() != outputAudio.getNumChannels())
+        || (startSample + numSamples > workerOutputBuffers[0].getNumSamples()))
+        return false;
+    
+    participantRenderedVoices.fill (false);
+    currentRenderOutput = &outputAudio;
+    currentRenderStartSample = startSample;
+    currentRenderNumSamples = numSamples;
+    currentRenderReverbIsActive = reverbIsActive;
+    double expectedFinishMs = juce::Time::getMillisecondCounterHiRes() + 1000.0 * VOICE_RENDER_LATE_WORKERS_FRACTION * numSamples / getSampleRate();
+    if (!renderWorkerPool->run (*this, numActiveVoices, expectedFinishMs)){
+        // Some worker was too slow (e.g. preempted), render in the audio thread only for a while
+        parallelRenderingFallbackBlocks = VOICE_RENDER_FALLBACK_NUM_BLOCKS;
+    }
+    
+    // Add the buffers of the workers which rendered some voice (always in the same order)
+    for (int worker = 0; worker < renderWorkerPool->getNumParticipants() - 1; worker++){
+        if (!participantRenderedVoices[worker + 1])
+            continue;
+        for (int channel = 0; channel < outputAudio.getNumChannels(); channel++)
+            outputAudio.addFrom (channel, startSample, workerOutputBuffers[worker], channel, startSample, numSamples);
+        if (reverbIsActive){
+            for (int channel = 0; channel < reverbSendBuffer.getNumChannels(); channel++)
+                reverbSendBuffer.addFrom (channel, startSample, workerSendBuffers[worker], channel, startSample, numSamples);
+        }
+    }
+    return true;
+}
+
+void SourceSamplerSynthesiser::runTask (int taskIndex, int participantIndex)
+{
+    // Called from the worker threads (and audio thread, participant 0) to render one voice. The audio thread renders to
+    // the output, workers to their own buffers (which are cleared before rendering their first voice of the sub-block)
+    auto* voice = activeVoices[taskIndex];
+    if (participantIndex == 0){
+        voice->renderNextBlock (*currentRenderOutput, currentRenderStartSample, currentRenderNumSamples);
+        return;
+    }
+    auto& workerOutput = workerOutputBuffers[(size_t) participantIndex - 1];
+    auto& workerSend = workerSendBuffers[(size_t) participantIndex - 1];
+    if (!participantRenderedVoices[(size_t) participantIndex]){
+        for (int channel = 0; channel < workerOutput.getNumChannels(); channel++)
+            workerOutput.clear (channel, currentRenderStartSample, currentRenderNumSamples);
+        if (currentRenderReverbIsActive){
+            for (int channel = 0; channel < workerSend.getNumChannels(); channel++)
+                workerSend.clear (channel, currentRenderStartSample, currentRenderNumSamples);
+        }
+        participantRenderedVoices[(size_t) participantIndex] = true;
+    }
+    if (currentRenderReverbIsActive)
+        voice->setReverbSendBuffer (&workerSend);
+    voice->renderNextBlock (workerOutput, currentRenderStartSample, currentRenderNumSamples);
+}
+
+bool SourceSamplerSynthesiser::voicesSendToReverb()
+{
+    // Returns true if any of the active voices has a send level greater than 0
+    for (auto* voice : voices){
+        auto* samplerVoice = static_cast<SourceSamplerVoice*> (voice);
+        if (samplerVoice->isVoiceActive() && (samplerVoice->getReverbSendGain() > 0.0f))
+            return true;
+    }
+    return false;
+}
+
+//==============================================================================
+
+int SourceSamplerSynthesiser::getNumSkippedVoiceBlocks()
+{
+    // Number of voice-blocks that were skipped because voices were not audible since the last call (used for stats). A
+    // voice-block is skipped either when the voice is stopped because it fell below VOICE_SILENCE_THRESHOLD_DB or when its
+    // envelope stayed below that threshold during the whole block (filter, gain and mixing are not processed)
+    int numSkippedVoiceBlocks = 0;
+    for (auto* voice : voices)
+        numSkippedVoiceBlocks += static_cast<SourceSamplerVoice*> (voice)->getNumSkippedBlocks();
+    return numSkippedVoiceBlocks;
 }
 
 //==============================================================================
 
 void SourceSamplerSynthesiser::setReverbParameters (juce::Reverb::Parameters params) {
+    const juce::ScopedLock sl (lock);
+    reverbParameters = params;
+    
+    // The reverb only processes the send bus, so it is configured as 100% wet. Dry level is applied in renderVoices
+    juce::Reverb::Parameters sendReverbParameters = params;
+    sendReverbParameters.dryLevel = 0.0f;
     auto& reverb = fxChain.get<reverbIndex>();
-    reverb.setParameters(params);
+    reverb.setParameters(sendReverbParameters);
+}
+
+void SourceSamplerSynthesiser::setGlobalMidiInChannel (int channel) {
+    globalMidiInChannel = channel;
+}
+
+void SourceSamplerSynthesiser::setOutputBusesLayout (const OutputBusesLayout& layout) {
+    const juce::ScopedLock sl (lock);
+    outputBusesLayout = layout;
 }
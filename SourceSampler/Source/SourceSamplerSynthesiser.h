@@ -14,11 +14,13 @@
 #include "helpers_source.h"
 #include "SourceSamplerVoice.h"
 #include "SourceSamplerSound.h"
+#include "VoiceRenderWorkerPool.h"
 
 
 
 class SourceSamplerSynthesiser: public juce::Synthesiser,
-                                public juce::ActionBroadcaster
+                                public juce::ActionBroadcaster,
+                                private VoiceRenderWorkerPool::Task
 {
 public:
     SourceSamplerSynthesiser();
@@ -33,8 +35,13 @@ public:
                  const float velocity) override;
     void handleMidiEvent (const juce::MidiMessage& m) override;
     
+    //==============================================================================
+    int getNumSkippedVoiceBlocks();
+    
     //==============================================================================
     void setReverbParameters (juce::Reverb::Parameters params);
+    void setOutputBusesLayout (const OutputBusesLayout& layout);
+    void setGlobalMidiInChannel (int channel);
     
 private:
     //==============================================================================
@@ -44,7 +51,42 @@ private:
         reverbIndex
     };
     int lastModWheelValue = 0;
+    int globalMidiInChannel = 0;  // Updated by SourceSampler at every block, used to check which sounds get MIDI CC modulations
     int currentNumChannels = 0;
     int currentBlockSize = 0;
+    
+    //==============================================================================
+    // Voices which are playing a sound in the current block (rendered in this order)
+    std::array<SourceSamplerVoice*, maxNumVoices> activeVoices;
+    int numActiveVoices = 0;
+    
+    // Parallel rendering of active voices (worker pool is only created if PARALLEL_VOICE_RENDERING is enabled). The audio
+    // thread renders its voices directly to the output, each worker accumulates its voices in its own output and reverb
+    // send buffers
+    std::unique_ptr<VoiceRenderWorkerPool> renderWorkerPool;
+    std::vector<juce::AudioBuffer<float>> workerOutputBuffers;
+    std::vector<juce::AudioBuffer<float>> workerSendBuffers;
+    std::array<bool, NUM_VOICE_RENDER_WORKERS + 1> participantRenderedVoices;
+    juce::AudioBuffer<float>* currentRenderOutput = nullptr;
+    int currentRenderStartSample = 0;
+    int currentRenderNumSamples = 0;
+    bool currentRenderReverbIsActive = false;
+    int parallelRenderingFallbackBlocks = 0;
+    bool renderActiveVoicesInParallel (juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples, bool reverbIsActive);
+    void runTask (int taskIndex, int participantIndex) override;
+    
+    //==============================================================================
+    // Output buses and reverb send/return. Voices add their output directly to the channels of their output bus and,
+    // if the reverb is active, to reverbSendBuffer. The reverb only processes reverbSendBuffer (100% wet) and its
+    // output is added to the main output bus. The dry level of the reverb parameters is applied as a gain to all buses.
+    // The reverb is bypassed when wet level is 0 or when no voice sends to it and its tail has decayed.
+    OutputBusesLayout outputBusesLayout;
+    juce::AudioBuffer<float> reverbSendBuffer;
+    juce::Reverb::Parameters reverbParameters;
+    bool reverbIsProcessing = false;  // True while some voice sends to the reverb or its tail has not yet decayed
+    int reverbTailSilentSamples = 0;  // Number of consecutive samples in which reverb output has been silent with no voices sending to it
+    bool voicesSendToReverb();
+    float lastDryGain = 1.0f;
+    static constexpr float reverbDryScaleFactor = 2.0f;  // Same scaling juce::Reverb applies to the dry level, so presets sound as when the reverb was an insert effect
     juce::dsp::ProcessorChain<juce::dsp::Reverb> fxChain;
 };
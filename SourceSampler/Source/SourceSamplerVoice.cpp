@@ -31,60 +31,15 @@ bool SourceSamplerVoice::canPlaySound (juce::SynthesiserSound* sound)
 
 int SourceSamplerVoice::getNoteIndex(int midiNote)
 {
-    /* This function compares the MIDI note passed as parameter and the list of midi notes assigned to the
-     sound and returns the "index" of the note passed as parameter. For example, if the first MIDI note
-     assigned to the sound is C3 and the passed note is also C3, this function returns 0. If sound
-     is assigned notes C3, C#3 and D3 and the passed note is C5, this function returns 2. If no notes
-     are assigned to the sound or no sound is being played, this function returns 0 (this function will not be
-     called in these cases anyway). If there are note discontinuities in the mapping, the discontinuities are
-     not counted (e.g. if a sound is assigned notes [C3, C#3, E3] and the note being played is E3, this function
-     will return 2. If the note being passed is not one of the assigned notes, returns the closest one.
-          */
+    // Returns the "index" of the given MIDI note relative to the notes mapped to the sound being played (see
+    // SourceSamplerSound::computeMidiNoteIndex). Indexes are pre-computed when the mapped notes change
     if (auto* sound = getCurrentlyPlayingSourceSamplerSound())
     {
-        if (sound->getNumberOfMappedMidiNotes() > 0){
-            juce::BigInteger mappedMidiNotes = sound->getMappedMidiNotes();
-            int noteIndex = 0;
-            int closestNoteIndex = 0;
-            int minDistanceWithNote = 1000;
-            int i = 0;
-            while (true) {
-                int nextMappedNote = mappedMidiNotes.findNextSetBit(i);
-                if (nextMappedNote == midiNote){
-                    return noteIndex;
-                } else if (nextMappedNote == -1){
-                    break;
-                }
-                noteIndex += 1;
-                int distanceWithNote = std::abs(noteIndex - midiNote);
-                if (distanceWithNote <= minDistanceWithNote){
-                    closestNoteIndex = noteIndex;
-                    minDistanceWithNote = distanceWithNote;
-                }
-                i = nextMappedNote + 1;
-            }
-            return closestNoteIndex;
-        }
+        return sound->getMidiNoteIndex(midiNote);
     }
     return 0;
 }
 
-int findNearestPositiveZeroCrossing (int position, const float* const signal, int maxSamplesSearch)
-{
-    int initialPosition = position;
-    int endPosition = position + maxSamplesSearch;
-    if (maxSamplesSearch < 0){
-        initialPosition = position + maxSamplesSearch;  // maxSamplesSearch is negative!
-        endPosition = position;
-    }
-    for (int i=initialPosition; i<endPosition; i++){
-        if ((signal[i] < 0) && (signal[i+1] >= 0)){
-            return i;
-        }
-    }
-    return position;  // If none found, return original
-}
-
 void SourceSamplerVoice::startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound* s, int /*currentPitchWheelPosition*/)
 {
     currentNoteVelocity = velocity;
@@ -101,7 +56,9 @@ void SourceSamplerVoice::startNote (int midiNoteNumber, float velocity, juce::Sy
             pluginSampleRate = 48000.0;
         }
         
-        // Reset processor chain internal state
+        // Reset filter and processor chain internal state
+        filter.reset();
+        numSamplesUntilNextFilterControlPoint = 0;
         processorChain.reset();
         auto& gain = processorChain.get<masterGainIndex>();
         gain.setRampDurationSeconds(sound->pluginBlockSize/pluginSampleRate);
@@ -109,28 +66,33 @@ void SourceSamplerVoice::startNote (int midiNoteNumber, float velocity, juce::Sy
         // Reset some parameters
         adsr.reset();
         adsrFilter.reset();
+        lastEnvelopeValue = 0.0f;
+        envelopeIsDecaying = false;
         pitchModSemitones = 0.0;
         pitchBendModSemitones = 0.0;
         filterCutoffMod = 0.0;
         gainMod = 0.0;
         
         // Compute index of the currently played note
-        currentlyPlayedNoteIndex = getNoteIndex(getCurrentlyPlayingNote());
+        currentlyPlayedNoteIndex = sound->getMidiNoteIndex(midiNoteNumber);
         
         // Load and configure parameters from SourceSamplerSound
         adsr.setSampleRate (pluginSampleRate);
-        // TODO: what should really be the sample rate below?
-        adsrFilter.setSampleRate (sound->soundSampleRate/sound->pluginBlockSize); // Lower sample rate because we only update filter cutoff once per processing block...
+        adsrFilter.setSampleRate (pluginSampleRate/FILTER_MODULATION_CONTROL_RATE); // Lower sample rate because we only update filter cutoff once every FILTER_MODULATION_CONTROL_RATE samples
        
+        // Output bus is only set when the note starts so a voice always renders to the same bus (avoids clicks and makes
+        // it safe to render voices in parallel, see SourceSamplerSynthesiser::runTask)
+        outputBus = (int)sound->gpi(ParamId::outputBus);
+        
         // Update the rest of parameters (that will be udpated at each block)
         updateParametersFromSourceSamplerSound(sound);
         
-        if (sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_FREEZE){
+        if (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_FREEZE){
             // In freeze mode, playheadSamplePosition depends on the playheadPosition parameter
-            playheadSamplePosition = sound->gpf(SourceIDs::playheadPosition) * sound->getLengthInSamples();
+            playheadSamplePosition = sound->gpf(ParamId::playheadPosition) * sound->getLengthInSamples();
         } else {
             // Set initial playhead position according to start/end times
-            if (sound->gpi(SourceIDs::reverse) == 0){
+            if (sound->gpi(ParamId::reverse) == 0){
                 playheadSamplePosition = startPositionSample;
                 playheadDirectionIsForward = true;
             } else {
@@ -153,14 +115,14 @@ void SourceSamplerVoice::updateParametersFromSourceSamplerSound(SourceSamplerSou
 {
     // This is called at each processing block of 64 samples
     
-    if (sound->getParameterInt("launchMode") == LAUNCH_MODE_FREEZE){
+    if (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_FREEZE){
         // If in freeze mode, we "only" care about the playhead position parameter, the rest of parameters to define pitch, start/end times, etc., are not relevant
-        targetPlayheadSamplePosition = (sound->gpf(SourceIDs::playheadPosition) + playheadSamplePositionMod + currentModWheelValue/127.0) * sound->getLengthInSamples();
+        targetPlayheadSamplePosition = (sound->gpf(ParamId::playheadPosition) + playheadSamplePositionMod + currentModWheelValue/127.0) * sound->getLengthInSamples();
         
     } else {
         // Pitch
         int currenltlyPlayingNote = 0;
-        if ((sound->gpi(SourceIDs::noteMappingMode) == NOTE_MAPPING_MODE_PITCH) || (sound->gpi(SourceIDs::noteMappingMode) == NOTE_MAPPING_MODE_BOTH)){
+        if ((sound->gpi(ParamId::noteMappingMode) == NOTE_MAPPING_MODE_PITCH) || (sound->gpi(ParamId::noteMappingMode) == NOTE_MAPPING_MODE_BOTH)){
             currenltlyPlayingNote = getCurrentlyPlayingNote();
         } else {
             // If note mapping by pitch is not enabled, compute pitchRatio pretending the currently playing note is the same as the root note configured for that sound. In this way, pitch will not be modified depending on the played notes (but pitch bends and other modulations will still affect)
@@ -173,136 +135,73 @@ void SourceSamplerVoice::updateParametersFromSourceSamplerSound(SourceSamplerSou
         // a region is left empty, and then a new region of assigned notes is added. That second region will play notes
         // unintuitively because the notes in the "blank" region in the middle won't be counted
         // If this behaviour becomes a problem it could be turned into a sound parameter
-        int distanceToRootNote = getNoteIndex(currenltlyPlayingNote) - getNoteIndex(sound->getMidiRootNote());
-        double currentNoteFrequency = std::pow (2.0, (sound->gpf(SourceIDs::pitch) + distanceToRootNote) / 12.0);
+        int distanceToRootNote = sound->getMidiNoteIndex(currenltlyPlayingNote) - sound->getMidiNoteIndex(sound->getMidiRootNote());
+        double currentNoteFrequency = std::pow (2.0, (sound->gpf(ParamId::pitch) + distanceToRootNote) / 12.0);
         pitchRatio = currentNoteFrequency * sound->soundSampleRate / sound->pluginSampleRate;
         
-        // Set start/end and loop start/end settings
-        int soundLoopStartPosition, soundLoopEndPosition;  // To be set later
+        // Set start/end and loop start/end settings. Loop positions and slice boundaries are pre-computed in the message thread (see
+        // SliceTable) and are already moved to the nearest positive zero crossings, so here we only need to look them up
         int soundLengthInSamples = sound->getLengthInSamples();
-        if ((sound->gpi(SourceIDs::noteMappingMode) == NOTE_MAPPING_MODE_SLICE) || (sound->gpi(SourceIDs::noteMappingMode) == NOTE_MAPPING_MODE_BOTH)){
+        const SliceTable* positions = sound->getSliceTable();
+        if ((sound->gpi(ParamId::noteMappingMode) == NOTE_MAPPING_MODE_SLICE) || (sound->gpi(ParamId::noteMappingMode) == NOTE_MAPPING_MODE_BOTH)){
             // If note mapping by slice is enabled, we find the start/end positions corresponding to the current slice and set them to these
             // Also, loop start/end positions are ignored and set to the same slice start/end positions
-            int globalStartPositionSample = (int)(sound->gpf(SourceIDs::startPosition) * soundLengthInSamples);
-            int globalEndPositionSample = (int)(sound->gpf(SourceIDs::endPosition) * soundLengthInSamples);
-            int startToEndSoundLength = globalEndPositionSample - globalStartPositionSample;
-            if (sound->gpi(SourceIDs::numSlices) != SLICE_MODE_AUTO_ONSETS){
-                // if not in slice by onsets mode, divide the sound in N equal slices
-                int nSlices;
-                if (sound->gpi(SourceIDs::numSlices) == SLICE_MODE_AUTO_NNOTES){
-                    // If in auto-nnotes mode choose the number of slices automatically to be the same of the number of notes mapped to this sound
-                    nSlices = sound->getNumberOfMappedMidiNotes();
-                } else {
-                    // Othwise, assign the selected number of slices directly
-                    nSlices = sound->gpi(SourceIDs::numSlices);
-                }
-                float sliceLength = startToEndSoundLength / nSlices;
-                int currentSlice = currentlyPlayedNoteIndex % nSlices;
-                startPositionSample = globalStartPositionSample + currentSlice * sliceLength;
-                endPositionSample = globalStartPositionSample + (currentSlice + 1) * sliceLength;
-                
+            if (positions != nullptr){
+                positions->getSliceStartAndEnd(currentlyPlayedNoteIndex, startPositionSample, endPositionSample);
             } else {
-                // If in onsets mode, get the slices from the onsets analysis. Only consider those onsets inside the global start/end selection
-                int globalStartPositionSample = (int)(sound->gpf(SourceIDs::startPosition) * soundLengthInSamples);
-                int globalEndPositionSample = (int)(sound->gpf(SourceIDs::endPosition) * soundLengthInSamples);
-                std::vector<int> onsetTimesSamples = sound->getOnsetTimesSamples();
-                if (onsetTimesSamples.size() > 0){
-                    // If onset data is available, use the onsets :)
-                    std::vector<int> validOnsetTimesSamples = {};
-                    for (int i=0; i<onsetTimesSamples.size(); i++){
-                        if ((onsetTimesSamples[i] >= globalStartPositionSample) && (onsetTimesSamples[i] <= globalEndPositionSample)){
-                            validOnsetTimesSamples.push_back(onsetTimesSamples[i]);
-                        }
-                    }
-                    int nSlices = (int)validOnsetTimesSamples.size();
-                    int currentSlice = currentlyPlayedNoteIndex % nSlices;
-                    startPositionSample = validOnsetTimesSamples[currentSlice];
-                    if (currentSlice < nSlices - 1){
-                        endPositionSample = validOnsetTimesSamples[currentSlice + 1];
-                    } else {
-                        endPositionSample = globalEndPositionSample;
-                    }
-                    
-                } else {
-                    // If no onset data is available, use all sound
-                    startPositionSample = globalStartPositionSample;
-                    endPositionSample = globalEndPositionSample;
-                }
+                startPositionSample = (int)(sound->gpf(ParamId::startPosition) * soundLengthInSamples);
+                endPositionSample = (int)(sound->gpf(ParamId::endPosition) * soundLengthInSamples);
             }
-            soundLoopStartPosition = startPositionSample;
-            soundLoopEndPosition = endPositionSample;
+            fixedLoopStartPositionSample = startPositionSample;
+            fixedLoopEndPositionSample = endPositionSample;
         } else {
             // If note mapping by slice is not enabled, then all mappend notes start at the same start/end position as defined by the start/end position slider(s)
             // Also, the loop positions are defined following the sliders
-            startPositionSample = (int)(sound->gpf(SourceIDs::startPosition) * soundLengthInSamples);
-            endPositionSample = (int)(sound->gpf(SourceIDs::endPosition) * soundLengthInSamples);
-            soundLoopStartPosition = (int)(sound->gpf(SourceIDs::loopStartPosition) * soundLengthInSamples);
-            soundLoopEndPosition = (int)(sound->gpf(SourceIDs::loopEndPosition) * soundLengthInSamples);
-        }
-        
-        // Find fixed looping points (at zero-crossings)
-        if ((soundLoopStartPosition != loopStartPositionSample) || (soundLoopEndPosition != loopEndPositionSample)){
-            // Either loop start or end has changed in the sound object
-            auto& data = *sound->data;
-            const float* const signal = data.getReadPointer (0);  // use first audio channel to detect 0 crossing
-            if (soundLoopStartPosition != loopStartPositionSample){
-                // If the loop start position has changed, process it to move it to the next positive zero crossing
-                fixedLoopStartPositionSample = findNearestPositiveZeroCrossing(soundLoopStartPosition, signal, 2000);
-                //DBG("Fixed start sample position by " << fixedLoopStartPositionSample - soundLoopStartPosition);
-            }
-            if (soundLoopEndPosition != loopEndPositionSample){
-                // If the loop end position has changed, process it to move it to the next positive zero crossing
-                fixedLoopEndPositionSample = findNearestPositiveZeroCrossing(soundLoopEndPosition, signal, -2000);
-                //DBG("Fixed end sample position by " << fixedLoopEndPositionSample - soundLoopEndPosition);
+            startPositionSample = (int)(sound->gpf(ParamId::startPosition) * soundLengthInSamples);
+            endPositionSample = (int)(sound->gpf(ParamId::endPosition) * soundLengthInSamples);
+            if (positions != nullptr){
+                fixedLoopStartPositionSample = positions->fixedLoopStartPositionSample;
+                fixedLoopEndPositionSample = positions->fixedLoopEndPositionSample;
+            } else {
+                fixedLoopStartPositionSample = (int)(sound->gpf(ParamId::loopStartPosition) * soundLengthInSamples);
+                fixedLoopEndPositionSample = (int)(sound->gpf(ParamId::loopEndPosition) * soundLengthInSamples);
             }
         }
-        loopStartPositionSample = soundLoopStartPosition;
-        loopEndPositionSample = soundLoopEndPosition;
-
-        if ((sound->gpi(SourceIDs::noteMappingMode) == NOTE_MAPPING_MODE_SLICE) || (sound->gpi(SourceIDs::noteMappingMode) == NOTE_MAPPING_MODE_BOTH)){
-            // If in some slicing mode, because start/end position and loop start/end positions are the same, now that we have "fixed" the
-            // loop start/end position to the nearest zero crossing, do the same for the slice start/end so we avoid clicks at start and
-            // end of slices
-            startPositionSample = loopStartPositionSample;
-            endPositionSample = loopEndPositionSample;
-        }
     }
     
     // ADSRs
-    juce::ADSR::Parameters ampADSRParams = {sound->gpf(SourceIDs::attack), sound->gpf(SourceIDs::decay), sound->gpf(SourceIDs::sustain), sound->gpf(SourceIDs::release)};
+    juce::ADSR::Parameters ampADSRParams = {sound->gpf(ParamId::attack), sound->gpf(ParamId::decay), sound->gpf(ParamId::sustain), sound->gpf(ParamId::release)};
     adsr.setParameters (ampADSRParams);
-    juce::ADSR::Parameters filterADSRParams = {sound->gpf(SourceIDs::filterAttack), sound->gpf(SourceIDs::filterDecay), sound->gpf(SourceIDs::filterSustain), sound->gpf(SourceIDs::filterRelease)};
+    juce::ADSR::Parameters filterADSRParams = {sound->gpf(ParamId::filterAttack), sound->gpf(ParamId::filterDecay), sound->gpf(ParamId::filterSustain), sound->gpf(ParamId::filterRelease)};
     adsrFilter.setParameters (filterADSRParams);
     
     // Filter
     
     // Compute velocity modulations (only relevant at start of note)
-    filterCutoff = sound->gpf(SourceIDs::filterCutoff); // * std::pow(2, getCurrentlyPlayingNote() - sound->midiRootNote) * sound->filterKeyboardTracking;  // Add kb tracking
-    filterRessonance = sound->gpf(SourceIDs::filterRessonance);
-    float filterCutoffVelMod = currentNoteVelocity * sound->gpf(SourceIDs::filterCutoff) * sound->gpf(SourceIDs::vel2CutoffAmt);
-    float newFilterCutoffMod = filterCutoffMod + (currentModWheelValue/127.0) * filterCutoff * sound->gpf(SourceIDs::mod2CutoffAmt);  // Add mod wheel modulation and aftertouch here
-    float filterADSRMod = adsrFilter.getNextSample() * filterCutoff * sound->gpf(SourceIDs::filterADSR2CutoffAmt);
-    float computedCutoff = (1.0 - sound->gpf(SourceIDs::filterKeyboardTracking)) * filterCutoff + sound->gpf(SourceIDs::filterKeyboardTracking) * filterCutoff * std::pow(2, (getCurrentlyPlayingNote() - sound->getMidiRootNote())/12) + // Base cutoff and kb tracking
-                           filterCutoffVelMod + // Velocity mod to cutoff
-                           newFilterCutoffMod +  // Aftertouch mod/modulation wheel mod
-                           filterADSRMod; // ADSR mod
-    auto& filter = processorChain.get<filterIndex>();
-    filter.setCutoffFrequencyHz (juce::jmax(0.001f, computedCutoff));
+    filterCutoff = sound->gpf(ParamId::filterCutoff); // * std::pow(2, getCurrentlyPlayingNote() - sound->midiRootNote) * sound->filterKeyboardTracking;  // Add kb tracking
+    filterRessonance = sound->gpf(ParamId::filterRessonance);
+    float filterCutoffVelMod = currentNoteVelocity * sound->gpf(ParamId::filterCutoff) * sound->gpf(ParamId::vel2CutoffAmt);
+    float newFilterCutoffMod = filterCutoffMod + (currentModWheelValue/127.0) * filterCutoff * sound->gpf(ParamId::mod2CutoffAmt);  // Add mod wheel modulation and aftertouch here
+    filterBaseCutoff = (1.0 - sound->gpf(ParamId::filterKeyboardTracking)) * filterCutoff + sound->gpf(ParamId::filterKeyboardTracking) * filterCutoff * std::pow(2, (getCurrentlyPlayingNote() - sound->getMidiRootNote())/12) + // Base cutoff and kb tracking
+                       filterCutoffVelMod + // Velocity mod to cutoff
+                       newFilterCutoffMod;  // Aftertouch mod/modulation wheel mod
+    filterADSRCutoffAmt = filterCutoff * sound->gpf(ParamId::filterADSR2CutoffAmt);  // ADSR mod (applied at control rate when rendering, see applyFilter)
     filter.setResonance (filterRessonance);
     
     // Amp and pan
-    float velocityGain = (sound->gpf(SourceIDs::vel2GainAmt) * currentNoteVelocity) + (1 - sound->gpf(SourceIDs::vel2GainAmt));
+    float velocityGain = (sound->gpf(ParamId::vel2GainAmt) * currentNoteVelocity) + (1 - sound->gpf(ParamId::vel2GainAmt));
     lgain = velocityGain;
     rgain = velocityGain;
-    pan = sound->gpf(SourceIDs::pan);
+    pan = sound->gpf(ParamId::pan);
+    reverbSendGain = sound->gpf(ParamId::reverbSend);
     auto& gain = processorChain.get<masterGainIndex>();
     float newGainMod;
-    if (sound->gpf(SourceIDs::mod2GainAmt) >= 0){  // Set a maximum gain modulation combining mod wheel and aftertouch
-        newGainMod = (float)juce::jmin((double)(gainMod + sound->gpf(SourceIDs::mod2GainAmt) * (double)currentModWheelValue/127.0), (double)sound->gpf(SourceIDs::mod2GainAmt));  // Add mod wheel modulation here
+    if (sound->gpf(ParamId::mod2GainAmt) >= 0){  // Set a maximum gain modulation combining mod wheel and aftertouch
+        newGainMod = (float)juce::jmin((double)(gainMod + sound->gpf(ParamId::mod2GainAmt) * (double)currentModWheelValue/127.0), (double)sound->gpf(ParamId::mod2GainAmt));  // Add mod wheel modulation here
     } else {
-        newGainMod = (float)juce::jmax((double)(gainMod + sound->gpf(SourceIDs::mod2GainAmt) * (double)currentModWheelValue/127.0), (double)sound->gpf(SourceIDs::mod2GainAmt));  // Add mod wheel modulation here
+        newGainMod = (float)juce::jmax((double)(gainMod + sound->gpf(ParamId::mod2GainAmt) * (double)currentModWheelValue/127.0), (double)sound->gpf(ParamId::mod2GainAmt));  // Add mod wheel modulation here
     }
-    gain.setGainDecibels(sound->gpf(SourceIDs::gain) + newGainMod);
+    gain.setGainDecibels(sound->gpf(ParamId::gain) + newGainMod);
 }
 
 void SourceSamplerVoice::stopNote (float /*velocity*/, bool allowTailOff)
@@ -310,7 +209,7 @@ void SourceSamplerVoice::stopNote (float /*velocity*/, bool allowTailOff)
     if (allowTailOff) {
         // This is the case when receiving a note off event
         if (auto* sound = getCurrentlyPlayingSourceSamplerSound()){
-            if (sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_TRIGGER){
+            if (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_TRIGGER){
                 // We only trigger ADSRs release phase if we're in gate or loop launch modes, otherwise continue playing normally
             } else {
                 adsr.noteOff();
@@ -329,9 +228,9 @@ void SourceSamplerVoice::pitchWheelMoved (int newValue) {
     // 0 = min
     if (auto* sound = getCurrentlyPlayingSourceSamplerSound()){
         if (newValue >= 8192){
-            pitchBendModSemitones = (double)(((float)newValue - 8192.0f)/8192.0f) * sound->gpf(SourceIDs::pitchBendRangeUp);
+            pitchBendModSemitones = (double)(((float)newValue - 8192.0f)/8192.0f) * sound->gpf(ParamId::pitchBendRangeUp);
         } else {
-            pitchBendModSemitones = (double)((8192.0f - (float)newValue)/8192.0f) * sound->gpf(SourceIDs::pitchBendRangeDown) * -1;
+            pitchBendModSemitones = (double)((8192.0f - (float)newValue)/8192.0f) * sound->gpf(ParamId::pitchBendRangeDown) * -1;
         }
     }
 }
@@ -340,9 +239,9 @@ void SourceSamplerVoice::aftertouchChanged(int newAftertouchValue)
 {
     if (auto* sound = getCurrentlyPlayingSourceSamplerSound())
     {
-        pitchModSemitones = sound->gpf(SourceIDs::mod2PitchAmt) * (double)newAftertouchValue/127.0;
-        filterCutoffMod = (newAftertouchValue/127.0) * filterCutoff * sound->gpf(SourceIDs::mod2CutoffAmt);
-        gainMod = sound->gpf(SourceIDs::mod2GainAmt) * (float)newAftertouchValue/127.0;
+        pitchModSemitones = sound->gpf(ParamId::mod2PitchAmt) * (double)newAftertouchValue/127.0;
+        filterCutoffMod = (newAftertouchValue/127.0) * filterCutoff * sound->gpf(ParamId::mod2CutoffAmt);
+        gainMod = sound->gpf(ParamId::mod2GainAmt) * (float)newAftertouchValue/127.0;
         playheadSamplePositionMod = (double)newAftertouchValue/127.0;
     }
 }
@@ -352,9 +251,9 @@ void SourceSamplerVoice::channelPressureChanged  (int newChannelPressureValue)
 {
     if (auto* sound = getCurrentlyPlayingSourceSamplerSound())
     {
-        pitchModSemitones = sound->gpf(SourceIDs::mod2PitchAmt) * (double)newChannelPressureValue/127.0;
-        filterCutoffMod = (newChannelPressureValue/127.0) * filterCutoff * sound->gpf(SourceIDs::mod2CutoffAmt);
-        gainMod = sound->gpf(SourceIDs::mod2GainAmt) * (float)newChannelPressureValue/127.0;
+        pitchModSemitones = sound->gpf(ParamId::mod2PitchAmt) * (double)newChannelPressureValue/127.0;
+        filterCutoffMod = (newChannelPressureValue/127.0) * filterCutoff * sound->gpf(ParamId::mod2CutoffAmt);
+        gainMod = sound->gpf(ParamId::mod2GainAmt) * (float)newChannelPressureValue/127.0;
         playheadSamplePositionMod = (double)newChannelPressureValue/127.0;
     }
 }
@@ -378,12 +277,15 @@ float interpolateSample (float samplePosition, const float* const signal)
 //==============================================================================
 void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples)
 {
+    if (stopIfEnvelopeIsSilent())
+        return;
+    
     if (auto* sound = getCurrentlyPlayingSourceSamplerSound())
     {
         // Do some preparation (not all parameters will be used depending on the launch mode)
         int originalNumSamples = numSamples; // user later for filter processing
         double previousPitchRatio = pitchRatio;
-        float previousPitchModSemitones = (float)juce::jmin((double)pitchModSemitones + sound->gpf(SourceIDs::mod2PitchAmt) * (double)currentModWheelValue/127.0, (double)sound->gpf(SourceIDs::mod2PitchAmt));  // Add mod wheel position
+        float previousPitchModSemitones = (float)juce::jmin((double)pitchModSemitones + sound->gpf(ParamId::mod2PitchAmt) * (double)currentModWheelValue/127.0, (double)sound->gpf(ParamId::mod2PitchAmt));  // Add mod wheel position
         float previousPitchBendModSemitones = pitchBendModSemitones;
         float previousPan = pan;
         bool noteStoppedHard = false;
@@ -394,7 +296,8 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
         const float* const inL = data.getReadPointer (0);
         const float* const inR = data.getNumChannels() > 1 ? data.getReadPointer (1) : nullptr;
         
-        tmpVoiceBuffer.clear();
+        // NOTE: tmpVoiceBuffer does not need to be cleared because all samples up to the last rendered sample are overwritten
+        blockEnvelopePeak = 0.0f;
         float* outL = tmpVoiceBuffer.getWritePointer (0, 0);
         float* outR = tmpVoiceBuffer.getNumChannels() > 1 ? tmpVoiceBuffer.getWritePointer (1, 0) : nullptr;
         
@@ -404,18 +307,18 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
             float l = interpolateSample(playheadSamplePosition, inL);
             float r = (inR != nullptr) ? interpolateSample(playheadSamplePosition, inR) : l;
             
-            if (sound->gpi(SourceIDs::launchMode) != LAUNCH_MODE_FREEZE){
+            if (sound->gpi(ParamId::launchMode) != LAUNCH_MODE_FREEZE){
                 // Outside freeze mode, add samples from the source sound to the buffer and check for looping and other sorts of modulations
                 
                 // Check, in case we're looping, if we are in a crossfade zone and should do crossfade
-                if ((sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_LOOP) && sound->gpi(SourceIDs::loopXFadeNSamples) > 0){
+                if ((sound->gpi(ParamId::launchMode) == LAUNCH_MODE_LOOP) && sound->gpi(ParamId::loopXFadeNSamples) > 0){
                     // NOTE: don't crossfade in LAUNCH_MODE_LOOP_FW_BW mode because it loops from the the same sample (no need to crossfade)
                     if (playheadDirectionIsForward){
                         // PLayhead going forward  (normal playing mode): do loop when reahing fixedLoopEndPositionSample
                         float samplesToLoopEndPositionSample = (float)fixedLoopEndPositionSample - playheadSamplePosition;
-                        if ((samplesToLoopEndPositionSample > 0) && (samplesToLoopEndPositionSample < sound->gpi(SourceIDs::loopXFadeNSamples))){
+                        if ((samplesToLoopEndPositionSample > 0) && (samplesToLoopEndPositionSample < sound->gpi(ParamId::loopXFadeNSamples))){
                             if (ENABLE_DEBUG_BUFFER == 1){
-                                startRecordingToDebugBuffer((int)sound->gpi(SourceIDs::loopXFadeNSamples) * 2);
+                                startRecordingToDebugBuffer((int)sound->gpi(ParamId::loopXFadeNSamples) * 2);
                             }
                             
                             // We are approaching loopEndPositionSample and are closer than sound->loopXFadeNSamples
@@ -426,7 +329,7 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
                             if (crossfadePos > 0){
                                 lcrossfadeSample = interpolateSample(crossfadePos, inL);
                                 rcrossfadeSample = (inR != nullptr) ? interpolateSample(crossfadePos, inR) : lcrossfadeSample;
-                                crossfadeGain = (float)samplesToLoopEndPositionSample/sound->gpi(SourceIDs::loopXFadeNSamples);
+                                crossfadeGain = (float)samplesToLoopEndPositionSample/sound->gpi(ParamId::loopXFadeNSamples);
                             } else {
                                 // If position is negative, there is no data to do the crossfade
                             }
@@ -438,7 +341,7 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
                     } else {
                         // Playhead going backwards: do loop when reahing fixedLoopEndPositionSample
                         int samplesToLoopStartPositionSample = playheadSamplePosition - (float)fixedLoopStartPositionSample;
-                        if ((samplesToLoopStartPositionSample > 0) && (samplesToLoopStartPositionSample < sound->gpi(SourceIDs::loopXFadeNSamples))){
+                        if ((samplesToLoopStartPositionSample > 0) && (samplesToLoopStartPositionSample < sound->gpi(ParamId::loopXFadeNSamples))){
                             // We are approaching loopStartPositionSample (going backwards) and are closer than sound->loopXFadeNSamples
                             float lcrossfadeSample = 0.0;
                             float rcrossfadeSample = 0.0;
@@ -447,7 +350,7 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
                             if (crossfadePos < sound->lengthInSamples){
                                 lcrossfadeSample = interpolateSample(crossfadePos, inL);
                                 rcrossfadeSample = (inR != nullptr) ? interpolateSample(crossfadePos, inR) : lcrossfadeSample;
-                                crossfadeGain = (float)samplesToLoopStartPositionSample/sound->gpi(SourceIDs::loopXFadeNSamples);
+                                crossfadeGain = (float)samplesToLoopStartPositionSample/sound->gpi(ParamId::loopXFadeNSamples);
                             } else {
                                 // If position is above playing sound length, there is no data to do the crossfade
                             }
@@ -472,23 +375,24 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
             float interpolatedRGainPan = (previousRGainPan * ((float)numSamples/originalNumSamples) + rGainPan * (1.0f - (float)numSamples/originalNumSamples));
             float interpolatedLGainPan = (previousLGainPan * ((float)numSamples/originalNumSamples) + lGainPan * (1.0f - (float)numSamples/originalNumSamples));
             auto envelopeValue = adsr.getNextSample();
+            trackEnvelopeValue(envelopeValue);
             
             l *= lgain * interpolatedLGainPan * envelopeValue;
             r *= rgain * interpolatedRGainPan * envelopeValue;
 
             // Update output buffer with L and R samples
             if (outR != nullptr) {
-                *outL++ += l;
-                *outR++ += r;
+                *outL++ = l;
+                *outR++ = r;
             } else {
-                *outL++ += (l + r) * 0.5f;
+                *outL++ = (l + r) * 0.5f;
             }
 
-            if (sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_FREEZE){
+            if (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_FREEZE){
                 // If in freeze mode, move from the current playhead position to the target playhead position in the length of the block
                 double distanceTotargetPlayheadSamplePosition = targetPlayheadSamplePosition - playheadSamplePosition;
                 double distanceTotargetPlayheadSamplePositionNormalized = std::abs(distanceTotargetPlayheadSamplePosition / sound->getLengthInSamples()); // normalized between 0 and 1
-                double maxSpeed = juce::jmax(std::pow(distanceTotargetPlayheadSamplePositionNormalized, 2) * sound->gpf(SourceIDs::freezePlayheadSpeed), 1.0);
+                double maxSpeed = juce::jmax(std::pow(distanceTotargetPlayheadSamplePositionNormalized, 2) * sound->gpf(ParamId::freezePlayheadSpeed), 1.0);
                 double actualSpeed = juce::jmin(maxSpeed, std::abs(distanceTotargetPlayheadSamplePosition));
                 if (distanceTotargetPlayheadSamplePosition >= 0){
                     playheadSamplePosition += actualSpeed;
@@ -509,11 +413,11 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
                 }
                 
                 // ... also check if we're reaching the end of the sound or looping region to do looping
-                if ((sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_LOOP) || (sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_LOOP_FW_BW)){
+                if ((sound->gpi(ParamId::launchMode) == LAUNCH_MODE_LOOP) || (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_LOOP_FW_BW)){
                     // If looping is enabled, check whether we should loop
                     if (playheadDirectionIsForward){
                         if (playheadSamplePosition > fixedLoopEndPositionSample){
-                            if (sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_LOOP_FW_BW) {
+                            if (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_LOOP_FW_BW) {
                                 // Forward<>Backward loop mode (ping pong): stay on loop end but change direction
                                 playheadDirectionIsForward = !playheadDirectionIsForward;
                             } else {
@@ -523,7 +427,7 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
                         }
                     } else {
                         if (playheadSamplePosition < fixedLoopStartPositionSample){
-                            if (sound->gpi(SourceIDs::launchMode) == LAUNCH_MODE_LOOP_FW_BW) {
+                            if (sound->gpi(ParamId::launchMode) == LAUNCH_MODE_LOOP_FW_BW) {
                                 // Forward<>Backward loop mode (ping pong): stay on loop end but change direction
                                 playheadDirectionIsForward = !playheadDirectionIsForward;
                             } else {
@@ -555,27 +459,174 @@ void SourceSamplerVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer
             }
             
             if (!adsr.isActive() && !noteStoppedHard){
+                // Envelope finished, no need to render the rest of the block
                 stopNote (0.0f, false);
+                break;
             }
         }
         
-
-        // Apply filter
-        auto block = juce::dsp::AudioBlock<float> (tmpVoiceBuffer);
-        auto blockToUse = block.getSubBlock (0, (size_t) originalNumSamples);
-        auto contextToUse = juce::dsp::ProcessContextReplacing<float> (blockToUse);
-        processorChain.process (contextToUse);
+        // Only the samples until the voice was stopped have been rendered (if it was not stopped, numSamples will now be -1)
+        int numRenderedSamples = originalNumSamples - juce::jmax(0, numSamples);
         
-        // Add voice signal (including filter) to the output buffer
-        juce::dsp::AudioBlock<float> (outputBuffer)
-            .getSubBlock ((size_t) startSample, (size_t) originalNumSamples)
-            .add (blockToUse);
+
+        // Apply filter and gain, and add to the output buffer
+        applyFilterAndGainAndAddToOutput(outputBuffer, startSample, numRenderedSamples);
+    }
+}
+
+void SourceSamplerVoice::applyFilterAndGainAndAddToOutput(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples)
+{
+    // If the envelope stayed below the silence threshold for the whole block (e.g. the very beginning of an attack or a
+    // release that has not yet been stopped), the output of the voice would not be audible, so skip filter, gain and mixing.
+    // The filter envelope and coefficient ramp still advance so their timing is not affected. The gain smoother can't be
+    // advanced without processing, so blocks are not skipped while a gain change is being ramped
+    auto& gain = processorChain.get<masterGainIndex>();
+    if (!gain.isSmoothing() && isBelowSilenceThreshold (blockEnvelopePeak)){
+        advanceFilterEnvelope(numSamples);
+        numSkippedBlocks += 1;
+        return;
+    }
+    
+    // Apply filter
+    applyFilter(numSamples);
+    
+    // Apply master gain
+    auto block = juce::dsp::AudioBlock<float> (tmpVoiceBuffer);
+    auto blockToUse = block.getSubBlock (0, (size_t) numSamples);
+    auto contextToUse = juce::dsp::ProcessContextReplacing<float> (blockToUse);
+    processorChain.process (contextToUse);
+    
+    // Add voice signal (including filter) to the channels of the output bus the voice is routed to. Other buses are not
+    // touched so no extra copies or mixing stages are needed
+    auto bus = getOutputBusChannels (outputBuffer.getNumChannels());
+    juce::dsp::AudioBlock<float> (outputBuffer)
+        .getSubsetChannelBlock ((size_t) bus.firstChannel, (size_t) bus.numChannels)
+        .getSubBlock ((size_t) startSample, (size_t) numSamples)
+        .add (blockToUse);
+    
+    // If reverb is active, also send the voice signal to the reverb bus
+    if ((reverbSendBuffer != nullptr) && (reverbSendGain > 0.0f)){
+        juce::dsp::AudioBlock<float> (*reverbSendBuffer)
+            .getSubBlock ((size_t) startSample, (size_t) numSamples)
+            .addProductOf (blockToUse, reverbSendGain);
+    }
+}
+
+void SourceSamplerVoice::setOutputBusesLayout (const OutputBusesLayout* layout)
+{
+    outputBusesLayout = layout;
+}
+
+void SourceSamplerVoice::setReverbSendBuffer (juce::AudioBuffer<float>* buffer)
+{
+    reverbSendBuffer = buffer;
+}
+
+float SourceSamplerVoice::getReverbSendGain()
+{
+    return reverbSendGain;
+}
+
+OutputBusChannels SourceSamplerVoice::getOutputBusChannels (int numOutputChannels)
+{
+    // Return the channels of the bus this voice is routed to. If no layout has been set (or the bus is disabled in the host),
+    // use the main output bus. If no layout is set at all, the main bus takes all output channels.
+    OutputBusChannels bus;
+    bus.numChannels = numOutputChannels;
+    if (outputBusesLayout != nullptr){
+        const auto& mainBus = (*outputBusesLayout)[0];
+        const auto& selectedBus = (*outputBusesLayout)[juce::jlimit (0, NUM_OUTPUT_BUSES - 1, outputBus)];
+        if ((selectedBus.numChannels > 0) && (selectedBus.firstChannel + selectedBus.numChannels <= numOutputChannels)){
+            bus = selectedBus;
+        } else if (mainBus.numChannels > 0){
+            bus = mainBus;
+        }
+    }
+    bus.firstChannel = juce::jlimit (0, numOutputChannels, bus.firstChannel);
+    bus.numChannels = juce::jlimit (0, numOutputChannels - bus.firstChannel, bus.numChannels);
+    return bus;
+}
+
+//==============================================================================
+void SourceSamplerVoice::trackEnvelopeValue(float envelopeValue)
+{
+    // Once the attack phase has finished, the envelope can only decrease (decay, sustain and release), so we keep track
+    // of that to know when a voice will stay silent for the rest of the note (see stopIfEnvelopeIsSilent)
+    if (envelopeValue < lastEnvelopeValue){
+        envelopeIsDecaying = true;
+    }
+    lastEnvelopeValue = envelopeValue;
+    blockEnvelopePeak = juce::jmax(blockEnvelopePeak, envelopeValue);
+}
+
+bool SourceSamplerVoice::isBelowSilenceThreshold (float envelopeValue)
+{
+    auto& gain = processorChain.get<masterGainIndex>();
+    float voiceLevel = envelopeValue * juce::jmax(lgain, rgain) * gain.getGainLinear();
+    return voiceLevel < juce::Decibels::decibelsToGain((float)VOICE_SILENCE_THRESHOLD_DB);
+}
+
+bool SourceSamplerVoice::stopIfEnvelopeIsSilent()
+{
+    // If the envelope is decaying and the voice level is already below VOICE_SILENCE_THRESHOLD_DB, the voice will not be
+    // audible anymore (e.g. long near-zero release tails or sustain levels of 0), so stop it without rendering, filtering
+    // and mixing the block
+    if (isVoiceActive() && envelopeIsDecaying && isBelowSilenceThreshold (lastEnvelopeValue)){
+        stopNote (0.0f, false);
+        numSkippedBlocks += 1;
+        return true;
+    }
+    return false;
+}
+
+int SourceSamplerVoice::getNumSkippedBlocks()
+{
+    // Returns the number of skipped blocks since the last call and resets the counter
+    return numSkippedBlocks.exchange(0);
+}
+
+void SourceSamplerVoice::applyFilter(int numSamples)
+{
+    // Compute the filter ADSR and cutoff every FILTER_MODULATION_CONTROL_RATE samples. The filter interpolates
+    // its coefficients between these control points so cutoff modulations are smooth independently of the block size.
+    // The ADSR is only advanced once a whole control period has been processed (which can take several calls if the
+    // block is split in sub-blocks), so envelope times don't depend on how blocks are split
+    int position = 0;
+    while (position < numSamples){
+        if (numSamplesUntilNextFilterControlPoint <= 0){
+            float filterADSRMod = adsrFilter.getNextSample() * filterADSRCutoffAmt;
+            filter.setCutoffFrequencyHz (filterBaseCutoff + filterADSRMod, FILTER_MODULATION_CONTROL_RATE);
+            numSamplesUntilNextFilterControlPoint = FILTER_MODULATION_CONTROL_RATE;
+        }
+        int numSamplesToProcess = juce::jmin(numSamplesUntilNextFilterControlPoint, numSamples - position);
+        filter.process (tmpVoiceBuffer, position, numSamplesToProcess);
+        position += numSamplesToProcess;
+        numSamplesUntilNextFilterControlPoint -= numSamplesToProcess;
+    }
+}
+
+void SourceSamplerVoice::advanceFilterEnvelope(int numSamples)
+{
+    // Same as applyFilter but without processing any audio (used when the voice output is not audible). Cutoff control
+    // points are still computed so the coefficients are the same as if the audio had been processed
+    int position = 0;
+    while (position < numSamples){
+        if (numSamplesUntilNextFilterControlPoint <= 0){
+            float filterADSRMod = adsrFilter.getNextSample() * filterADSRCutoffAmt;
+            filter.setCutoffFrequencyHz (filterBaseCutoff + filterADSRMod, FILTER_MODULATION_CONTROL_RATE);
+            numSamplesUntilNextFilterControlPoint = FILTER_MODULATION_CONTROL_RATE;
+        }
+        int numSamplesToSkip = juce::jmin(numSamplesUntilNextFilterControlPoint, numSamples - position);
+        filter.skip (numSamplesToSkip);
+        position += numSamplesToSkip;
+        numSamplesUntilNextFilterControlPoint -= numSamplesToSkip;
     }
 }
 
 void SourceSamplerVoice::prepare (const juce::dsp::ProcessSpec& spec)
 {
     tmpVoiceBuffer = juce::AudioBuffer<float>(spec.numChannels, spec.maximumBlockSize);
+    filter.prepare (spec);
     processorChain.prepare (spec);
 }
 
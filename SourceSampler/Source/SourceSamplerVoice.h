@@ -14,6 +14,131 @@
 #include "SourceSamplerSound.h"
 
 
+//==============================================================================
+// 24 dB/oct low-pass filter used in the voices, made of two cascaded state variable filter stages (topology-preserving
+// transform). It replaces the LPF24 LadderFilter used before and keeps its slope: without resonance both stages are
+// critically damped, which is the same response as the four identical one-pole stages of the ladder. Resonance is
+// applied in the second stage, so it produces a peak at the cutoff that gets close to self-oscillation at the top of the
+// range like the ladder does (the amount of resonance for a given value is similar but not identical, and the ladder's
+// saturation is not modelled).
+// Unlike the LadderFilter, coefficients can be cheaply interpolated sample by sample, so cutoff modulations can be
+// computed at a lower control rate (see FILTER_MODULATION_CONTROL_RATE) without producing zipper noise. The only expensive
+// computation (tan) is done once per control period when a new target cutoff is set.
+
+class SourceSamplerVoiceFilter
+{
+public:
+    void prepare (const juce::dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        state.resize (spec.numChannels);
+        reset();
+    }
+    
+    void reset()
+    {
+        std::fill (state.begin(), state.end(), ChannelState());
+        shouldInterpolate = false;
+        numRampSamplesRemaining = 0;
+    }
+    
+    void setResonance (float newResonance)
+    {
+        // Map resonance 0..1 to the damping of the second stage, 2..0.1 (2 = no resonance, values close to 0 self oscillate)
+        targetK = 2.0f - 1.9f * juce::jlimit (0.0f, 1.0f, newResonance);
+    }
+    
+    // Sets the cutoff to reach after numRampSamples samples have been processed. Coefficients are linearly interpolated
+    // from their current values during that time, even if the samples are processed in several calls to process
+    void setCutoffFrequencyHz (float newCutoff, int numRampSamples)
+    {
+        float cutoff = juce::jlimit (10.0f, (float)sampleRate * 0.49f, newCutoff);
+        float targetG = (float)std::tan (juce::MathConstants<double>::pi * cutoff / sampleRate);
+        if (!shouldInterpolate){
+            // First update after reset: jump directly to the target coefficients
+            g = targetG;
+            k = targetK;
+            shouldInterpolate = true;
+        }
+        numRampSamplesRemaining = juce::jmax (1, numRampSamples);
+        gInc = (targetG - g) / numRampSamplesRemaining;
+        kInc = (targetK - k) / numRampSamplesRemaining;
+    }
+    
+    void process (juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+    {
+        // Process numSamples in place, advancing the coefficient ramp started in setCutoffFrequencyHz
+        if (numSamples <= 0) return;
+        int numRampSamples = juce::jmin (numSamples, numRampSamplesRemaining);
+        for (int channel = 0; channel < juce::jmin (buffer.getNumChannels(), (int)state.size()); channel++){
+            float* samples = buffer.getWritePointer (channel, startSample);
+            ChannelState s = state[channel];
+            float gi = g;
+            float ki = k;
+            for (int i = 0; i < numSamples; i++){
+                if (i < numRampSamples){
+                    gi += gInc;
+                    ki += kInc;
+                }
+                float v = processStage (samples[i], gi, 2.0f, s.stage1ic1eq, s.stage1ic2eq);
+                samples[i] = processStage (v, gi, ki, s.stage2ic1eq, s.stage2ic2eq);
+            }
+            state[channel] = s;
+        }
+        skip (numRampSamples);
+    }
+    
+    // Advances the coefficient ramp by numSamples without processing any audio (the state of the filter is kept)
+    void skip (int numSamples)
+    {
+        int numRampSamples = juce::jlimit (0, numRampSamplesRemaining, numSamples);
+        g += gInc * numRampSamples;
+        k += kInc * numRampSamples;
+        numRampSamplesRemaining -= numRampSamples;
+    }
+    
+private:
+    struct ChannelState
+    {
+        float stage1ic1eq = 0.0f, stage1ic2eq = 0.0f;
+        float stage2ic1eq = 0.0f, stage2ic2eq = 0.0f;
+    };
+    
+    static inline float processStage (float input, float gi, float ki, float& ic1eq, float& ic2eq) noexcept
+    {
+        float a1 = 1.0f / (1.0f + gi * (gi + ki));
+        float a2 = gi * a1;
+        float a3 = gi * a2;
+        float v3 = input - ic2eq;
+        float v1 = a1 * ic1eq + a2 * v3;
+        float v2 = ic2eq + a2 * ic1eq + a3 * v3;
+        ic1eq = 2.0f * v1 - ic1eq;
+        ic2eq = 2.0f * v2 - ic2eq;
+        return v2;
+    }
+    
+    double sampleRate = 44100.0;
+    float g = 0.0f, gInc = 0.0f;
+    float k = 2.0f, kInc = 0.0f, targetK = 2.0f;
+    int numRampSamplesRemaining = 0;
+    bool shouldInterpolate = false;
+    std::vector<ChannelState> state;
+};
+
+
+//==============================================================================
+// Position of each of the stereo output buses in the buffer rendered by the synthesiser. Buses which are disabled
+// in the host have 0 channels and voices routed to them are rendered into the main output bus instead
+
+struct OutputBusChannels
+{
+    int firstChannel = 0;
+    int numChannels = 0;
+};
+
+typedef std::array<OutputBusChannels, NUM_OUTPUT_BUSES> OutputBusesLayout;
+
+
 class SourceSamplerVoice: public juce::SynthesiserVoice
 {
 public:
@@ -38,8 +163,18 @@ public:
     void renderNextBlock (juce::AudioBuffer<float>&, int startSample, int numSamples) override;
     using SynthesiserVoice::renderNextBlock;
     
+    bool stopIfEnvelopeIsSilent();
+    int getNumSkippedBlocks();
+    
     //==============================================================================
     void prepare (const juce::dsp::ProcessSpec& spec);
+    void applyFilter (int numSamples);
+    void applyFilterAndGainAndAddToOutput (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples);
+    
+    void setOutputBusesLayout (const OutputBusesLayout* layout);
+    void setReverbSendBuffer (juce::AudioBuffer<float>* buffer);
+    float getReverbSendGain();
+    OutputBusChannels getOutputBusChannels (int numOutputChannels);
     
     float getPlayingPositionPercentage();
     int getNoteIndex(int midiNote);
@@ -70,25 +205,42 @@ private:
     juce::ADSR adsr;
     juce::ADSR adsrFilter;
     
+    // Used to stop voices early and to skip filter and gain processing when they're no longer audible
+    void trackEnvelopeValue(float envelopeValue);
+    float lastEnvelopeValue = 0.0f;
+    float blockEnvelopePeak = 0.0f;  // Maximum envelope value in the block being rendered
+    bool envelopeIsDecaying = false;
+    bool isBelowSilenceThreshold (float envelopeValue);
+    void advanceFilterEnvelope (int numSamples);
+    std::atomic<int> numSkippedBlocks { 0 };  // Number of voice-blocks whose filter, gain and mixing were skipped since the last call to getNumSkippedBlocks (read from the message thread for stats)
+    
     //==============================================================================
-    // ProcessorChain (filter, pan and master gain)
+    // Filter and ProcessorChain (master gain)
+    SourceSamplerVoiceFilter filter;
     enum
     {
-        filterIndex,
         masterGainIndex
     };
-    juce::dsp::ProcessorChain<juce::dsp::LadderFilter<float>, juce::dsp::Gain<float>> processorChain;
+    juce::dsp::ProcessorChain<juce::dsp::Gain<float>> processorChain;
     juce::AudioBuffer<float> tmpVoiceBuffer;  // used for processing voice contents in each process block, then adding to the main output buffer
     
+    //==============================================================================
+    // Output routing
+    int outputBus = 0;  // Index of the output bus this voice renders to (taken from the sound's "outputBus" parameter when the note starts)
+    const OutputBusesLayout* outputBusesLayout = nullptr;  // Owned by the synthesiser
+    juce::AudioBuffer<float>* reverbSendBuffer = nullptr;  // Owned by the synthesiser, nullptr if reverb is not active
+    float reverbSendGain = 0.0f;  // Taken from the sound's "reverbSend" parameter
+    
     float filterCutoff = 20000.0f;
     float filterRessonance = 0.0f;
+    float filterBaseCutoff = 20000.0f;  // Cutoff with all modulations except for the filter ADSR (computed once per block)
+    float filterADSRCutoffAmt = 0.0f;  // Amount of filter ADSR modulation (computed once per block, the ADSR is applied at control rate)
+    int numSamplesUntilNextFilterControlPoint = 0;  // Control periods can span several calls to applyFilter (e.g. when blocks are split at MIDI events)
     float filterCutoffMod = 0.0f;  // For aftertouch, modulation wheel
     float gainMod = 1.0f;  // For aftertouch, modulation wheel
     int startPositionSample = 0;
     int endPositionSample = 0;
-    int loopStartPositionSample = 0;
     int fixedLoopStartPositionSample = 0;
-    int loopEndPositionSample = 0;
     int fixedLoopEndPositionSample = 0;
     bool hasNotYetPassedLoopStartPositionForTheFirstTime = true;
     
@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    VoiceRenderWorkerPool.h
+    Created: 19 Oct 2026 10:12:05am
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "defines_source.h"
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_LINUX || JUCE_ANDROID
+ #include <semaphore.h>
+#endif
+
+
+//==============================================================================
+// Pool of worker threads used to render voices in parallel (see PARALLEL_VOICE_RENDERING). The calling (audio) thread
+// and the workers are the "participants" of a job, participant 0 being the calling thread and participant i the worker
+// i - 1. The tasks of a job are split in one contiguous group per participant. Each participant first renders the tasks
+// of its own group and then steals pending tasks from the groups of the others, claiming them one by one with an atomic
+// counter per group. The participant index is passed to the task so it can accumulate its output in its own buffers.
+// Workers run with realtime priority and are not pinned to any core (the core the host audio thread runs on is not
+// known). When waiting for work they spin for a while (so consecutive blocks don't pay the wake up cost) and then go to
+// sleep on a semaphore. Nothing is allocated and no locks are taken by the calling thread: waking up a sleeping worker
+// only posts its semaphore (a futex wake on Linux).
+
+class VoiceRenderWorkerPool
+{
+public:
+    class Task
+    {
+    public:
+        virtual ~Task() = default;
+        virtual void runTask (int taskIndex, int participantIndex) = 0;
+    };
+
+    VoiceRenderWorkerPool (int numWorkers)
+        : nextTaskInGroup (new std::atomic<int>[(size_t) numWorkers + 1]),
+          groupEnd (new int[(size_t) numWorkers + 1])
+    {
+        for (int i = 0; i < numWorkers; i++)
+            workers.add (new Worker (*this, i + 1));
+        for (auto* worker : workers){
+            #if (JUCE_MAJOR_VERSION > 7) || ((JUCE_MAJOR_VERSION == 7) && ((JUCE_MINOR_VERSION > 0) || (JUCE_BUILDNUMBER >= 3)))
+            worker->startRealtimeThread (juce::Thread::RealtimeOptions().withPriority (10));
+            #else
+            worker->startThread (10);  // Highest priority (realtime scheduling when available)
+            #endif
+        }
+    }
+
+    ~VoiceRenderWorkerPool()
+    {
+        for (auto* worker : workers){
+            worker->signalThreadShouldExit();
+            worker->wakeUp.post();
+        }
+        for (auto* worker : workers)
+            worker->stopThread (1000);
+    }
+
+    int getNumParticipants() { return workers.size() + 1; }
+
+    // Runs task.runTask(i, participantIndex) for i in [0, numTasks) using the worker threads and the calling thread.
+    // Returns once all tasks have been processed. The calling thread renders its own group and then every task of the
+    // other groups which no worker has started yet, so it never waits for work that has not been started: it only waits
+    // for the tasks which workers are rendering at that moment (at most one per worker, as tasks are claimed one by one).
+    // These can't be taken over (the worker is modifying the voice state). If the job is not done by expectedFinishMs (as
+    // given by juce::Time::getMillisecondCounterHiRes), run returns false so callers can stop using the pool for a while.
+    bool run (Task& task, int numTasks, double expectedFinishMs)
+    {
+        currentTask = &task;
+        int numGroups = getNumParticipants();
+        for (int group = 0; group < numGroups; group++){
+            nextTaskInGroup[group].store ((group * numTasks) / numGroups);
+            groupEnd[group] = ((group + 1) * numTasks) / numGroups;
+        }
+        numTasksDone.store (0);
+        jobIsOpen.store (true);
+        jobGeneration.fetch_add (1);
+        for (auto* worker : workers)
+            if (worker->isSleeping.exchange (false))
+                worker->wakeUp.post();
+
+        // Calling thread also processes tasks. When this returns, all tasks have been claimed
+        processTasks (0);
+
+        // Wait for the tasks that workers were already rendering. Once late, yield so a worker that was preempted in the
+        // same core can finish its task
+        bool finishedInTime = true;
+        while (numTasksDone.load() < numTasks){
+            if (finishedInTime && (juce::Time::getMillisecondCounterHiRes() > expectedFinishMs))
+                finishedInTime = false;
+            if (!finishedInTime)
+                juce::Thread::yield();
+        }
+
+        // Close the job and make sure no worker is still looking at it before returning
+        jobIsOpen.store (false);
+        while (numWorkersInJob.load() > 0) {}
+        return finishedInTime;
+    }
+
+private:
+    //==============================================================================
+    // Counting semaphore whose post does not take any lock
+    class Semaphore
+    {
+    public:
+        #if JUCE_MAC || JUCE_IOS
+        Semaphore() : semaphore (dispatch_semaphore_create (0)) {}
+        ~Semaphore() { dispatch_release (semaphore); }
+        void post() { dispatch_semaphore_signal (semaphore); }
+        void wait() { dispatch_semaphore_wait (semaphore, DISPATCH_TIME_FOREVER); }
+    private:
+        dispatch_semaphore_t semaphore;
+        #elif JUCE_LINUX || JUCE_ANDROID
+        Semaphore() { sem_init (&semaphore, 0, 0); }
+        ~Semaphore() { sem_destroy (&semaphore); }
+        void post() { sem_post (&semaphore); }
+        void wait() { while (sem_wait (&semaphore) != 0) {} }  // Retry if interrupted by a signal
+    private:
+        sem_t semaphore;
+        #else
+        void post() { event.signal(); }
+        void wait() { event.wait(); }
+    private:
+        juce::WaitableEvent event;
+        #endif
+        JUCE_DECLARE_NON_COPYABLE (Semaphore)
+    };
+
+    //==============================================================================
+    class Worker: public juce::Thread
+    {
+    public:
+        Worker (VoiceRenderWorkerPool& p, int index) : juce::Thread ("VoiceRenderWorker"), pool (p), participantIndex (index) {}
+
+        void run() override
+        {
+            juce::uint32 lastGeneration = pool.jobGeneration.load();
+            while (!threadShouldExit()){
+                bool hasNewJob = false;
+                for (int i = 0; (i < VOICE_RENDER_WORKER_SPIN_ITERATIONS) && !hasNewJob; i++)
+                    hasNewJob = pool.jobGeneration.load() != lastGeneration;
+                if (!hasNewJob){
+                    // Nothing to do after spinning, go to sleep until posted. Flag is set before checking the job
+                    // generation again so either we see the new job or the calling thread sees we're sleeping (if both
+                    // happen, the semaphore is posted anyway and the next wait returns without a job, which is harmless)
+                    isSleeping.store (true);
+                    if ((pool.jobGeneration.load() == lastGeneration) && !threadShouldExit())
+                        wakeUp.wait();
+                    isSleeping.store (false);
+                    continue;
+                }
+                lastGeneration = pool.jobGeneration.load();
+                pool.joinJob (participantIndex);
+            }
+        }
+
+        Semaphore wakeUp;
+        std::atomic<bool> isSleeping { false };
+
+    private:
+        VoiceRenderWorkerPool& pool;
+        int participantIndex;
+    };
+
+    //==============================================================================
+    void processTasks (int participantIndex)
+    {
+        // Own group first, then steal from the groups of the other participants
+        int numGroups = getNumParticipants();
+        for (int i = 0; i < numGroups; i++){
+            int group = (participantIndex + i) % numGroups;
+            while (true){
+                int taskIndex = nextTaskInGroup[group].fetch_add (1);
+                if (taskIndex >= groupEnd[group])
+                    break;
+                currentTask->runTask (taskIndex, participantIndex);
+                numTasksDone.fetch_add (1);
+            }
+        }
+    }
+
+    void joinJob (int participantIndex)
+    {
+        numWorkersInJob.fetch_add (1);
+        if (jobIsOpen.load())
+            processTasks (participantIndex);
+        numWorkersInJob.fetch_sub (1);
+    }
+
+    juce::OwnedArray<Worker> workers;
+    Task* currentTask = nullptr;
+    std::unique_ptr<std::atomic<int>[]> nextTaskInGroup;  // One per participant
+    std::unique_ptr<int[]> groupEnd;  // One past the last task of the group of each participant
+    std::atomic<int> numTasksDone { 0 };
+    std::atomic<int> numWorkersInJob { 0 };
+    std::atomic<bool> jobIsOpen { false };
+    std::atomic<juce::uint32> jobGeneration { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceRenderWorkerPool)
+};
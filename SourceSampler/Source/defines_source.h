@@ -19,7 +19,9 @@
 
 #if ELK_BUILD
     #define USE_HTTP_SERVER 1 // Use the embedded http server to serve audio files because even though in python ui we direcly load them form disk, if loading the web ui we still want to be able to see waveforms
-    #define USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS 1  // In ELK, downloads also happen through the external HTTP server
+    #ifndef USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS
+    #define USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS 0  // Sounds are downloaded in-process with the DownloadScheduler as in the other platforms (JUCE uses libcurl in ELK builds). Build with USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS=1 to download through the python download server (/download_sound endpoint) instead
+    #endif
 #else
     #define USE_HTTP_SERVER 1  // Use embedded http server to serve audio files to plugin UI
     #define USE_EXTERNAL_HTTP_SERVER_FOR_DOWNLOADS 0  // Don't use external HTTP server for downloads, download them from the plugin
@@ -57,7 +59,18 @@
 #define MAIN_TIMER_HZ 15  // Run main timer tasks at this rate (this includes removing sounds that need to be removed and possibly other tasks)
 #define SAFE_SOUND_DELETION_TIME_MS 200
 #define SAMPLER_SOUND_TIMER_MS 20
+#ifndef ENABLE_PRESET_STAGING
+#define ENABLE_PRESET_STAGING 1  // When stepping through presets with program changes, load the next one (by index) in the background so it can be swapped in without gaps (see SourceSampler::stagePreset)
+#endif
+#define PRESET_STAGING_MAX_MEMORY_MB 256  // Staged presets whose audio takes more memory than this are discarded
+#define PRESET_FILE_EXTENSION "srcpreset"  // Binary preset files (see PresetFile.h), presets saved as .xml files by older versions are still loaded
+#define PRESET_FILE_FORMAT_VERSION 1
+#define PRESET_CATALOGUE_FILENAME "catalogue.xml"  // Stored in the presets folder, used to get preset names without parsing all preset files (see PresetCatalogue.h)
+#define PRESET_CATALOGUE_XML_TAG "PRESET_CATALOGUE"
+#define PRESET_CATALOGUE_ENTRY_XML_TAG "PRESET_ENTRY"
 #define STRETCH_PROCESSING_TIME_DEBOUNCE_MS 200.0
+#define STATE_SNAPSHOT_MIN_INTERVAL_MS 1000  // Snapshots of the state returned to the host are re-created at most at this rate from the timer (see SourceSampler::getStateSnapshot)
+#define QUERY_LATENCY_MEASUREMENT_TIMEOUT_MS 60000  // Queries whose sounds are not playable after this time are not measured (see SourceSampler::reportQueryLatencyIfReady)
 
 #ifndef SOURCE_APP_DIRECTORY_NAME
 #define SOURCE_APP_DIRECTORY_NAME "SourceSampler"  // Note this is ignored in ELK builds
@@ -78,10 +91,38 @@
 #define MAX_SAMPLE_LENGTH 300  // minutes maximum sample length
 
 #define MAX_DOWNLOAD_WAITING_TIME_MS 20000
+#define USE_FREESOUND_RESPONSE_DISK_CACHE 1  // Keep responses of Freesound API requests on disk so these can be re-used in later sessions and when offline (see FSResponseCache)
 #define MAX_SIZE_FOR_ORIGINAL_FILE_DOWNLOAD 1024 * 1024 * 15  // 15 MB
+#define DOWNLOAD_SCHEDULER_NUM_WORKERS 4  // Maximum number of sound downloads running at the same time (see DownloadScheduler.h)
+#define DOWNLOAD_SCHEDULER_MAX_DOWNLOADS_PER_HOST 2  // Maximum number of sound downloads running at the same time from the same host
+#define DOWNLOAD_SCHEDULER_MAX_ATTEMPTS 5  // Failed downloads are retried until this number of attempts...
+#define DOWNLOAD_SCHEDULER_RETRY_BASE_DELAY_MS 500  // ...waiting this time before the first retry, and doubling it after every attempt
+#define DOWNLOAD_SCHEDULER_IDLE_WAIT_MS 100
+#define DOWNLOAD_SCHEDULER_BUFFER_SIZE 65536
+#define ENABLE_PROVISIONAL_SOUNDS 1  // Make OGG previews playable while they download by decoding the already downloaded part (see SourceSound::createProvisionalSourceSamplerSoundIfPossible)
+#define PROVISIONAL_SOUND_MIN_BYTES 32768  // Don't try to decode partially downloaded files smaller than this
+#define FREESOUND_CANDIDATE_POOL_NUM_PREFETCH 8  // Number of previews of unused query results downloaded in advance (see FreesoundCandidatePool)
+#define FREESOUND_CANDIDATE_POOL_MAX_PARALLEL_PREFETCH 2
+#define FREESOUND_CANDIDATE_POOL_MAX_PREFETCH_MB 20  // Disk budget for the previews of unused results of the current and previous queries (oldest are deleted first)
 
 #define ENABLE_DEBUG_BUFFER 0  // User as a debugging trick for outputting some audio to a file
 
+#define FILTER_MODULATION_CONTROL_RATE 16  // Filter envelope and cutoff are computed every N samples, filter coefficients are interpolated in between
+#define VOICE_SILENCE_THRESHOLD_DB -96  // Voices with decaying envelopes are stopped when their level goes below this threshold, and filter and gain are not processed in blocks where the level stays below it
+#define REVERB_TAIL_SILENCE_THRESHOLD_DB -90  // When no voice sends to the reverb, reverb stops processing once its output stays below this level...
+#define REVERB_TAIL_SILENCE_HOLD_MS 100  // ...for this amount of time
+#ifndef PARALLEL_VOICE_RENDERING
+#define PARALLEL_VOICE_RENDERING 0  // Render voices in a pool of worker threads (see VoiceRenderWorkerPool.h)
+#endif
+#define NUM_VOICE_RENDER_WORKERS 3  // Number of worker threads used for parallel voice rendering (the audio thread also renders voices)
+#define VOICE_RENDER_PARALLEL_MIN_NUM_SAMPLES 64  // Sub-blocks shorter than this are rendered in the audio thread only (waking up workers is not worth it)
+#define VOICE_RENDER_WORKER_SPIN_ITERATIONS 20000  // Workers spin this many times waiting for new work before going to sleep
+#define VOICE_RENDER_LATE_WORKERS_FRACTION 0.5  // If the audio thread waits for workers longer than this fraction of the block duration...
+#define VOICE_RENDER_FALLBACK_NUM_BLOCKS 256  // ...voices are rendered in the audio thread only for this number of blocks
+#define MIDI_FROM_EDITOR_MAX_PENDING_MESSAGES 256  // Maximum number of MIDI messages from the editor/UI waiting to be added to the next block
+#define MIDI_EVENTS_MIN_RENDER_SUBDIVISION 8  // Voices split rendering at MIDI events positions, but don't render sub-blocks smaller than this number of samples
+#define NUM_OUTPUT_BUSES 8  // Number of stereo output buses (main output + auxiliary outputs), sounds are routed to a bus with the "outputBus" parameter
+
 
 // Global actions
 #define ACTION_GET_STATE "/get_state"
@@ -217,6 +258,8 @@ inline float velSensitivity = 1.0f;
 inline int midiChannel = 0;
 inline float pitchShift = 0.0f;
 inline float timeStretch = 1.0f;
+inline int outputBus = 0;
+inline float reverbSend = 1.0f;
 // --> End auto-generated code A
 
 inline float sampleStartPosition = -1.0f;
@@ -248,6 +291,8 @@ DECLARE_ID (SOUND)
 DECLARE_ID (MIDI_CC_MAPPING)
 DECLARE_ID (SOUND_SAMPLE)
 DECLARE_ID (ANALYSIS)
+DECLARE_ID (pendingAnalysisFile)
+DECLARE_ID (pendingAnalysisSoundIndex)
 DECLARE_ID (GLOBAL_SETTINGS)
 DECLARE_ID (VOLATILE_STATE)
 
@@ -345,6 +390,8 @@ DECLARE_ID (velSensitivity)
 DECLARE_ID (midiChannel)
 DECLARE_ID (pitchShift)
 DECLARE_ID (timeStretch)
+DECLARE_ID (outputBus)
+DECLARE_ID (reverbSend)
 // --> End auto-generated code B
 
 DECLARE_ID (sampleStartPosition)
@@ -361,6 +408,122 @@ DECLARE_ID (voiceActivations)
 DECLARE_ID (voiceSoundIdxs)
 DECLARE_ID (voiceSoundPlayPosition)
 DECLARE_ID (audioLevels)
+DECLARE_ID (numSkippedVoiceBlocks)
+DECLARE_ID (stateRestoreProgress)
+DECLARE_ID (queryToFirstSoundPlayableMs)
 
 #undef DECLARE_ID
 }
+
+// Numeric IDs of the sound parameters. These are used to address parameters in the parameter store of SourceSound
+// and in the MIDI CC tables, so the audio thread does not need to compare Identifiers.
+enum class ParamId
+{
+    // --> Start auto-generated code C
+    launchMode,
+    startPosition,
+    endPosition,
+    loopStartPosition,
+    loopEndPosition,
+    loopXFadeNSamples,
+    reverse,
+    noteMappingMode,
+    numSlices,
+    playheadPosition,
+    freezePlayheadSpeed,
+    filterCutoff,
+    filterRessonance,
+    filterKeyboardTracking,
+    filterAttack,
+    filterDecay,
+    filterSustain,
+    filterRelease,
+    filterADSR2CutoffAmt,
+    gain,
+    attack,
+    decay,
+    sustain,
+    release,
+    pan,
+    pitch,
+    pitchBendRangeUp,
+    pitchBendRangeDown,
+    mod2CutoffAmt,
+    mod2GainAmt,
+    mod2PitchAmt,
+    mod2PlayheadPos,
+    vel2CutoffAmt,
+    vel2GainAmt,
+    velSensitivity,
+    midiChannel,
+    pitchShift,
+    timeStretch,
+    outputBus,
+    reverbSend,
+    // --> End auto-generated code C
+    numParams
+};
+
+// Name, range, default value and type of each sound parameter, indexed by ParamId. Parameter names are the same as
+// the SourceIDs identifiers so these can be used to map names from the UI/actions to ParamId.
+struct ParamInfo
+{
+    const char* name;
+    float minValue;
+    float maxValue;
+    float defaultValue;
+    bool isInteger;
+};
+
+constexpr ParamInfo paramInfos[] =
+{
+    // --> Start auto-generated code D
+    { "launchMode", 0.0f, 4.0f, 0.0f, true },
+    { "startPosition", 0.0f, 1.0f, 0.0f, false },
+    { "endPosition", 0.0f, 1.0f, 1.0f, false },
+    { "loopStartPosition", 0.0f, 1.0f, 0.0f, false },
+    { "loopEndPosition", 0.0f, 1.0f, 1.0f, false },
+    { "loopXFadeNSamples", 10.0f, 100000.0f, 500.0f, true },
+    { "reverse", 0.0f, 1.0f, 0.0f, true },
+    { "noteMappingMode", 0.0f, 3.0f, 0.0f, true },
+    { "numSlices", 0.0f, 100.0f, 0.0f, true },
+    { "playheadPosition", 0.0f, 1.0f, 0.0f, false },
+    { "freezePlayheadSpeed", 1.0f, 5000.0f, 100.0f, false },
+    { "filterCutoff", 10.0f, 20000.0f, 20000.0f, false },
+    { "filterRessonance", 0.0f, 1.0f, 0.0f, false },
+    { "filterKeyboardTracking", 0.0f, 1.0f, 0.0f, false },
+    { "filterAttack", 0.0f, 1.0f, 0.01f, false },
+    { "filterDecay", 0.0f, 1.0f, 0.0f, false },
+    { "filterSustain", 0.0f, 1.0f, 1.0f, false },
+    { "filterRelease", 0.0f, 1.0f, 0.01f, false },
+    { "filterADSR2CutoffAmt", 0.0f, 100.0f, 1.0f, false },
+    { "gain", -80.0f, 12.0f, -10.0f, false },
+    { "attack", 0.0f, 1.0f, 0.01f, false },
+    { "decay", 0.0f, 1.0f, 0.0f, false },
+    { "sustain", 0.0f, 1.0f, 1.0f, false },
+    { "release", 0.0f, 1.0f, 0.01f, false },
+    { "pan", -1.0f, 1.0f, 0.0f, false },
+    { "pitch", -36.0f, 36.0f, 0.0f, false },
+    { "pitchBendRangeUp", 0.0f, 36.0f, 12.0f, false },
+    { "pitchBendRangeDown", 0.0f, 36.0f, 12.0f, false },
+    { "mod2CutoffAmt", 0.0f, 100.0f, 10.0f, false },
+    { "mod2GainAmt", -12.0f, 12.0f, 6.0f, false },
+    { "mod2PitchAmt", -12.0f, 12.0f, 0.0f, false },
+    { "mod2PlayheadPos", 0.0f, 1.0f, 0.0f, false },
+    { "vel2CutoffAmt", 0.0f, 100.0f, 0.0f, false },
+    { "vel2GainAmt", 0.0f, 1.0f, 0.5f, false },
+    { "velSensitivity", 0.0f, 6.0f, 1.0f, false },
+    { "midiChannel", 0.0f, 16.0f, 0.0f, true },
+    { "pitchShift", -36.0f, 36.0f, 0.0f, false },
+    { "timeStretch", 0.1f, 4.0f, 1.0f, false },
+    { "outputBus", 0.0f, 7.0f, 0.0f, true },
+    { "reverbSend", 0.0f, 1.0f, 1.0f, false },
+    // --> End auto-generated code D
+};
+
+static_assert (sizeof (paramInfos) / sizeof (ParamInfo) == (size_t)ParamId::numParams, "paramInfos must have one entry per ParamId");
+
+inline const ParamInfo& getParamInfo (ParamId paramId) noexcept
+{
+    return paramInfos[(size_t)paramId];
+}
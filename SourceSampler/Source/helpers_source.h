@@ -222,6 +222,8 @@ namespace SourceHelpers
         sound.setProperty (SourceIDs::midiChannel, 0, nullptr);
         sound.setProperty (SourceIDs::pitchShift, 0.0f, nullptr);
         sound.setProperty (SourceIDs::timeStretch, 1.0f, nullptr);
+        sound.setProperty (SourceIDs::outputBus, 0, nullptr);
+        sound.setProperty (SourceIDs::reverbSend, 1.0f, nullptr);
         // --> End auto-generated code A
         return sound;
     }
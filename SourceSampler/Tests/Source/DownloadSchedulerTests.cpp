@@ -0,0 +1,241 @@
+/*
+  ==============================================================================
+
+    DownloadSchedulerTests.cpp
+    Created: 19 Oct 2026 10:58:03pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "DownloadScheduler.h"
+#include "LocalHttpServer.h"
+
+
+//==============================================================================
+// Tests of DownloadScheduler against a LocalHttpServer: completion, retries, resuming, per-host limits and cancellation
+// of downloads stuck waiting for the server.
+
+class DownloadSchedulerTests: public juce::UnitTest
+{
+public:
+    DownloadSchedulerTests(): juce::UnitTest ("DownloadScheduler", "Downloads") {}
+
+    void initialise() override
+    {
+        downloadLocation = juce::File::getSpecialLocation (juce::File::tempDirectory).getNonexistentChildFile ("SourceSamplerTestsDownloads", "");
+        downloadLocation.createDirectory();
+    }
+
+    void shutdown() override
+    {
+        downloadLocation.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        juce::MemoryBlock fileContents = createFileContents (256 * 1024);
+
+        beginTest ("Downloads a file");
+        {
+            LocalHttpServer server ([&](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response;
+                response.body = fileContents;
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            juce::File target = downloadLocation.getChildFile ("complete.ogg");
+            scheduler.addDownload (juce::URL (server.getBaseUrl() + "/complete.ogg"), target, "", DownloadScheduler::defaultPriority, &listener);
+            expect (listener.waitForFinishedDownloads (1, 5000));
+            expectEquals (listener.getNumSucceeded(), 1);
+            expect (fileEquals (target, fileContents));
+            expect (!DownloadScheduler::getPartialFileLocation (target).existsAsFile());
+        }
+
+        beginTest ("Retries after server errors");
+        {
+            LocalHttpServer server ([&](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response;
+                if (++numServerErrorRequests <= 2){
+                    response.statusCode = 503;
+                } else {
+                    response.body = fileContents;
+                }
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            juce::File target = downloadLocation.getChildFile ("retried.ogg");
+            scheduler.addDownload (juce::URL (server.getBaseUrl() + "/retried.ogg"), target, "", DownloadScheduler::defaultPriority, &listener);
+            expect (listener.waitForFinishedDownloads (1, 10000));
+            expectEquals (listener.getNumSucceeded(), 1);
+            expectEquals (server.getNumRequests(), 3);
+            expect (fileEquals (target, fileContents));
+        }
+
+        beginTest ("Does not retry client errors");
+        {
+            LocalHttpServer server ([&](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response;
+                response.statusCode = 404;
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            scheduler.addDownload (juce::URL (server.getBaseUrl() + "/missing.ogg"), downloadLocation.getChildFile ("missing.ogg"), "", DownloadScheduler::defaultPriority, &listener);
+            expect (listener.waitForFinishedDownloads (1, 5000));
+            expectEquals (listener.getNumSucceeded(), 0);
+            expectEquals (server.getNumRequests(), 1);
+        }
+
+        beginTest ("Resumes dropped downloads with a Range request");
+        {
+            const int dropAfterBytes = 100 * 1024;
+            LocalHttpServer server ([&](const LocalHttpServer::Request& request){
+                LocalHttpServer::Response response;
+                response.body = fileContents;
+                if (request.rangeStart < 0){
+                    response.closeAfterBytes = dropAfterBytes;
+                }
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            juce::File target = downloadLocation.getChildFile ("resumed.ogg");
+            scheduler.addDownload (juce::URL (server.getBaseUrl() + "/resumed.ogg"), target, "", DownloadScheduler::defaultPriority, &listener);
+            expect (listener.waitForFinishedDownloads (1, 10000));
+            expectEquals (listener.getNumSucceeded(), 1);
+            expectEquals (server.getNumRequests(), 2);
+            expectEquals (server.getLastRequest().rangeStart, (juce::int64)dropAfterBytes);
+            expect (fileEquals (target, fileContents));
+        }
+
+        beginTest ("Limits concurrent downloads per host");
+        {
+            LocalHttpServer server ([&](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response;
+                response.body = fileContents;
+                response.delayMs = 200;
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            const int numFiles = 6;
+            for (int i=0; i<numFiles; i++){
+                juce::String filename = "limited" + juce::String (i) + ".ogg";
+                scheduler.addDownload (juce::URL (server.getBaseUrl() + "/" + filename), downloadLocation.getChildFile (filename), "", DownloadScheduler::defaultPriority, &listener);
+            }
+            expect (listener.waitForFinishedDownloads (numFiles, 10000));
+            expectEquals (listener.getNumSucceeded(), numFiles);
+            expect (server.getMaxNumConcurrentConnections() <= DOWNLOAD_SCHEDULER_MAX_DOWNLOADS_PER_HOST);
+        }
+
+        beginTest ("Cancelling a stalled download returns without waiting for the server");
+        {
+            LocalHttpServer server ([&](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response;
+                response.body = fileContents;
+                response.stallAfterBytes = 16 * 1024;
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            juce::File target = downloadLocation.getChildFile ("stalled.ogg");
+            scheduler.addDownload (juce::URL (server.getBaseUrl() + "/stalled.ogg"), target, "", DownloadScheduler::defaultPriority, &listener);
+            while (!DownloadScheduler::getPartialFileLocation (target).existsAsFile()){
+                juce::Thread::sleep (5);
+            }
+            juce::Thread::sleep (200);  // Let the worker block in read waiting for the data the server does not send
+            double startTime = juce::Time::getMillisecondCounterHiRes();
+            scheduler.cancelDownloads (&listener);
+            double cancelTimeMs = juce::Time::getMillisecondCounterHiRes() - startTime;
+            logMessage ("  Cancelled stalled download in " + juce::String (cancelTimeMs, 1) + " ms");
+            expect (cancelTimeMs < 1000.0);
+            expectEquals (listener.getNumFinished(), 0);
+            expect (DownloadScheduler::getPartialFileLocation (target).existsAsFile());  // Kept to resume later
+            server.releaseStalledConnections();
+        }
+
+        beginTest ("Cancelling a download waiting for the server to respond returns without waiting for the server");
+        {
+            LocalHttpServer server ([&](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response;
+                response.body = fileContents;
+                response.delayMs = MAX_DOWNLOAD_WAITING_TIME_MS;
+                return response;
+            });
+            expect (server.start());
+            DownloadScheduler scheduler;
+            TestListener listener;
+            scheduler.addDownload (juce::URL (server.getBaseUrl() + "/slow.ogg"), downloadLocation.getChildFile ("slow.ogg"), "", DownloadScheduler::defaultPriority, &listener);
+            while (server.getNumRequests() == 0){
+                juce::Thread::sleep (5);
+            }
+            double startTime = juce::Time::getMillisecondCounterHiRes();
+            scheduler.cancelDownloads (&listener);
+            double cancelTimeMs = juce::Time::getMillisecondCounterHiRes() - startTime;
+            logMessage ("  Cancelled download waiting for response in " + juce::String (cancelTimeMs, 1) + " ms");
+            expect (cancelTimeMs < 1000.0);
+            expectEquals (listener.getNumFinished(), 0);
+        }
+    }
+
+private:
+    class TestListener: public DownloadScheduler::Listener
+    {
+    public:
+        void scheduledDownloadProgress (const juce::File&, juce::int64, juce::int64) override {}
+
+        void scheduledDownloadFinished (const juce::File&, bool success) override
+        {
+            numFinished += 1;
+            numSucceeded += success ? 1 : 0;
+        }
+
+        bool waitForFinishedDownloads (int numDownloads, int timeoutMs)
+        {
+            double endTimeMs = juce::Time::getMillisecondCounterHiRes() + timeoutMs;
+            while (numFinished.load() < numDownloads){
+                if (juce::Time::getMillisecondCounterHiRes() > endTimeMs){
+                    return false;
+                }
+                juce::Thread::sleep (5);
+            }
+            return true;
+        }
+
+        int getNumFinished() { return numFinished.load(); }
+        int getNumSucceeded() { return numSucceeded.load(); }
+
+    private:
+        std::atomic<int> numFinished { 0 };
+        std::atomic<int> numSucceeded { 0 };
+    };
+
+    static juce::MemoryBlock createFileContents (int numBytes)
+    {
+        juce::MemoryBlock contents ((size_t)numBytes);
+        juce::Random random (42);
+        random.fillBitsRandomly (contents.getData(), contents.getSize());
+        return contents;
+    }
+
+    static bool fileEquals (const juce::File& file, const juce::MemoryBlock& contents)
+    {
+        juce::MemoryBlock fileContents;
+        return file.loadFileAsData (fileContents) && fileContents == contents;
+    }
+
+    juce::File downloadLocation;
+    std::atomic<int> numServerErrorRequests { 0 };
+};
+
+static DownloadSchedulerTests downloadSchedulerTests;
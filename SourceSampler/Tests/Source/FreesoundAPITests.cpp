@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+    FreesoundAPITests.cpp
+    Created: 19 Oct 2026 11:36:25pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "FreesoundAPI.h"
+#include "LocalHttpServer.h"
+
+
+//==============================================================================
+// Tests of FSResponseCache through FreesoundClient requests to a LocalHttpServer simulating Freesound (URIS::BASE is
+// pointed to it). The passing of time is simulated with FSResponseCache::setTimeSource.
+
+class FSResponseCacheTests: public juce::UnitTest
+{
+public:
+    FSResponseCacheTests(): juce::UnitTest ("FSResponseCache", "Freesound") {}
+
+    void initialise() override
+    {
+        originalBase = URIS::BASE;
+        nowMs = juce::Time::currentTimeMillis();
+        FSResponseCache::getSharedInstance().setTimeSource ([this]{ return nowMs.load(); });
+    }
+
+    void shutdown() override
+    {
+        FSResponseCache::getSharedInstance().setTimeSource (nullptr);
+        URIS::BASE = originalBase;
+    }
+
+    void runTest() override
+    {
+        FreesoundClient client ("testToken");
+        const juce::int64 searchTimeToLiveMs = (juce::int64)FREESOUND_CACHE_TTL_SEARCH_SECONDS * 1000;
+
+        LocalHttpServer server ([](const LocalHttpServer::Request&){ return createSearchResponse(); });
+        expect (server.start());
+        URIS::BASE = server.getBaseUrl() + "/apiv2";
+
+        beginTest ("Fresh responses are served from the cache");
+        {
+            expectEquals (client.textSearch ("piano").getCount(), 2);
+            nowMs += searchTimeToLiveMs / 2;
+            SoundList results = client.textSearch ("piano");
+            expectEquals (server.getNumRequests(), 1);
+            expectEquals (results.getCount(), 2);
+            expectEquals (results.toArrayOfSounds().size(), 2);
+            expectEquals (results.toArrayOfSounds()[0].name, juce::String ("Piano C4"));
+        }
+
+        beginTest ("Expired responses are requested again");
+        {
+            nowMs += searchTimeToLiveMs;
+            expectEquals (client.textSearch ("piano").getCount(), 2);
+            expectEquals (server.getNumRequests(), 2);
+        }
+
+        beginTest ("Expired responses are used if Freesound can't be reached");
+        {
+            server.stop();
+            nowMs += searchTimeToLiveMs * 2;
+            SoundList results = client.textSearch ("piano");
+            expectEquals (results.getCount(), 2);
+            expectEquals (results.toArrayOfSounds().size(), 2);
+        }
+
+        beginTest ("Responses older than the maximum stale time are not used");
+        {
+            nowMs += (juce::int64)FREESOUND_CACHE_MAX_STALE_SECONDS * 1000;
+            SoundList results = client.textSearch ("piano");
+            expectEquals (results.getCount(), 0);
+            expectEquals (results.toArrayOfSounds().size(), 0);
+        }
+
+        beginTest ("Expired responses are used if Freesound returns server errors");
+        {
+            std::atomic<int> numRequests { 0 };
+            LocalHttpServer failingServer ([&numRequests](const LocalHttpServer::Request&){
+                LocalHttpServer::Response response = createSearchResponse();
+                if (++numRequests > 1){
+                    response.statusCode = 503;
+                    response.body.reset();
+                }
+                return response;
+            });
+            expect (failingServer.start());
+            URIS::BASE = failingServer.getBaseUrl() + "/apiv2";
+            expectEquals (client.textSearch ("drums").getCount(), 2);
+            nowMs += searchTimeToLiveMs * 2;
+            SoundList results = client.textSearch ("drums");
+            expectEquals (failingServer.getNumRequests(), 2);
+            expectEquals (results.getCount(), 2);
+        }
+
+        beginTest ("Requests with different parameters are cached separately");
+        {
+            LocalHttpServer otherServer ([](const LocalHttpServer::Request&){ return createSearchResponse(); });
+            expect (otherServer.start());
+            URIS::BASE = otherServer.getBaseUrl() + "/apiv2";
+            client.textSearch ("bass");
+            client.textSearch ("bass", "duration:[0 TO 1]");
+            client.textSearch ("bass");
+            expectEquals (otherServer.getNumRequests(), 2);
+        }
+
+        beginTest ("Time to live of endpoints");
+        {
+            expectEquals (FSResponseCache::getTimeToLiveSeconds (URIS::uri (URIS::TEXT_SEARCH, {})), FREESOUND_CACHE_TTL_SEARCH_SECONDS);
+            expectEquals (FSResponseCache::getTimeToLiveSeconds (URIS::uri (URIS::SIMILAR_SOUNDS, { "1234" })), FREESOUND_CACHE_TTL_SEARCH_SECONDS);
+            expectEquals (FSResponseCache::getTimeToLiveSeconds (URIS::uri (URIS::SOUND, { "1234" })), FREESOUND_CACHE_TTL_SOUND_SECONDS);
+            expectEquals (FSResponseCache::getTimeToLiveSeconds (URIS::uri (URIS::SOUND_ANALYSIS, { "1234" })), FREESOUND_CACHE_TTL_ANALYSIS_SECONDS);
+            expectEquals (FSResponseCache::getTimeToLiveSeconds (URIS::uri (URIS::ME, {})), 0);
+            expectEquals (FSResponseCache::getTimeToLiveSeconds (URIS::uri (URIS::DOWNLOAD, { "1234" })), 0);
+        }
+    }
+
+private:
+    static LocalHttpServer::Response createSearchResponse()
+    {
+        LocalHttpServer::Response response;
+        response.contentType = "application/json";
+        response.acceptsRanges = false;
+        juce::String json = R"({"count": 2, "next": null, "previous": null, "results": [)"
+                            R"({"id": 1001, "name": "Piano C4", "username": "user1", "license": "http://creativecommons.org/publicdomain/zero/1.0/"},)"
+                            R"({"id": 1002, "name": "Piano D4", "username": "user2", "license": "http://creativecommons.org/publicdomain/zero/1.0/"}]})";
+        response.body.append (json.toRawUTF8(), json.getNumBytesAsUTF8());
+        return response;
+    }
+
+    juce::String originalBase;
+    std::atomic<juce::int64> nowMs { 0 };
+};
+
+static FSResponseCacheTests fsResponseCacheTests;
@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    FreesoundCandidatePoolTests.cpp
+    Created: 20 Oct 2026 1:27:44am
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "FreesoundCandidatePool.h"
+#include "LocalHttpServer.h"
+
+
+//==============================================================================
+// Tests of the disk budget of the previews prefetched by FreesoundCandidatePool over several queries. Previews are
+// downloaded from a LocalHttpServer and evictPrefetchedPreviews is called in a loop, like SourceSampler's timer does.
+
+class FreesoundCandidatePoolTests: public juce::UnitTest
+{
+public:
+    FreesoundCandidatePoolTests(): juce::UnitTest ("FreesoundCandidatePool", "Downloads") {}
+
+    void initialise() override
+    {
+        downloadLocation = juce::File::getSpecialLocation (juce::File::tempDirectory).getNonexistentChildFile ("SourceSamplerTestsCandidatePool", "");
+        downloadLocation.createDirectory();
+    }
+
+    void shutdown() override
+    {
+        downloadLocation.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        juce::MemoryBlock previewContents ((size_t)previewSizeBytes, true);
+        LocalHttpServer server ([&](const LocalHttpServer::Request&){
+            LocalHttpServer::Response response;
+            response.body = previewContents;
+            return response;
+        });
+        expect (server.start());
+        baseUrl = server.getBaseUrl();
+        const juce::int64 maxPrefetchedBytes = (juce::int64)FREESOUND_CANDIDATE_POOL_MAX_PREFETCH_MB * 1024 * 1024;
+        const juce::int64 maxOvershootBytes = (juce::int64)FREESOUND_CANDIDATE_POOL_MAX_PARALLEL_PREFETCH * previewSizeBytes;  // Downloads started just before reaching the budget
+        FreesoundCandidatePool candidatePool;
+        juce::String soundInUse;
+
+        beginTest ("Prefetching stops when the budget is reached");
+        {
+            juce::Array<FSSound> candidates = createCandidates (1000);
+            prefetch (candidatePool, "first|", candidates, soundInUse);
+            int numPrefetched = getNumPreviewsInDisk (candidates);
+            expect (numPrefetched > 0 && numPrefetched < FREESOUND_CANDIDATE_POOL_NUM_PREFETCH);
+            expect (getPreviewsSizeInDisk() <= maxPrefetchedBytes + maxOvershootBytes);
+            soundInUse = candidates.getReference (0).id;  // As if a later query returned it and loaded it
+        }
+
+        beginTest ("Previews of previous queries are evicted to make room for the new ones");
+        {
+            juce::Array<FSSound> previousCandidates = createCandidates (1000);
+            juce::Array<FSSound> candidates = createCandidates (2000);
+            prefetch (candidatePool, "second|", candidates, soundInUse);
+            expect (getNumPreviewsInDisk (candidates) > 0);
+            expect (getPreviewLocation (soundInUse).existsAsFile());
+            for (int i=1; i<previousCandidates.size(); i++){
+                expect (!getPreviewLocation (previousCandidates.getReference (i).id).existsAsFile());
+            }
+            expect (getPreviewsSizeInDisk() - previewSizeBytes <= maxPrefetchedBytes + maxOvershootBytes);
+        }
+
+        beginTest ("Taken candidates are not evicted");
+        {
+            juce::Array<FSSound> taken;
+            int numResults = 0;
+            expect (candidatePool.takeCandidates ("second|", 1, taken, numResults));
+            juce::File takenPreview = getPreviewLocation (taken.getReference (0).id);
+            expect (takenPreview.existsAsFile());
+            prefetch (candidatePool, "third|", createCandidates (3000), soundInUse);
+            expect (takenPreview.existsAsFile());
+            expect (getPreviewLocation (soundInUse).existsAsFile());
+            expect (getPreviewsSizeInDisk() - 2 * previewSizeBytes <= maxPrefetchedBytes + maxOvershootBytes);
+        }
+    }
+
+private:
+    void prefetch (FreesoundCandidatePool& candidatePool, const juce::String& queryKey, const juce::Array<FSSound>& candidates, const juce::String& soundInUse)
+    {
+        auto isSoundInUse = [soundInUse](const juce::String& soundId){ return soundId == soundInUse; };
+        candidatePool.setCandidates (queryKey, candidates.size(), candidates, downloadLocation);
+        candidatePool.evictPrefetchedPreviews (isSoundInUse);
+        candidatePool.startPrefetching();
+        // Done when nothing is being downloaded after an eviction which followed the last finished download
+        double endTimeMs = juce::Time::getMillisecondCounterHiRes() + 20000;
+        while (juce::Time::getMillisecondCounterHiRes() < endTimeMs){
+            candidatePool.evictPrefetchedPreviews (isSoundInUse);
+            if (!candidatePool.isPrefetching()){
+                candidatePool.evictPrefetchedPreviews (isSoundInUse);
+                if (!candidatePool.isPrefetching()){
+                    return;
+                }
+            }
+            juce::Thread::sleep (10);
+        }
+        expect (false, "Prefetching did not finish");
+    }
+
+    juce::Array<FSSound> createCandidates (int firstSoundId)
+    {
+        juce::Array<FSSound> candidates;
+        for (int i=0; i<FREESOUND_CANDIDATE_POOL_NUM_PREFETCH; i++){
+            juce::String soundId (firstSoundId + i);
+            juce::var sound = juce::JSON::parse ("{\"id\": " + soundId + ", \"name\": \"Sound " + soundId + "\", \"previews\": {\"preview-hq-ogg\": \"" + baseUrl + "/previews/" + soundId + ".ogg\"}}");
+            candidates.add (FSSound (sound));
+        }
+        return candidates;
+    }
+
+    juce::File getPreviewLocation (const juce::String& soundId)
+    {
+        return downloadLocation.getChildFile (soundId).withFileExtension ("ogg");
+    }
+
+    int getNumPreviewsInDisk (const juce::Array<FSSound>& sounds)
+    {
+        int numPreviews = 0;
+        for (const auto& sound: sounds){
+            numPreviews += getPreviewLocation (sound.id).existsAsFile() ? 1 : 0;
+        }
+        return numPreviews;
+    }
+
+    juce::int64 getPreviewsSizeInDisk()
+    {
+        juce::int64 totalBytes = 0;
+        for (const auto& file: downloadLocation.findChildFiles (juce::File::findFiles, false)){
+            totalBytes += file.getSize();
+        }
+        return totalBytes;
+    }
+
+    static constexpr int previewSizeBytes = 4 * 1024 * 1024;
+
+    juce::File downloadLocation;
+    juce::String baseUrl;
+};
+
+static FreesoundCandidatePoolTests freesoundCandidatePoolTests;
@@ -0,0 +1,298 @@
+/*
+  ==============================================================================
+
+    LocalHttpServer.h
+    Created: 19 Oct 2026 10:34:52pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+
+//==============================================================================
+// Minimal HTTP/1.1 server listening on a free port of 127.0.0.1, used by the tests to simulate Freesound and the servers
+// sounds are downloaded from. Each connection is served in its own thread and closed after one response, unless the
+// server is created with keepConnectionsAlive. Responses are created by a handler function which can also simulate slow
+// (delayMs), stalled (stallAfterBytes) and dropped (closeAfterBytes) connections. Range requests are served from the
+// response body when acceptsRanges is true.
+
+class LocalHttpServer: private juce::Thread
+{
+public:
+    struct Request
+    {
+        juce::String method;
+        juce::String path;  // Includes the query string
+        juce::StringPairArray headers;
+        juce::int64 rangeStart = -1;  // From the "Range: bytes=N-" header, -1 if not present
+    };
+
+    struct Response
+    {
+        int statusCode = 200;
+        juce::MemoryBlock body;
+        juce::String contentType = "application/octet-stream";
+        bool acceptsRanges = true;
+        int delayMs = 0;  // Wait before sending the response headers
+        int stallAfterBytes = -1;  // Stop sending data (without closing the connection) after this number of body bytes
+        int closeAfterBytes = -1;  // Close the connection after this number of body bytes
+    };
+
+    using Handler = std::function<Response (const Request&)>;
+
+    LocalHttpServer (Handler h, bool keepConnectionsAlive = false): juce::Thread ("LocalHttpServer"), handler (h), keepAlive (keepConnectionsAlive) {}
+
+    ~LocalHttpServer()
+    {
+        stop();
+    }
+
+    bool start()
+    {
+        if (!listener.createListener (0, "127.0.0.1")){
+            return false;
+        }
+        startThread();
+        return true;
+    }
+
+    // Closes the listening socket and all open connections (clients will get connection errors from now on)
+    void stop()
+    {
+        signalThreadShouldExit();
+        listener.close();
+        stopThread (2000);
+        const juce::ScopedLock sl (lock);
+        connections.clear();
+    }
+
+    juce::String getBaseUrl() const
+    {
+        return "http://127.0.0.1:" + juce::String (listener.getBoundPort());
+    }
+
+    int getNumRequests() const { return numRequests.load(); }
+    int getNumConnections() const { return numConnections.load(); }
+    int getMaxNumConcurrentConnections() const { return maxNumConcurrentConnections.load(); }
+
+    Request getLastRequest() const
+    {
+        const juce::ScopedLock sl (lock);
+        return lastRequest;
+    }
+
+    // Lets stalled connections go on sending data
+    void releaseStalledConnections() { stalledConnectionsReleased = true; }
+
+private:
+    class Connection: public juce::Thread
+    {
+    public:
+        Connection (LocalHttpServer& s, juce::StreamingSocket* sock): juce::Thread ("LocalHttpServerConnection"), server (s), socket (sock) {}
+
+        ~Connection()
+        {
+            signalThreadShouldExit();
+            socket->close();
+            stopThread (2000);
+        }
+
+        void run() override
+        {
+            server.numConnections += 1;
+            int numConcurrentConnections = ++server.numConcurrentConnections;
+            int maxNum = server.maxNumConcurrentConnections.load();
+            while (numConcurrentConnections > maxNum && !server.maxNumConcurrentConnections.compare_exchange_weak (maxNum, numConcurrentConnections)) {}
+
+            Request request;
+            while (readRequest (request)){
+                server.numRequests += 1;
+                {
+                    const juce::ScopedLock sl (server.lock);
+                    server.lastRequest = request;
+                }
+                if (!writeResponse (request, server.handler (request)) || !server.keepAlive){
+                    break;
+                }
+                request = Request();
+            }
+            socket->close();
+            server.numConcurrentConnections -= 1;
+        }
+
+    private:
+        bool readRequest (Request& request)
+        {
+            juce::MemoryOutputStream received;
+            char buffer[1024];
+            while (!received.toString().contains ("\r\n\r\n")){
+                int ready = socket->waitUntilReady (true, 100);
+                if (ready < 0 || threadShouldExit()){
+                    return false;
+                }
+                if (ready == 0){
+                    continue;
+                }
+                int numRead = socket->read (buffer, (int)sizeof (buffer), false);
+                if (numRead <= 0){
+                    return false;
+                }
+                received.write (buffer, (size_t)numRead);
+            }
+            juce::StringArray lines = juce::StringArray::fromLines (received.toString().upToFirstOccurrenceOf ("\r\n\r\n", false, false));
+            juce::StringArray requestLine = juce::StringArray::fromTokens (lines[0], " ", "");
+            request.method = requestLine[0];
+            request.path = requestLine[1];
+            for (int i=1; i<lines.size(); i++){
+                request.headers.set (lines[i].upToFirstOccurrenceOf (":", false, false).trim(), lines[i].fromFirstOccurrenceOf (":", false, false).trim());
+            }
+            juce::String range = request.headers.getValue ("Range", "");
+            if (range.startsWith ("bytes=")){
+                request.rangeStart = range.fromFirstOccurrenceOf ("=", false, false).upToFirstOccurrenceOf ("-", false, false).getLargeIntValue();
+            }
+            return true;
+        }
+
+        // Returns false if the response was not completely sent (and the connection must be closed)
+        bool writeResponse (const Request& request, const Response& response)
+        {
+            if (!waitMs (response.delayMs)){
+                return false;
+            }
+            int statusCode = response.statusCode;
+            juce::int64 totalSize = (juce::int64)response.body.getSize();
+            juce::int64 start = 0;
+            juce::String extraHeaders;
+            if (statusCode == 200 && response.acceptsRanges && request.rangeStart >= 0){
+                if (request.rangeStart >= totalSize){
+                    statusCode = 416;
+                    totalSize = 0;
+                } else {
+                    statusCode = 206;
+                    start = request.rangeStart;
+                    extraHeaders << "Content-Range: bytes " << start << "-" << (totalSize - 1) << "/" << totalSize << "\r\n";
+                }
+            }
+            juce::int64 contentLength = statusCode == 416 ? 0 : totalSize - start;
+            juce::String headers;
+            headers << "HTTP/1.1 " << statusCode << " " << getReasonPhrase (statusCode) << "\r\n"
+                    << "Content-Type: " << response.contentType << "\r\n"
+                    << "Content-Length: " << contentLength << "\r\n"
+                    << (response.acceptsRanges ? "Accept-Ranges: bytes\r\n" : "")
+                    << extraHeaders
+                    << (server.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+            if (!writeAll (headers.toRawUTF8(), (int)headers.getNumBytesAsUTF8())){
+                return false;
+            }
+
+            const char* data = static_cast<const char*> (response.body.getData()) + start;
+            juce::int64 bytesSent = 0;
+            while (bytesSent < contentLength){
+                if (response.closeAfterBytes >= 0 && bytesSent >= response.closeAfterBytes){
+                    return false;
+                }
+                if (response.stallAfterBytes >= 0 && bytesSent >= response.stallAfterBytes){
+                    while (!server.stalledConnectionsReleased){
+                        if (!waitMs (5)){
+                            return false;
+                        }
+                    }
+                }
+                int chunkSize = (int)juce::jmin ((juce::int64)4096, contentLength - bytesSent);
+                if (response.closeAfterBytes >= 0){
+                    chunkSize = (int)juce::jmin ((juce::int64)chunkSize, response.closeAfterBytes - bytesSent);
+                }
+                if (response.stallAfterBytes >= 0 && !server.stalledConnectionsReleased){
+                    chunkSize = (int)juce::jmin ((juce::int64)chunkSize, response.stallAfterBytes - bytesSent);
+                }
+                if (!writeAll (data + bytesSent, chunkSize)){
+                    return false;
+                }
+                bytesSent += chunkSize;
+            }
+            return true;
+        }
+
+        bool writeAll (const char* data, int numBytes)
+        {
+            int numWritten = 0;
+            while (numWritten < numBytes){
+                int n = socket->write (data + numWritten, numBytes - numWritten);
+                if (n <= 0 || threadShouldExit()){
+                    return false;
+                }
+                numWritten += n;
+            }
+            return true;
+        }
+
+        bool waitMs (int ms)
+        {
+            double endTimeMs = juce::Time::getMillisecondCounterHiRes() + ms;
+            while (juce::Time::getMillisecondCounterHiRes() < endTimeMs){
+                if (threadShouldExit()){
+                    return false;
+                }
+                juce::Thread::sleep (juce::jmin (5, ms));
+            }
+            return !threadShouldExit();
+        }
+
+        static juce::String getReasonPhrase (int statusCode)
+        {
+            switch (statusCode){
+                case 200: return "OK";
+                case 206: return "Partial Content";
+                case 404: return "Not Found";
+                case 416: return "Range Not Satisfiable";
+                case 429: return "Too Many Requests";
+                case 500: return "Internal Server Error";
+                case 503: return "Service Unavailable";
+                default: return "Unknown";
+            }
+        }
+
+        LocalHttpServer& server;
+        std::unique_ptr<juce::StreamingSocket> socket;
+    };
+
+    void run() override
+    {
+        while (!threadShouldExit()){
+            juce::StreamingSocket* socket = listener.waitForNextConnection();
+            if (socket == nullptr){
+                continue;  // Listener was closed (or failed), threadShouldExit will tell
+            }
+            const juce::ScopedLock sl (lock);
+            if (threadShouldExit()){
+                delete socket;
+                return;
+            }
+            // Connections that already finished are removed when new ones arrive
+            for (int i=connections.size(); --i>=0;){
+                if (!connections[i]->isThreadRunning()){
+                    connections.remove (i);
+                }
+            }
+            connections.add (new Connection (*this, socket))->startThread();
+        }
+    }
+
+    Handler handler;
+    const bool keepAlive;
+    juce::StreamingSocket listener;
+    juce::CriticalSection lock;  // Protects connections and lastRequest
+    juce::OwnedArray<Connection> connections;
+    Request lastRequest;
+    std::atomic<int> numRequests { 0 };
+    std::atomic<int> numConnections { 0 };
+    std::atomic<int> numConcurrentConnections { 0 };
+    std::atomic<int> maxNumConcurrentConnections { 0 };
+    std::atomic<bool> stalledConnectionsReleased { false };
+
+    JUCE_DECLARE_NON_COPYABLE (LocalHttpServer)
+};
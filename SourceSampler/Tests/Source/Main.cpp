@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 19 Oct 2026 9:41:17pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+
+//==============================================================================
+// Console runner for the tests of SOURCE (see "Running tests and benchmarks" in DEVELOPERS.md). With no arguments, all
+// tests except those in the "Benchmarks" category are run. If a category is given (e.g. "SourceSamplerTests Benchmarks"),
+// only the tests of that category are run. Returns a non-zero exit code if any test fails.
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;  // Some of the tested classes use timers and the message manager
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    if (argc > 1){
+        runner.runTestsInCategory (juce::String (argv[1]));
+    } else {
+        juce::Array<juce::UnitTest*> tests;
+        for (auto* test: juce::UnitTest::getAllTests()){
+            if (test->getCategory() != "Benchmarks"){
+                tests.add (test);
+            }
+        }
+        runner.runTests (tests);
+    }
+
+    int numFailures = 0;
+    for (int i=0; i<runner.getNumResults(); i++){
+        numFailures += runner.getResult(i)->failures;
+    }
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/*
+  ==============================================================================
+
+    PresetFileBenchmark.cpp
+    Created: 19 Oct 2026 9:52:40pm
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "helpers_source.h"
+#include "PresetFile.h"
+
+
+//==============================================================================
+// Compares the loading times of a big multisample preset saved in the legacy XML format and in the binary format of
+// PresetFile.h. The binary preset is read with and without analysis data (the latter is what SourceSampler does when
+// loading a preset, the analysis of each sound being attached later by its loader thread with attachPendingAnalysis).
+// Run with "SourceSamplerTests Benchmarks".
+
+class PresetFileBenchmark: public juce::UnitTest
+{
+public:
+    PresetFileBenchmark(): juce::UnitTest ("PresetFile load times", "Benchmarks") {}
+
+    void runTest() override
+    {
+        const int numSounds = 16;
+        const int numSamplesPerSound = 32;
+        const int numOnsetsPerSample = 64;
+        const int numIterations = 20;
+
+        juce::ValueTree preset = createBigMultisamplePreset (numSounds, numSamplesPerSound, numOnsetsPerSample);
+        juce::TemporaryFile xmlFile (".xml");
+        juce::TemporaryFile binaryFile ("." + juce::String(PRESET_FILE_EXTENSION));
+        preset.createXml()->writeTo (xmlFile.getFile());  // This is how presets were saved before the binary format
+        expect (PresetFile::writePresetState (preset, binaryFile.getFile()));
+        logMessage ("Preset with " + juce::String(numSounds) + " sounds x " + juce::String(numSamplesPerSound) + " samples x " + juce::String(numOnsetsPerSample) + " onsets");
+        logMessage ("  XML file size: " + juce::File::descriptionOfSizeInBytes (xmlFile.getFile().getSize()));
+        logMessage ("  Binary file size: " + juce::File::descriptionOfSizeInBytes (binaryFile.getFile().getSize()));
+
+        beginTest ("Loaded presets are equivalent");
+        {
+            juce::ValueTree fromXml = PresetFile::readPresetState (xmlFile.getFile(), true);
+            juce::ValueTree fromBinary = PresetFile::readPresetState (binaryFile.getFile(), true);
+            expect (fromBinary.isEquivalentTo (preset));
+            expectEquals (countOnsets (fromXml), numSounds * numSamplesPerSound * numOnsetsPerSample);
+
+            juce::ValueTree lazy = PresetFile::readPresetState (binaryFile.getFile(), false);
+            expectEquals (countOnsets (lazy), 0);
+            PresetFile::markAnalysisAsPending (lazy, binaryFile.getFile());
+            for (int i=0; i<lazy.getNumChildren(); i++){
+                PresetFile::attachPendingAnalysis (lazy.getChild(i));
+            }
+            expect (lazy.isEquivalentTo (preset));
+        }
+
+        beginTest ("Load times");
+        {
+            double xmlMs = averageTimeMs (numIterations, [&]{
+                PresetFile::readPresetState (xmlFile.getFile(), true);
+            });
+            double binaryWithAnalysisMs = averageTimeMs (numIterations, [&]{
+                PresetFile::readPresetState (binaryFile.getFile(), true);
+            });
+            double binaryWithoutAnalysisMs = averageTimeMs (numIterations, [&]{
+                PresetFile::readPresetState (binaryFile.getFile(), false);
+            });
+            double attachAnalysisPerSoundMs = averageTimeMs (numIterations, [&]{
+                juce::ValueTree lazy = PresetFile::readPresetState (binaryFile.getFile(), false);
+                PresetFile::markAnalysisAsPending (lazy, binaryFile.getFile());
+                PresetFile::attachPendingAnalysis (lazy.getChild(0));
+            }) - binaryWithoutAnalysisMs;
+            logMessage ("  Legacy XML: " + formatMs (xmlMs));
+            logMessage ("  Binary, including analysis: " + formatMs (binaryWithAnalysisMs));
+            logMessage ("  Binary, without analysis (message thread part of a preset load): " + formatMs (binaryWithoutAnalysisMs));
+            logMessage ("  Attaching analysis of one sound (loader thread part of a preset load): " + formatMs (attachAnalysisPerSoundMs));
+            logMessage ("  Speedup on the message thread: x" + juce::String(xmlMs / juce::jmax(binaryWithoutAnalysisMs, 0.001), 1));
+            expect (true);  // Timings are only reported
+        }
+    }
+
+private:
+    static juce::ValueTree createBigMultisamplePreset (int numSounds, int numSamplesPerSound, int numOnsetsPerSample)
+    {
+        juce::Random random (1234);
+        juce::ValueTree preset = SourceHelpers::createEmptyPresetState();
+        for (int i=0; i<numSounds; i++){
+            juce::ValueTree sound = SourceHelpers::createEmptySourceSoundState();
+            for (int j=0; j<numSamplesPerSound; j++){
+                juce::StringArray slices;
+                float onsetTime = 0.0f;
+                for (int k=0; k<numOnsetsPerSample; k++){
+                    onsetTime += 0.05f + random.nextFloat() * 0.2f;
+                    slices.add (juce::String(onsetTime));
+                }
+                int soundId = 100000 + i * numSamplesPerSound + j;
+                sound.addChild (SourceHelpers::createSourceSampleSoundState (soundId, "Sound " + juce::String(soundId), "username", "http://creativecommons.org/publicdomain/zero/1.0/",
+                                                                             "https://freesound.org/data/previews/" + juce::String(soundId) + "-hq.ogg", "", "wav", 1000000,
+                                                                             slices, 36 + j, 0), -1, nullptr);
+            }
+            preset.addChild (sound, -1, nullptr);
+        }
+        return preset;
+    }
+
+    static int countOnsets (const juce::ValueTree& state)
+    {
+        if (state.hasType (SourceIDs::onset)){
+            return 1;
+        }
+        int count = 0;
+        for (int i=0; i<state.getNumChildren(); i++){
+            count += countOnsets (state.getChild(i));
+        }
+        return count;
+    }
+
+    static double averageTimeMs (int numIterations, std::function<void()> f)
+    {
+        f();  // Warm up file cache
+        double startTime = juce::Time::getMillisecondCounterHiRes();
+        for (int i=0; i<numIterations; i++){
+            f();
+        }
+        return (juce::Time::getMillisecondCounterHiRes() - startTime) / numIterations;
+    }
+
+    static juce::String formatMs (double ms)
+    {
+        return juce::String(ms, 2) + " ms";
+    }
+};
+
+static PresetFileBenchmark presetFileBenchmark;
@@ -0,0 +1,242 @@
+/*
+  ==============================================================================
+
+    QueryLatencyBenchmark.cpp
+    Created: 20 Oct 2026 12:41:09am
+    Author:  Frederic Font Corbera
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "FreesoundAPI.h"
+#include "FreesoundCandidatePool.h"
+#include "DownloadScheduler.h"
+#include "LocalHttpServer.h"
+
+
+//==============================================================================
+// Benchmark of the time from a query until the first of its sounds could be played, i.e. until the preview of the first
+// result is in disk (decoding it takes the same time in all cases). Follows the steps of
+// SourceSampler::makeQueryAndLoadSounds against a LocalHttpServer simulating Freesound with apiLatencyMs and
+// previewLatencyMs of latency before each response, and compares:
+//  - a new query (the API request and the preview download),
+//  - a repeated query (search results from FSResponseCache),
+//  - a later action with the same query whose sound is taken from FreesoundCandidatePool (preview already prefetched),
+//  - an action which needs the next page of results, when this was requested in the background and when it wasn't.
+// It also reports the number of connections opened for the API requests (see FREESOUND_API_REUSE_CONNECTIONS).
+// The plugin reports the same measurement for real queries in the queryToFirstSoundPlayableMs volatile state property.
+
+class QueryLatencyBenchmark: public juce::UnitTest
+{
+public:
+    QueryLatencyBenchmark(): juce::UnitTest ("Query to first sound playable", "Benchmarks") {}
+
+    void initialise() override
+    {
+        originalBase = URIS::BASE;
+        downloadLocation = juce::File::getSpecialLocation (juce::File::tempDirectory).getNonexistentChildFile ("SourceSamplerQueryLatencyBenchmark", "");
+        downloadLocation.createDirectory();
+        previewContents.setSize (previewSizeBytes, true);
+    }
+
+    void shutdown() override
+    {
+        URIS::BASE = originalBase;
+        downloadLocation.deleteRecursively();
+    }
+
+    void runTest() override
+    {
+        LocalHttpServer server ([this](const LocalHttpServer::Request& request){ return handleRequest (request); }, true);
+        expect (server.start());
+        baseUrl = server.getBaseUrl();
+        URIS::BASE = baseUrl + "/apiv2";
+        FreesoundClient client ("testToken");
+
+        logMessage ("Simulated latency: " + juce::String (apiLatencyMs) + " ms for API requests, " + juce::String (previewLatencyMs) + " ms for previews, "
+                    + juce::String (previewSizeBytes / 1024) + " KB previews");
+
+        beginTest ("New query");
+        {
+            double totalMs = 0.0;
+            for (int i=0; i<numIterations; i++){
+                double startTimeMs = juce::Time::getMillisecondCounterHiRes();
+                SoundList list = client.textSearch ("new" + juce::String (i), "", "score", 0, -1, pageSize);
+                expect (list.getCount() > 0);
+                expect (downloadPreview (list.toArrayOfSounds().getReference (0)));
+                totalMs += juce::Time::getMillisecondCounterHiRes() - startTimeMs;
+            }
+            logMessage ("  New query: " + juce::String (totalMs / numIterations, 1) + " ms");
+        }
+
+        beginTest ("Repeated query");
+        {
+            client.textSearch ("repeated", "", "score", 0, -1, pageSize);
+            double totalMs = 0.0;
+            for (int i=0; i<numIterations; i++){
+                double startTimeMs = juce::Time::getMillisecondCounterHiRes();
+                SoundList list = client.textSearch ("repeated", "", "score", 0, -1, pageSize);
+                expect (downloadPreview (list.toArrayOfSounds().getReference (i)));
+                totalMs += juce::Time::getMillisecondCounterHiRes() - startTimeMs;
+            }
+            logMessage ("  Repeated query (cached results): " + juce::String (totalMs / numIterations, 1) + " ms");
+        }
+
+        beginTest ("Sounds from the candidate pool");
+        {
+            FreesoundCandidatePool candidatePool;
+            juce::String queryKey = "candidates|";
+            SoundList list = client.textSearch ("candidates", "", "score", 0, -1, pageSize);
+            juce::Array<FSSound> results = list.toArrayOfSounds();
+            results.remove (0);
+            candidatePool.setCandidates (queryKey, list.getCount(), results, downloadLocation);
+            candidatePool.startPrefetching();
+            expect (waitForPreviews (results, numIterations, 10000));
+
+            double totalMs = 0.0;
+            for (int i=0; i<numIterations; i++){
+                double startTimeMs = juce::Time::getMillisecondCounterHiRes();
+                juce::Array<FSSound> taken;
+                int numResults = 0;
+                expect (candidatePool.takeCandidates (queryKey, 1, taken, numResults));
+                expect (downloadPreview (taken.getReference (0)));
+                totalMs += juce::Time::getMillisecondCounterHiRes() - startTimeMs;
+            }
+            logMessage ("  Sound from the candidate pool (prefetched preview): " + juce::String (totalMs / numIterations, 1) + " ms");
+        }
+
+        beginTest ("Sounds from the next page of results");
+        {
+            double totalMs[2] = { 0.0, 0.0 };
+            for (int i=0; i<numIterations; i++){
+                for (int requestedInBackground=0; requestedInBackground<2; requestedInBackground++){
+                    juce::String query = "nextpage" + juce::String (i) + "_" + juce::String (requestedInBackground);
+                    SoundList list = client.textSearch (query, "", "score", 0, -1, pageSize);
+                    std::future<SoundList> nextPage;
+                    if (requestedInBackground == 1){
+                        nextPage = client.fetchNextPageAsync (list);
+                        juce::Thread::sleep (apiLatencyMs * 2);  // Sounds of the first page are loaded meanwhile
+                    }
+                    double startTimeMs = juce::Time::getMillisecondCounterHiRes();
+                    SoundList nextList = requestedInBackground == 1 ? nextPage.get() : client.fetchNextPage (list);
+                    expect (downloadPreview (nextList.toArrayOfSounds().getReference (0)));
+                    totalMs[requestedInBackground] += juce::Time::getMillisecondCounterHiRes() - startTimeMs;
+                }
+            }
+            logMessage ("  Sound from the next page, requested when needed: " + juce::String (totalMs[0] / numIterations, 1) + " ms");
+            logMessage ("  Sound from the next page, requested in the background: " + juce::String (totalMs[1] / numIterations, 1) + " ms");
+        }
+
+        beginTest ("Connections opened for API requests");
+        {
+            int numRequestsBefore = server.getNumRequests();
+            int numConnectionsBefore = server.getNumConnections();
+            for (int i=0; i<numIterations; i++){
+                client.textSearch ("connections" + juce::String (i), "", "score", 0, -1, pageSize);
+            }
+            int numRequests = server.getNumRequests() - numRequestsBefore;
+            int numConnections = server.getNumConnections() - numConnectionsBefore;
+            logMessage ("  " + juce::String (numConnections) + " connections opened for " + juce::String (numRequests) + " sequential API requests");
+            #if FREESOUND_API_REUSE_CONNECTIONS
+            expect (numConnections < numRequests);
+            #endif
+        }
+    }
+
+private:
+    LocalHttpServer::Response handleRequest (const LocalHttpServer::Request& request)
+    {
+        LocalHttpServer::Response response;
+        if (request.path.startsWith ("/previews/")){
+            response.delayMs = previewLatencyMs;
+            response.contentType = "audio/ogg";
+            response.body = previewContents;
+            return response;
+        }
+        // Search results (page 1, or the page given in the url of the next page). Sound ids are derived from the query
+        juce::URL url ("http://localhost" + request.path);
+        juce::String query = url.getParameterValues()[url.getParameterNames().indexOf ("query")];
+        int page = juce::jmax (1, url.getParameterValues()[url.getParameterNames().indexOf ("page")].getIntValue());
+        juce::int64 firstSoundId = (((juce::int64)query.hashCode() & 0xffffff) * 1000) + (page - 1) * pageSize;
+        juce::String json;
+        json << "{\"count\": " << numResults << ", \"previous\": null, \"next\": ";
+        if (page * pageSize < numResults){
+            json << "\"" << baseUrl << "/apiv2/search/text/?query=" << query << "&page_size=" << pageSize << "&page=" << (page + 1) << "\"";
+        } else {
+            json << "null";
+        }
+        json << ", \"results\": [";
+        for (int i=0; i<pageSize; i++){
+            juce::String soundId (firstSoundId + i);
+            json << (i > 0 ? ", " : "") << "{\"id\": " << soundId << ", \"name\": \"Sound " << soundId << "\", \"username\": \"user\", \"license\": \"http://creativecommons.org/publicdomain/zero/1.0/\", "
+                 << "\"previews\": {\"preview-hq-ogg\": \"" << baseUrl << "/previews/" << soundId << ".ogg\"}}";
+        }
+        json << "]}";
+        response.delayMs = apiLatencyMs;
+        response.contentType = "application/json";
+        response.acceptsRanges = false;
+        response.body.append (json.toRawUTF8(), json.getNumBytesAsUTF8());
+        return response;
+    }
+
+    // Downloads the preview of the sound the way SourceSound does for sounds mapped to notes. Returns once it is in disk
+    bool downloadPreview (FSSound& sound)
+    {
+        juce::File previewLocation = downloadLocation.getChildFile (sound.id).withFileExtension ("ogg");
+        if (previewLocation.existsAsFile()){
+            return true;
+        }
+        FinishedListener listener;
+        downloadScheduler->addDownload (sound.getOGGPreviewURL(), previewLocation, "", DownloadScheduler::mappedSoundPriority, &listener);
+        if (!listener.finished.wait (10000)){
+            downloadScheduler->cancelDownloads (&listener);
+            return false;
+        }
+        return listener.succeeded.load() && previewLocation.existsAsFile();
+    }
+
+    bool waitForPreviews (const juce::Array<FSSound>& sounds, int numPreviews, int timeoutMs)
+    {
+        double endTimeMs = juce::Time::getMillisecondCounterHiRes() + timeoutMs;
+        for (int i=0; i<numPreviews; i++){
+            while (!downloadLocation.getChildFile (sounds[i].id).withFileExtension ("ogg").existsAsFile()){
+                if (juce::Time::getMillisecondCounterHiRes() > endTimeMs){
+                    return false;
+                }
+                juce::Thread::sleep (5);
+            }
+        }
+        return true;
+    }
+
+    class FinishedListener: public DownloadScheduler::Listener
+    {
+    public:
+        void scheduledDownloadProgress (const juce::File&, juce::int64, juce::int64) override {}
+
+        void scheduledDownloadFinished (const juce::File&, bool success) override
+        {
+            succeeded = success;
+            finished.signal();
+        }
+
+        juce::WaitableEvent finished;
+        std::atomic<bool> succeeded { false };
+    };
+
+    static constexpr int numIterations = 5;
+    static constexpr int apiLatencyMs = 100;
+    static constexpr int previewLatencyMs = 100;
+    static constexpr int previewSizeBytes = 256 * 1024;
+    static constexpr int pageSize = 15;
+    static constexpr int numResults = 100;
+
+    juce::String originalBase;
+    juce::String baseUrl;
+    juce::File downloadLocation;
+    juce::MemoryBlock previewContents;
+    juce::SharedResourcePointer<DownloadScheduler> downloadScheduler;
+};
+
+static QueryLatencyBenchmark queryLatencyBenchmark;
@@ -26,79 +26,6 @@ def generate_code(controls_data_filename):
         }
         controls_list.append(control_data)
 
-    # Generate SourceSamplerSound paramter attributes assignation for setParameterByNameFloat and setParameterByNameFloatNorm
-    current_code = ''
-    for count, control_data in enumerate([control_data for control_data in controls_list if control_data['type'] in ['float']]):
-        iftag = 'else if' if count > 0 else 'if'
-        control_data.update({'iftag': iftag})
-        if control_data['type'] == 'float':
-            minf = float(control_data['min'])
-            maxf = float(control_data['max'])
-            control_data.update({'minf': minf, 'maxf': maxf})
-            current_code += '        {iftag} (identifier == SourceIDs::{name}) {{ {name} = !normed ? juce::jlimit({minf}f, {maxf}f, value) : juce::jmap(value, {minf}f, {maxf}f); }}\n'.format(**control_data)
-        else:
-            # Don't know what to do with other types
-            pass
-    current_code += '        '
-    code_dict['Source/SourceSamplerSound.cpp'] = {}
-    code_dict['Source/SourceSamplerSound.cpp']['B'] = current_code
-
-    # Generate SourceSamplerSound paramter attributes assignation for setParameterByNameInt
-    current_code = ''
-    for count, control_data in enumerate([control_data for control_data in controls_list if control_data['type'] == 'int']):
-        iftag = 'else if' if count > 0 else 'if'
-        control_data.update({'iftag': iftag})
-        if control_data['type'] == 'int':
-            mini = int(control_data['min'])
-            maxi = int(control_data['max'])
-            control_data.update({'mini': mini, 'maxi': maxi})
-            current_code += '        {iftag} (identifier == SourceIDs::{name}) {{ {name} = juce::jlimit({mini}, {maxi}, value); }}\n'.format(**control_data)  
-        else:
-            # Don't know what to do with other types
-            pass
-    current_code += '        '
-    code_dict['Source/SourceSamplerSound.cpp']['D'] = current_code
-
-     # Generate SourceSamplerSound attributes for getParameterFloat i getParameterInt
-    current_code_e = ''
-    current_code_f = ''
-    for count, control_data in enumerate([control_data for control_data in controls_list if control_data['type'] in ['float']]):
-        iftag = 'else if' if count > 0 else 'if'
-        minf = float(control_data['min'])
-        maxf = float(control_data['max'])
-        control_data.update({'minf': minf, 'maxf': maxf, 'iftag': iftag})
-        current_code_f += '        {iftag} (identifier == SourceIDs::{name}) {{ return !normed ? {name}.get() : juce::jmap({name}.get(), {minf}f, {maxf}f, 0.0f, 1.0f); }}\n'.format(**control_data)
-    for count, control_data in enumerate([control_data for control_data in controls_list if control_data['type'] in ['int']]):
-        iftag = 'else if' if count > 0 else 'if'
-        control_data.update({'iftag': iftag})
-        current_code_e += '        {iftag} (identifier == SourceIDs::{name}) {{ return {name}.get(); }}\n'.format(**control_data)
-        
-    current_code_e += '        '
-    current_code_f += '        '
-    code_dict['Source/SourceSamplerSound.cpp']['E'] = current_code_e
-    code_dict['Source/SourceSamplerSound.cpp']['F'] = current_code_f
-
-    # Generate SourceSamplerSound.h code to define parameters
-    current_code = ''
-    for count, control_data in enumerate([control_data for control_data in controls_list]):
-        if control_data['type'] == 'float':
-            current_code += "    juce::CachedValue<float> {name};\n".format(**control_data)
-        elif control_data['type'] == 'int':
-            current_code += "    juce::CachedValue<int> {name};\n".format(**control_data)
-        else:
-            # Don't know what to do with other types
-            pass
-    current_code += '    '
-    code_dict['Source/SourceSamplerSound.h'] = {}
-    code_dict['Source/SourceSamplerSound.h']['A'] = current_code
-
-    # Generate SourceSamplerSound.h code to bind state
-    current_code = ''
-    for count, control_data in enumerate([control_data for control_data in controls_list]):
-        current_code += "    SourceHelpers::addPropertyWithDefaultValueIfNotExisting(state, SourceIDs::{name}, SourceDefaults::{name});\n    {name}.referTo(state, SourceIDs::{name}, nullptr, SourceDefaults::{name});\n".format(**control_data)
-    current_code += '    '
-    code_dict['Source/SourceSamplerSound.cpp']['C'] = current_code
-
     # Generate defines.h code to define parameter IDs and defaults
     current_code_a = ''
     current_code_b = ''
@@ -119,6 +46,26 @@ def generate_code(controls_data_filename):
     code_dict['Source/defines_source.h']['A'] = current_code_a
     code_dict['Source/defines_source.h']['B'] = current_code_b
 
+    # Generate defines.h code for numeric parameter IDs
+    current_code = ''
+    for count, control_data in enumerate([control_data for control_data in controls_list]):
+        current_code += "    {name},\n".format(**control_data)
+    current_code += '    '
+    code_dict['Source/defines_source.h']['C'] = current_code
+
+    # Generate defines.h code for the table with name, range, default value and type of each parameter (indexed by ParamId)
+    current_code = ''
+    for count, control_data in enumerate([control_data for control_data in controls_list]):
+        control_data.update({
+            'minf': float(control_data['min']),
+            'maxf': float(control_data['max']),
+            'defaultf': float(control_data['default']),
+            'isInteger': 'true' if control_data['type'] == 'int' else 'false'
+        })
+        current_code += '    {{ "{name}", {minf}f, {maxf}f, {defaultf}f, {isInteger} }},\n'.format(**control_data)
+    current_code += '    '
+    code_dict['Source/defines_source.h']['D'] = current_code
+
     # Generate helpers_source.h code to include all sound parameters when creating an empry sound
     current_code_a = ''
     for count, control_data in enumerate([control_data for control_data in controls_list]):
@@ -1,4 +1,5 @@
 import os
+from xml.etree import ElementTree
 
 from freesound_api_key import FREESOUND_CLIENT_ID
 from freesound_interface import logout_from_freesound, is_logged_in, get_currently_logged_in_user
@@ -161,17 +162,28 @@ class HomeContextualMenuState(GoBackOnEncoderLongPressedStateMixin, MenuState):
         return frame_from_lines([self.get_default_header_line()] + lines)
 
     def get_exising_presets_list(self):
-        # Scan existing .xml files to know preset names
-        # TODO: the presetting system should be imporved so we don't need to scan the presets folder every time
+        # Preset names of binary preset files are read from the preset catalogue written by the plugin, legacy .xml
+        # preset files are scanned to know their names
         preset_names = {}
         presets_folder = self.spi.get_property(PlStateNames.PRESETS_DATA_LOCATION)
         if presets_folder is not None:
+            catalogue_path = os.path.join(presets_folder, 'catalogue.xml')
+            if os.path.exists(catalogue_path):
+                try:
+                    for entry in ElementTree.parse(catalogue_path).getroot().iter('PRESET_ENTRY'):
+                        preset_id = int(entry.get('index'))
+                        if os.path.exists(os.path.join(presets_folder, '{}.srcpreset'.format(preset_id))):
+                            preset_names[preset_id] = entry.get('name', 'noname')
+                except (ElementTree.ParseError, TypeError, ValueError):
+                    pass
             for filename in os.listdir(presets_folder):
                 if filename.endswith('.xml'):
                     try:
                         preset_id = int(filename.split('.xml')[0])
                     except ValueError:
-                        # Not a valid preset file
+                        # Not a valid preset file (e.g. the catalogue)
+                        continue
+                    if preset_id in preset_names:
                         continue
                     file_contents = open(os.path.join(presets_folder, filename), 'r').read()
                     try:
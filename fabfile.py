@@ -279,6 +279,46 @@ def compile_projucer(ctx):
         raise Exception('Unsupported compilation platform')
 
 
+def projucer_executable_path():
+    if platform.system() == 'Darwin':
+        return 'SourceSampler/3rdParty/JUCE/extras/Projucer/Builds/MacOSX/build/Release/Projucer.app/Contents/MacOS/Projucer'
+    elif platform.system() == 'Linux':
+        return 'SourceSampler/3rdParty/JUCE/extras/Projucer/Builds/LinuxMakefile/build/Projucer'
+    else:
+        raise Exception('Unsupported compilation platform')
+
+
+def compile_tests(configuration='Release'):
+    # Generate the build files of the tests console app (these are not committed) and compile it
+    print('Compiling SOURCE tests...')
+    print('*********************************************\n')
+    if not os.path.exists(projucer_executable_path()):
+        if platform.system() == 'Darwin':
+            compile_projucer_macos()
+        else:
+            compile_projucer_linux()
+    os.system("{} --resave SourceSampler/Tests/SourceSamplerTests.jucer".format(projucer_executable_path()))
+    if platform.system() == 'Darwin':
+        os.system("cd SourceSampler/Tests/Builds/MacOSX/;xcodebuild -configuration {0}".format(configuration))
+        return 'SourceSampler/Tests/Builds/MacOSX/build/{0}/SourceSamplerTests'.format(configuration)
+    else:
+        os.system("cd SourceSampler/Tests/Builds/LinuxMakefile;make CONFIG={} -j4".format(configuration))
+        return 'SourceSampler/Tests/Builds/LinuxMakefile/build/SourceSamplerTests'
+
+
+@task
+def run_tests(ctx, category=''):
+    # Run all tests (except benchmarks) or only those of the given category
+    tests_executable_path = compile_tests()
+    if os.system("{} {}".format(tests_executable_path, category)) != 0:
+        raise Exception('Some tests failed')
+
+
+@task
+def run_benchmarks(ctx):
+    run_tests(ctx, category='Benchmarks')
+
+
 @task
 def clean(ctx):
     # Remove all intermediate build files for all platforms
@@ -63,6 +63,7 @@ class PlStateNames:
     MIDI_RECEIVED = 'MIDI_RECEIVED'
     LAST_CC_MIDI_RECEIVED = 'LAST_CC_MIDI_RECEIVED'
     LAST_NOTE_MIDI_RECEIVED = 'LAST_NOTE_MIDI_RECEIVED'
+    NUM_SKIPPED_VOICE_BLOCKS = 'NUM_SKIPPED_VOICE_BLOCKS'
 
 
 state_names_source_state_hierarchy_map = {
@@ -126,6 +127,7 @@ state_names_source_state_hierarchy_map = {
     PlStateNames.MIDI_RECEIVED: 'volatile',
     PlStateNames.LAST_CC_MIDI_RECEIVED: 'volatile',
     PlStateNames.LAST_NOTE_MIDI_RECEIVED: 'volatile',
+    PlStateNames.NUM_SKIPPED_VOICE_BLOCKS: 'volatile',
 }
 
 def snap_to_value(x, value=0.5, margin=0.07):
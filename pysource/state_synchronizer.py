@@ -293,7 +293,7 @@ class SourceStateSynchronizer(object):
 
     def set_volatile_state_from_string(self, volatile_state_string):
         # Do it from string serialized version of the state
-        is_querying, midi_received, last_cc_received, last_note_received, voice_activations, voice_sound_idxs, voice_play_positions, audio_levels = volatile_state_string.split(';')
+        is_querying, midi_received, last_cc_received, last_note_received, voice_activations, voice_sound_idxs, voice_play_positions, audio_levels, num_skipped_voice_blocks = volatile_state_string.split(';')
         
         # Is plugin currently querying and downloading?
         self.volatile_state[PlStateNames.IS_QUERYING] = is_querying != "0"
@@ -310,6 +310,9 @@ class SourceStateSynchronizer(object):
         self.volatile_state[PlStateNames.METER_L] = float(audio_levels[0])
         self.volatile_state[PlStateNames.METER_R] = float(audio_levels[1])
 
+        # Performance stats
+        self.volatile_state[PlStateNames.NUM_SKIPPED_VOICE_BLOCKS] = int(num_skipped_voice_blocks)
+
     def apply_update(self, update_id, update_type, update_data):
         if self.state_soup is not None:
             if self.verbose: